@@ -3,12 +3,38 @@
  * Door: Jenny Vermeltfoort, Universiteit van Leiden.
  */
 
+#include "cli.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "ascii.h"
+#include "comp.h"
+#include "cse.h"
 #include "diff.h"
+#include "emit.h"
 #include "file.h"
+#include "grad.h"
+#include "jit.h"
 #include "parser.h"
+#include "poly.h"
+#include "pool.h"
+#include "print.h"
+#include "quad.h"
+#include "roots.h"
+#include "sample.h"
 #include "simp.h"
+#include "taylor.h"
 #include "token.h"
+#include "vec.h"
+
+// Grootte van de buffer van stdout in batch mode.
+#define CLI_BATCH_BUFFER_SIZE (1 << 20)
+// Aantal jobs in een ronde, de output van een ronde wordt in
+// volgorde geschreven voordat de volgende ronde begint.
+#define CLI_JOBS_ROUND 4096
 
 typedef enum {
     CLI_RT_OK = 0,
@@ -19,126 +45,210 @@ typedef enum {
 
 typedef struct {
     tree_arena_handle_t const *ah;  // arena handle.
+    tree_arena_handle_t const *rh;  // de arena waarin r staat.
     tree_arena_handle_t const
-        *bh;          // arena handle, voor buffer rotatie.
-    tree_t *r;        // root van de ABS tree.
-    parser_buf_t *b;  // buffer van karakters om te tokenizen.
+        *bh;            // arena handle, voor de afgeleides.
+    diff_cache_t *dc;   // cache van de afgeleides in bh.
+    tree_t *r;          // root van de ABS tree.
+    parser_buf_t *b;    // buffer van karakters om te tokenizen.
+    comp_program_t *p;  // gecompileerde versie van r.
+    jit_t *j;           // machinecode van p, j->f kan NULL zijn.
+    emit_lib_t *l;      // p gecompileerd met gcc, l->f kan NULL zijn.
+    grad_tape_t *g;     // tape van r voor grad.
+    bool pc;            // is p up to date met r?
+    bool gc;            // is g up to date met r?
+    comp_rt_e prt;      // resultaat van het compileren van r.
+    bool ps;            // is r al versimpeld tot een fixpoint?
+    bool fold;          // constanten vouwen tijdens het parsen?
+    pool_t *pool;       // worker threads.
+    FILE *out;          // output van de commando's.
 } cli_parser_data_t;
 
+// Compileer de geladen boom, het programma wordt hergebruikt zolang
+// de boom niet veranderd. Wanneer de JIT niet beschikbaar is blijft
+// j->f NULL en wordt de interpreter gebruikt. Een met load geladen
+// functie hoort bij het oude programma en wordt gesloten, de tape
+// van grad moet opnieuw opgenomen worden.
+comp_rt_e cli_compile(cli_parser_data_t *pdata) {
+    if (!pdata->pc) {
+        pdata->prt = comp_tree(pdata->p, pdata->r);
+        pdata->pc = true;
+        pdata->gc = false;
+        jit_free(pdata->j);
+        emit_unload(pdata->l);
+        if (pdata->prt == COMP_RT_OK) {
+            jit_compile(pdata->j, pdata->p);
+        }
+    }
+
+    return pdata->prt;
+}
+
+// Meld de delingen door 0 die het versimpelen tegenkwam.
+static void cli_print_zeros(cli_parser_data_t *pdata, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        fprintf(pdata->out, "!ERR Division by 0.\n");
+    }
+}
+
+// Evalueer het gecompileerde programma voor een waarde van x, met
+// de geladen functie, de JIT of anders de interpreter.
+static inline double cli_eval(cli_parser_data_t *pdata, double x) {
+    if (pdata->l->f != NULL) {
+        return pdata->l->f(x);
+    }
+    return (pdata->j->f != NULL) ? pdata->j->f(x)
+                                 : comp_eval(pdata->p, x);
+}
+
 cli_rt_e cli_parser_exp(cli_parser_data_t *pdata) {
+    pdata->pc = false;
+    pdata->ps = false;
     tree_arena_clear(pdata->ah);
+    tree_arena_clear(pdata->bh);
+    diff_cache_clear(pdata->dc);
+    pdata->rh = pdata->ah;
     pdata->r = tree_arena_new_node(pdata->ah);
     if (pdata->r == NULL) {
-        printf("ERR! Failed to parse expression, it is too long.\n");
+        fprintf(pdata->out,
+                "ERR! Failed to parse expression, it is too long.\n");
         return CLI_RT_ERR_BIG;
     }
 
-    parser_rt_e rt =
-        parser_tokenize_string(pdata->ah, pdata->b, pdata->r);
+    parser_fold_t fold = {0};
+    parser_rt_e rt = parser_tokenize_string(
+        pdata->ah, pdata->b, pdata->r, pdata->fold ? &fold : NULL);
+    parser_skip_whitespace(pdata->b);
 
     if (rt != PARSER_RT_OK || *(pdata->b->p) != '\0') {
-        printf(
-            "ERR! Unable to parse string, invalid grammar used: "
-            "{\n\t"
-            "%s\n}\n",
-            pdata->b->d);
+        fprintf(pdata->out,
+                "ERR! Unable to parse string, invalid grammar used: "
+                "{\n\t"
+                "%s\n}\n",
+                pdata->b->l);
         pdata->r = NULL;
+    } else if (pdata->fold) {
+        fprintf(pdata->out,
+                "Folded %zu constants into a tree of %zu nodes, the "
+                "arena holds %zu instead of %zu nodes.\n",
+                fold.folds, fold.tokens - fold.freed,
+                tree_arena_used(pdata->ah), fold.tokens);
     }
 
     return CLI_RT_OK;
 }
 
 cli_rt_e cli_parser_dot(cli_parser_data_t *pdata) {
-    while (ascii_char_is_whitespace[(int)*(pdata->b->p)]) {
-        pdata->b->p++;
-    };
+    parser_skip_whitespace(pdata->b);
 
     if (*(pdata->b->p) == '\0') {
-        printf("ERR! No filename provided.\n");
+        fprintf(pdata->out, "ERR! No filename provided.\n");
         return CLI_RT_ERR;
     }
 
     FILE *f = fopen(pdata->b->p, "w");
 
     if (f == NULL) {
-        printf("ERR! Failed to open file.\n");
+        fprintf(pdata->out, "ERR! Failed to open file.\n");
         return CLI_RT_ERR;
     }
 
     if (file_write_tree(f, pdata->r) != FILE_RT_OK) {
-        printf("ERR! Failed to write DOT file from tree.\n");
+        fprintf(pdata->out,
+                "ERR! Failed to write DOT file from tree.\n");
     }
 
     fclose(f);
     return CLI_RT_OK;
 }
 
-bool cli_tree_print_should_bracket[] = {
-    [0 ... TOKEN_TYPE_INVALID] = true, [TOKEN_TYPE_MINUS] = true,
-    [TOKEN_TYPE_PLUS] = true,          [TOKEN_TYPE_MULTIPLY] = true,
-    [TOKEN_TYPE_DIVIDE] = true,        [TOKEN_TYPE_SIN] = false,
-    [TOKEN_TYPE_COS] = false,          [TOKEN_TYPE_POWER] = true,
-    [TOKEN_TYPE_NUMBER] = false,       [TOKEN_TYPE_VARIABLE] = false,
-    [TOKEN_TYPE_PI] = false,
-};
-
-void cli_tree_print(tree_t const *const r) {
-    // Print brackets wanneer de volgende token een volgens de mapping
-    // hierboven een bracket benoodzaakt. Niet wanneer de volgende
-    // operator dezelfde operator is als de huidige.
-    token_string_t string = {0};  // de token als string.
-    bool bp = false;              // is er een bracket geopend?
-
-    token_string(&r->token, string);
+cli_rt_e cli_parser_print(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
 
-    if (token_get_cat(&r->token) & TOKEN_CAT_OP_UNAIR) {
-        printf("%s(", string);
-        bp = true;
+    // Zonder filename wordt de expressie naar de output geschreven.
+    parser_skip_whitespace(pdata->b);
+    FILE *f = pdata->out;
+    if (*(pdata->b->p) != '\0') {
+        f = fopen(pdata->b->p, "w");
+        if (f == NULL) {
+            fprintf(pdata->out, "ERR! Failed to open file.\n");
+            return CLI_RT_ERR;
+        }
     }
 
-    if (!bp && r->left && r->left->token.type != r->token.type &&
-        cli_tree_print_should_bracket[r->left->token.type]) {
-        printf("(");
-        bp = true;
+    print_rt_e rt = print_write(f, pdata->r);
+    if (f != pdata->out && fclose(f) != 0) {
+        rt = PRINT_RT_ERR_WRITE;
     }
 
-    if (r->left) {
-        cli_tree_print(r->left);
+    if (rt == PRINT_RT_ERR) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to print the expression, out of memory.\n");
+        return CLI_RT_ERR;
+    } else if (rt == PRINT_RT_ERR_WRITE) {
+        fprintf(pdata->out, "ERR! Failed to write the expression.\n");
+        return CLI_RT_ERR;
     }
+    return CLI_RT_OK;
+}
 
-    if (bp) {
-        printf("\b) ");
-        bp = false;
+cli_rt_e cli_parser_emit(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
     }
 
-    if (token_get_cat(&r->token) &
-        (TOKEN_CAT_OP_BINAIR | TOKEN_CAT_SYMBOL)) {
-        printf("%s ", string);
+    parser_skip_whitespace(pdata->b);
+    if (*(pdata->b->p) == '\0') {
+        fprintf(pdata->out, "ERR! No filename provided.\n");
+        return CLI_RT_ERR;
     }
 
-    if (r->right && r->right->token.type != r->token.type &&
-        cli_tree_print_should_bracket[r->right->token.type]) {
-        printf("(");
-        bp = true;
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
     }
 
-    if (r->right) {
-        cli_tree_print(r->right);
+    FILE *f = fopen(pdata->b->p, "w");
+    if (f == NULL) {
+        fprintf(pdata->out, "ERR! Failed to open file.\n");
+        return CLI_RT_ERR;
     }
 
-    if (bp) {
-        printf("\b) ");
+    emit_rt_e rt = emit_write(f, pdata->p);
+    if (fclose(f) != 0 || rt != EMIT_RT_OK) {
+        fprintf(pdata->out, "ERR! Failed to write the C code.\n");
+        return CLI_RT_ERR;
     }
+    return CLI_RT_OK;
 }
 
-cli_rt_e cli_parser_print(cli_parser_data_t *pdata) {
-    if (pdata->r == NULL) {
-        printf("ERR! No tree has been initialized.\n");
-        return CLI_RT_ERR;
+// Schrijf de C code zoals emit en laad deze voor eval.
+cli_rt_e cli_parser_load(cli_parser_data_t *pdata) {
+    cli_rt_e rt = cli_parser_emit(pdata);
+    if (rt != CLI_RT_OK) {
+        return rt;
     }
 
-    cli_tree_print(pdata->r);
-    printf("\n");
+    // De output moet voor de compiler geschreven zijn.
+    fflush(pdata->out);
+    emit_rt_e ert = emit_load(pdata->l, pdata->b->p);
+    if (ert == EMIT_RT_ERR_CC) {
+        fprintf(pdata->out,
+                "ERR! Failed to compile the C code with gcc.\n");
+        return CLI_RT_ERR;
+    } else if (ert != EMIT_RT_OK) {
+        fprintf(pdata->out,
+                "ERR! Failed to load the compiled C code.\n");
+        return CLI_RT_ERR;
+    }
     return CLI_RT_OK;
 }
 
@@ -147,81 +257,720 @@ cli_rt_e cli_parser_end(cli_parser_data_t *pdata) {
 }
 
 cli_rt_e cli_parser_eval(cli_parser_data_t *pdata) {
-    while (ascii_char_is_whitespace[(int)*(pdata->b->p)]) {
-        pdata->b->p++;
-    };
+    parser_skip_whitespace(pdata->b);
+
+    double v;  // waarde van x gegeven in de input.
+    char const *p = pdata->b->p;
+    if (parser_read_double(pdata->b, &v) != PARSER_RT_OK ||
+        pdata->b->p == p) {
+        fprintf(
+            pdata->out,
+            "ERR! Unable to read the value of x from the input.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    // Wanneer de expressie nog andere variabelen bevat wordt x enkel
+    // in de boom gesubstitueerd, zoals voorheen.
+    comp_rt_e rt = cli_compile(pdata);
+    if (rt == COMP_RT_ERR_FREE) {
+        pdata->pc = false;
+        pdata->ps = false;
+        // De nodes worden ter plekke aangepast, ook wanneer dit
+        // halverwege mislukt. De tabel van de arena en de cache met
+        // afgeleides verwijzen daarna naar oude inhoud.
+        bool ok = tree_substitute_x(pdata->r, v);
+        tree_arena_intern_clear(pdata->rh);
+        diff_cache_clear(pdata->dc);
+        if (!ok) {
+            fprintf(pdata->out,
+                    "ERR! Failed to substitute x, out of memory.\n");
+            return CLI_RT_ERR;
+        }
+        return CLI_RT_OK;
+    } else if (rt != COMP_RT_OK) {
+        fprintf(pdata->out,
+                "ERR! Failed to compile the expression.\n");
+        return CLI_RT_ERR;
+    }
+
+    char string[TOKEN_NUMBER_LENGTH + 1];  // het resultaat.
+    token_format_double(string, cli_eval(pdata, v));
+    fprintf(pdata->out, "%s\n", string);
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_evald(cli_parser_data_t *pdata) {
+    parser_skip_whitespace(pdata->b);
 
     double v;  // waarde van x gegeven in de input.
-    if (parser_read_double(pdata->b, &v) == PARSER_RT_OK) {
-        tree_substitute_x(pdata->r, v);
-    } else {
-        printf(
+    char const *p = pdata->b->p;
+    if (parser_read_double(pdata->b, &v) != PARSER_RT_OK ||
+        pdata->b->p == p) {
+        fprintf(
+            pdata->out,
             "ERR! Unable to read the value of x from the input.\n");
         return CLI_RT_ERR;
     }
 
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    double d;                              // de afgeleide in v.
+    char string[TOKEN_NUMBER_LENGTH + 1];  // het resultaat.
+    token_format_double(string, comp_eval_dual(pdata->p, v, &d));
+    fprintf(pdata->out, "f = %s\n", string);
+    token_format_double(string, d);
+    fprintf(pdata->out, "df/dx = %s\n", string);
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_taylor(cli_parser_data_t *pdata) {
+    double v[2];  // de orde en het punt a.
+
+    for (int i = 0; i < 2; i++) {
+        parser_skip_whitespace(pdata->b);
+
+        char const *p = pdata->b->p;
+        if (parser_read_double(pdata->b, &v[i]) != PARSER_RT_OK ||
+            pdata->b->p == p) {
+            fprintf(
+                pdata->out,
+                "ERR! Unable to read the order and the point from "
+                "the input.\n");
+            return CLI_RT_ERR;
+        }
+    }
+
+    if (v[0] < 0.0f || v[0] > TAYLOR_ORDER_MAX || v[0] != (int)v[0]) {
+        fprintf(pdata->out,
+                "ERR! The order must be an integer from 0 to %d.\n",
+                TAYLOR_ORDER_MAX);
+        return CLI_RT_ERR;
+    }
+
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    int n = (int)v[0];
+    double c[TAYLOR_ORDER_MAX + 1];  // de coefficienten.
+    if (taylor_eval(pdata->p, v[1], n, c) != TAYLOR_RT_OK) {
+        fprintf(pdata->out, "ERR! Failed to allocate the series.\n");
+        return CLI_RT_ERR;
+    }
+
+    char string[TOKEN_NUMBER_LENGTH + 1];
+    for (int k = 0; k <= n; k++) {
+        token_format_double(string, c[k]);
+        fprintf(pdata->out, "c%d = %s\n", k, string);
+    }
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_roots(cli_parser_data_t *pdata) {
+    double v[2];  // de grenzen a en b.
+
+    for (int i = 0; i < 2; i++) {
+        parser_skip_whitespace(pdata->b);
+
+        char const *p = pdata->b->p;
+        if (parser_read_double(pdata->b, &v[i]) != PARSER_RT_OK ||
+            pdata->b->p == p) {
+            fprintf(
+                pdata->out,
+                "ERR! Unable to read the bounds from the input.\n");
+            return CLI_RT_ERR;
+        }
+    }
+
+    if (!isfinite(v[0]) || !isfinite(v[1]) || v[0] >= v[1]) {
+        fprintf(pdata->out,
+                "ERR! The bounds must be finite with a < b.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    roots_t r = {0};
+    roots_rt_e rt = roots_find(&r, pdata->p, pdata->pool, v[0], v[1]);
+    if (rt == ROOTS_RT_ERR) {
+        fprintf(pdata->out,
+                "ERR! Failed to allocate the intervals.\n");
+        roots_free(&r);
+        return CLI_RT_ERR;
+    } else if (rt == ROOTS_RT_ERR_BUDGET) {
+        // Vaak is f dan 0 op een heel interval, de lijst zou
+        // duizenden punten lang worden.
+        fprintf(
+            pdata->out,
+            "ERR! Gave up after %d intervals with %zu roots found, "
+            "the expression may be zero on a whole interval.\n",
+            ROOTS_BOXES_MAX, r.n);
+        roots_free(&r);
+        return CLI_RT_ERR;
+    }
+
+    char string[TOKEN_NUMBER_LENGTH + 1];
+    fprintf(pdata->out, "Found %zu roots.\n", r.n);
+    for (size_t i = 0; i < r.n; i++) {
+        token_format_double(string, r.d[i]);
+        fprintf(pdata->out, "x = %s\n", string);
+    }
+    roots_free(&r);
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_integrate(cli_parser_data_t *pdata) {
+    double v[3] = {0.0f, 0.0f, 1e-12};  // de grenzen en tolerantie.
+
+    for (int i = 0; i < 3; i++) {
+        parser_skip_whitespace(pdata->b);
+
+        // De tolerantie is optioneel.
+        char const *p = pdata->b->p;
+        if (i == 2 && *p == '\0') {
+            break;
+        } else if (parser_read_double(pdata->b, &v[i]) !=
+                       PARSER_RT_OK ||
+                   pdata->b->p == p) {
+            fprintf(
+                pdata->out,
+                "ERR! Unable to read the bounds and the tolerance "
+                "from the input.\n");
+            return CLI_RT_ERR;
+        }
+    }
+
+    if (!isfinite(v[0]) || !isfinite(v[1])) {
+        fprintf(pdata->out, "ERR! The bounds must be finite.\n");
+        return CLI_RT_ERR;
+    } else if (!(v[2] > 0.0f)) {
+        fprintf(pdata->out, "ERR! The tolerance must be positive.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    quad_result_t q;
+    switch (quad_integrate(&q, pdata->p, pdata->pool, v[0], v[1],
+                           v[2])) {
+        case QUAD_RT_OK:
+            break;
+        case QUAD_RT_ERR_BUDGET:
+            fprintf(
+                pdata->out,
+                "ERR! The tolerance was not reached with %zu panels, "
+                "the best estimate is printed.\n",
+                q.panels);
+            break;
+        case QUAD_RT_ERR_DIVERGE:
+            fprintf(pdata->out,
+                    "ERR! The integral does not converge.\n");
+            return CLI_RT_ERR;
+        default:
+            fprintf(pdata->out,
+                    "ERR! Failed to allocate the panels.\n");
+            return CLI_RT_ERR;
+    }
+
+    char string[TOKEN_NUMBER_LENGTH + 1];
+    token_format_double(string, q.value);
+    fprintf(pdata->out, "I = %s\n", string);
+    token_format_double(string, q.err);
+    fprintf(pdata->out, "err = %s\n", string);
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_grad(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    // Lees de waardes als <variabele>=<waarde>, per karakter.
+    double v[ASCII_SYMBOLS];
+    bool given[ASCII_SYMBOLS] = {false};
+    while (true) {
+        parser_skip_whitespace(pdata->b);
+        unsigned char c = *(pdata->b->p);
+        if (c == '\0') {
+            break;
+        }
+
+        pdata->b->p++;
+        if (c >= ASCII_SYMBOLS || *(pdata->b->p) != '=') {
+            fprintf(pdata->out,
+                    "ERR! Expected <variable>=<value>.\n");
+            return CLI_RT_ERR;
+        }
+
+        pdata->b->p++;
+        if (parser_read_double(pdata->b, &v[c]) != PARSER_RT_OK) {
+            fprintf(pdata->out,
+                    "ERR! Unable to read the value of %c.\n", c);
+            return CLI_RT_ERR;
+        }
+        given[c] = true;
+    }
+
+    // De tape wordt net als het programma hergebruikt zolang de boom
+    // niet verandert.
+    cli_compile(pdata);
+    grad_tape_t *t = pdata->g;
+    if (!pdata->gc) {
+        grad_rt_e rt = grad_record(t, pdata->r);
+        if (rt == GRAD_RT_ERR_TREE) {
+            fprintf(pdata->out,
+                    "ERR! Failed to record an invalid expression.\n");
+            return CLI_RT_ERR;
+        } else if (rt != GRAD_RT_OK) {
+            fprintf(pdata->out,
+                    "ERR! Failed to record the expression.\n");
+            return CLI_RT_ERR;
+        }
+        pdata->gc = true;
+    }
+
+    double x[ASCII_SYMBOLS];  // het punt, op volgorde van de tape.
+    for (int i = 0; i < t->vars; i++) {
+        if (!given[(int)t->var[i]]) {
+            fprintf(pdata->out, "ERR! No value given for %c.\n",
+                    t->var[i]);
+            return CLI_RT_ERR;
+        }
+        x[i] = v[(int)t->var[i]];
+    }
+
+    double g[ASCII_SYMBOLS];  // de gradient.
+    char string[TOKEN_NUMBER_LENGTH + 1];
+    token_format_double(string, grad_eval(t, x, g));
+    fprintf(pdata->out, "f = %s\n", string);
+    for (int i = 0; i < t->vars; i++) {
+        token_format_double(string, g[i]);
+        fprintf(pdata->out, "df/d%c = %s\n", t->var[i], string);
+    }
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_evalv(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    size_t n = 0;      // aantal gelezen waardes.
+    size_t size = 0;   // capaciteit van v.
+    double *v = NULL;  // de gelezen waardes van x.
+    cli_rt_e rt = CLI_RT_OK;
+
+    while (true) {
+        parser_skip_whitespace(pdata->b);
+
+        if (*(pdata->b->p) == '\0') {
+            break;
+        }
+
+        if (n >= size) {
+            size = size ? size * 2 : 64;
+            double *d = realloc(v, 2 * size * sizeof(double));
+            if (d == NULL) {
+                fprintf(pdata->out,
+                        "ERR! Failed to allocate the values.\n");
+                rt = CLI_RT_ERR;
+                break;
+            }
+            v = d;
+        }
+
+        char const *p = pdata->b->p;
+        if (parser_read_double(pdata->b, &v[n]) != PARSER_RT_OK ||
+            pdata->b->p == p) {
+            fprintf(pdata->out,
+                    "ERR! Unable to read the values of x from the "
+                    "input.\n");
+            rt = CLI_RT_ERR;
+            break;
+        }
+        n++;
+    }
+
+    // De resultaten komen in de tweede helft van v.
+    if (rt == CLI_RT_OK &&
+        vec_eval(pdata->p, v, v + size, n) != VEC_RT_OK) {
+        fprintf(pdata->out, "ERR! Failed to allocate the stack.\n");
+        rt = CLI_RT_ERR;
+    }
+
+    for (size_t i = 0; rt == CLI_RT_OK && i < n; i++) {
+        char string[TOKEN_NUMBER_LENGTH + 1];  // het resultaat.
+        int l = token_format_double(string, v[size + i]);
+        string[l] = (i + 1 < n) ? ' ' : '\n';
+        fwrite(string, 1, l + 1, pdata->out);
+    }
+
+    free(v);
+    return rt;
+}
+
+cli_rt_e cli_parser_sample(cli_parser_data_t *pdata) {
+    double v[3];  // a, b en het aantal punten.
+
+    for (int i = 0; i < 3; i++) {
+        parser_skip_whitespace(pdata->b);
+
+        char const *p = pdata->b->p;
+        if (parser_read_double(pdata->b, &v[i]) != PARSER_RT_OK ||
+            pdata->b->p == p) {
+            fprintf(
+                pdata->out,
+                "ERR! Unable to read the interval and the number of "
+                "points from the input.\n");
+            return CLI_RT_ERR;
+        }
+    }
+
+    parser_skip_whitespace(pdata->b);
+
+    if (*(pdata->b->p) == '\0') {
+        fprintf(pdata->out, "ERR! No filename provided.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (!(v[2] >= 1.0f && v[2] <= 0x1p53) || v[2] != floor(v[2])) {
+        fprintf(pdata->out,
+                "ERR! The number of points must be a positive "
+                "integer.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    if (cli_compile(pdata) != COMP_RT_OK) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to compile the expression, it may only hold "
+            "the variable x.\n");
+        return CLI_RT_ERR;
+    }
+
+    FILE *f = fopen(pdata->b->p, "w");
+    if (f == NULL) {
+        fprintf(pdata->out, "ERR! Failed to open file.\n");
+        return CLI_RT_ERR;
+    }
+
+    sample_rt_e rt = sample_write(f, pdata->p, pdata->pool, v[0],
+                                  v[1], (size_t)v[2]);
+    if (fclose(f) != 0 || rt != SAMPLE_RT_OK) {
+        fprintf(pdata->out,
+                "ERR! Failed to write the samples to the file.\n");
+        return CLI_RT_ERR;
+    }
     return CLI_RT_OK;
 }
 
 cli_rt_e cli_parser_simp(cli_parser_data_t *pdata) {
-    // Errors worden al geprint tijdens het simplificeren, dus de
-    // return waarde hoeft niet gevalideerd te worden. Ook hoeft het
-    // programma niet gestopt te worden.
+    // Errors van de regels worden al geprint tijdens het
+    // simplificeren, het programma hoeft niet gestopt te worden.
     if (pdata->r == NULL) {
-        printf("ERR! No tree has been initialized.\n");
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
         return CLI_RT_ERR;
     }
 
-    simp_tree(pdata->r);
+    // Het budget is optioneel, zonder budget hangt het af van de
+    // grootte van de boom.
+    double v = 0.0f;
+    parser_skip_whitespace(pdata->b);
+    if (*(pdata->b->p) != '\0' &&
+        (parser_read_double(pdata->b, &v) != PARSER_RT_OK ||
+         !(v >= 1.0f && v <= 0x1p53) || v != floor(v))) {
+        fprintf(pdata->out,
+                "ERR! The budget must be a positive integer.\n");
+        return CLI_RT_ERR;
+    }
+
+    // Een boom die al een fixpoint is hoeft niet opnieuw doorlopen te
+    // worden.
+    simp_stats_t stats = {.budget = (size_t)v};
+    simp_rt_e rt =
+        pdata->ps ? SIMP_RT_OK
+                  : simp_tree(pdata->rh, pdata->r, &stats);
+    cli_print_zeros(pdata, stats.zeros);
+    if (rt == SIMP_RT_ERR) {
+        fprintf(pdata->out,
+                "ERR! Failed to simplify the expression, out of "
+                "memory.\n");
+    }
+
+    fprintf(pdata->out,
+            "Simplified with %zu rewrites in %zu node visits.\n",
+            stats.rewrites, stats.visits);
+    if (rt == SIMP_RT_BUDGET) {
+        fprintf(pdata->out,
+                "The budget ran out, the expression may simplify "
+                "further.\n");
+    }
+
+    pdata->ps = (rt == SIMP_RT_OK);
+    pdata->pc = false;
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_normalize(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    poly_stats_t stats;
+    tree_t *r = poly_normalize(pdata->rh, pdata->r, &stats);
+    if (r == NULL) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to normalize the expression, it is likely "
+            "too long.\n");
+        return CLI_RT_ERR;
+    }
+
+    fprintf(
+        pdata->out,
+        "Collected %zu symbols into %zu terms in %zu polynomials.\n",
+        stats.symbols, stats.terms, stats.polys);
+    pdata->r = r;
+    pdata->pc = false;
+    pdata->ps = false;
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_expand(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    poly_stats_t stats;
+    tree_t *r = poly_expand(pdata->rh, pdata->r, &stats);
+    if (r == NULL) {
+        fprintf(
+            pdata->out,
+            "ERR! Failed to expand the expression, it is likely too "
+            "long.\n");
+        return CLI_RT_ERR;
+    }
+
+    fprintf(
+        pdata->out,
+        "Expanded %zu products into %zu terms in %zu polynomials.\n",
+        stats.products, stats.terms, stats.polys);
+    pdata->r = r;
+    pdata->pc = false;
+    pdata->ps = false;
+    return CLI_RT_OK;
+}
+
+cli_rt_e cli_parser_cse(cli_parser_data_t *pdata) {
+    if (pdata->r == NULL) {
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
+        return CLI_RT_ERR;
+    }
+
+    size_t n = cse_tree(pdata->rh, pdata->r);
+    if (tree_arena_get_err(pdata->rh) != TREE_ARENA_ERR_NONE) {
+        fprintf(pdata->out,
+                "ERR! Failed to eliminate the common subexpressions, "
+                "out of memory.\n");
+        return CLI_RT_ERR;
+    }
+
+    fprintf(pdata->out, "Shared %zu common subexpressions.\n", n);
+    pdata->pc = false;
     return CLI_RT_OK;
 }
 
 cli_rt_e cli_parser_diff(cli_parser_data_t *pdata) {
+    parser_skip_whitespace(pdata->b);
+
+    double v = 1.0f;  // de orde van de afgeleide.
+    bool report = (*(pdata->b->p) != '\0');
+    if (report && (parser_read_double(pdata->b, &v) != PARSER_RT_OK ||
+                   v < 1.0f || v > INT_MAX || v != (int)v)) {
+        fprintf(pdata->out,
+                "ERR! The order must be a positive integer.\n");
+        return CLI_RT_ERR;
+    }
+
     if (pdata->r == NULL) {
-        printf("ERR! No tree has been initialized.\n");
+        fprintf(pdata->out, "ERR! No tree has been initialized.\n");
         return CLI_RT_ERR;
     }
 
-    tree_arena_clear(pdata->bh);
-    tree_t *r = diff_tree(pdata->r, pdata->bh);
+    // De afgeleides blijven in bh staan tot de volgende exp, zodat de
+    // cache afgeleides van eerdere commando's kan hergebruiken.
+    size_t lookups = pdata->dc->lookups;
+    size_t hits = pdata->dc->hits;
+    size_t zeros = pdata->dc->zeros;
+    tree_t *r = diff_tree_n(pdata->r, pdata->rh, pdata->bh, (int)v,
+                            pdata->dc);
+    cli_print_zeros(pdata, pdata->dc->zeros - zeros);
     if (r == NULL) {
-        printf(
-            "ERR! Failed to differientiate the expression, it is "
-            "likely too long.\n");
+        fprintf(pdata->out,
+                "ERR! Failed to differientiate the expression, it is "
+                "likely too long.\n");
         return CLI_RT_ERR;
     }
 
-    tree_arena_handle_t const *b = pdata->bh;
-    pdata->bh = pdata->ah;
-    pdata->ah = b;
+    if (report) {
+        lookups = pdata->dc->lookups - lookups;
+        hits = pdata->dc->hits - hits;
+        fprintf(pdata->out,
+                "Cache hit rate: %.1f%% (%zu of %zu lookups).\n",
+                lookups ? 100.0f * hits / lookups : 0.0f, hits,
+                lookups);
+    }
+
+    pdata->rh = pdata->bh;
     pdata->r = r;
+    pdata->pc = false;
+    pdata->ps = false;
     return CLI_RT_OK;
 }
 
 cli_rt_e cli_parser_invalid(cli_parser_data_t *pdata) {
-    printf("ERR! Invalid input provided.\n");
+    fprintf(pdata->out, "ERR! Invalid input provided.\n");
     return CLI_RT_ERR;
 }
 
 cli_rt_e cli_parser_help(cli_parser_data_t *pdata) {
-    printf(
-        "# exp <expression> \t; loads the expression, expression "
-        "must be in polish notation.\n");
-    printf(
-        "# print \t\t; print the loaded expression in infix "
-        "notation.\n");
-    printf("# simp \t\t\t; simplify the loaded expression.\n");
-    printf(
-        "# eval <value> \t\t; substitute x within the loaded "
-        "expression for <value>, value may be point seperated.\n");
-    printf(
+    fprintf(pdata->out,
+            "# exp <expression> \t; loads the expression, expression "
+            "must be in polish notation.\n");
+    fprintf(
+        pdata->out,
+        "# print [filename] \t; print the loaded expression in infix "
+        "notation, to a file when a filename is given.\n");
+    fprintf(
+        pdata->out,
+        "# simp [budget] \t; simplify the loaded expression until "
+        "nothing changes or budget nodes are visited.\n");
+    fprintf(
+        pdata->out,
+        "# normalize \t\t; collect the like terms of the polynomials "
+        "in x within the loaded expression.\n");
+    fprintf(
+        pdata->out,
+        "# expand \t\t; normalize and multiply out the products of "
+        "the polynomials in x.\n");
+    fprintf(pdata->out,
+            "# cse \t\t\t; share the common subexpressions of the "
+            "loaded expression.\n");
+    fprintf(
+        pdata->out,
+        "# eval <value> \t\t; evaluate the loaded expression with x "
+        "as <value>, value may be point seperated. When the "
+        "expression holds other variables x is substituted "
+        "instead.\n");
+    fprintf(pdata->out,
+            "# evalv <values> \t; evaluate the loaded expression for "
+            "every value of x in the whitespace seperated list.\n");
+    fprintf(
+        pdata->out,
+        "# evald <value> \t; evaluate the loaded expression and its "
+        "derivative on x with x as <value>.\n");
+    fprintf(
+        pdata->out,
+        "# taylor <n> <a> \t; print the coefficients c0 to cn of the "
+        "taylor series of the loaded expression at x = a, ck is the "
+        "k-th derivative divided by k!.\n");
+    fprintf(
+        pdata->out,
+        "# grad <v>=<value> ... \t; evaluate the loaded expression "
+        "and its partial derivatives at the point, every variable "
+        "needs a value.\n");
+    fprintf(
+        pdata->out,
+        "# integrate <a> <b> [tol] ; integrate the loaded expression "
+        "over [a, b] until the estimated error is at most tol times "
+        "the integral of |f|, tol is 1e-12 by default.\n");
+    fprintf(pdata->out,
+            "# roots <a> <b> \t; print the roots of the loaded "
+            "expression on [a, b].\n");
+    fprintf(pdata->out,
+            "# sample <a> <b> <n> <filename> ; write n points of the "
+            "loaded expression on [a, b] to a CSV file.\n");
+    fprintf(
+        pdata->out,
+        "# emit <filename> \t; write the loaded expression as the C "
+        "function " EMIT_NAME "(double x).\n");
+    fprintf(
+        pdata->out,
+        "# load <filename> \t; emit the C function, compile it with "
+        "gcc and use it for eval.\n");
+    fprintf(
+        pdata->out,
         "# dot <filename> \t; write the loaded expression to a DOT "
         "file format.\n");
-    printf(
-        "# diff \t\t\t; differentiates the loaded expression on "
-        "x.\n");
-    printf("# end \t\t\t; end the program.\n");
-    printf("# help \t\t\t; print help.\n");
+    fprintf(pdata->out,
+            "# diff [n] \t\t; differentiates the loaded expression n "
+            "times on x, n is 1 by default.\n");
+    fprintf(pdata->out, "# end \t\t\t; end the program.\n");
+    fprintf(pdata->out, "# help \t\t\t; print help.\n");
     return CLI_RT_OK;
 }
 
@@ -232,7 +981,19 @@ typedef enum {
     CLI_MENU_OPTION_END,
     CLI_MENU_OPTION_DIFF,
     CLI_MENU_OPTION_SIMP,
+    CLI_MENU_OPTION_CSE,
+    CLI_MENU_OPTION_NORMALIZE,
+    CLI_MENU_OPTION_EXPAND,
     CLI_MENU_OPTION_EVAL,
+    CLI_MENU_OPTION_EVALV,
+    CLI_MENU_OPTION_EVALD,
+    CLI_MENU_OPTION_GRAD,
+    CLI_MENU_OPTION_TAYLOR,
+    CLI_MENU_OPTION_ROOTS,
+    CLI_MENU_OPTION_INTEGRATE,
+    CLI_MENU_OPTION_SAMPLE,
+    CLI_MENU_OPTION_EMIT,
+    CLI_MENU_OPTION_LOAD,
     CLI_MENU_OPTION_HELP,
     CLI_MENU_OPTION_INVALID,
 } cli_menu_option_e;
@@ -246,14 +1007,47 @@ cli_parser_t cli_menu[] = {
     [CLI_MENU_OPTION_DOT] = cli_parser_dot,
     [CLI_MENU_OPTION_END] = cli_parser_end,
     [CLI_MENU_OPTION_SIMP] = cli_parser_simp,
+    [CLI_MENU_OPTION_CSE] = cli_parser_cse,
+    [CLI_MENU_OPTION_NORMALIZE] = cli_parser_normalize,
+    [CLI_MENU_OPTION_EXPAND] = cli_parser_expand,
     [CLI_MENU_OPTION_EVAL] = cli_parser_eval,
+    [CLI_MENU_OPTION_EVALV] = cli_parser_evalv,
+    [CLI_MENU_OPTION_EVALD] = cli_parser_evald,
+    [CLI_MENU_OPTION_GRAD] = cli_parser_grad,
+    [CLI_MENU_OPTION_TAYLOR] = cli_parser_taylor,
+    [CLI_MENU_OPTION_ROOTS] = cli_parser_roots,
+    [CLI_MENU_OPTION_INTEGRATE] = cli_parser_integrate,
+    [CLI_MENU_OPTION_SAMPLE] = cli_parser_sample,
+    [CLI_MENU_OPTION_EMIT] = cli_parser_emit,
+    [CLI_MENU_OPTION_LOAD] = cli_parser_load,
     [CLI_MENU_OPTION_HELP] = cli_parser_help,
     [CLI_MENU_OPTION_DIFF] = cli_parser_diff,
 };
 
 cli_rt_e cli_print_top(cli_parser_data_t *pdata) {
-    printf("# Simple calculator by Jenny Vermeltfoort, s3787494\n");
-    printf("# Run with flag '-s' to make it silent.\n");
+    fprintf(pdata->out,
+            "# Simple calculator by Jenny Vermeltfoort, s3787494\n");
+    fprintf(pdata->out, "# Run with flag '-s' to make it silent.\n");
+    fprintf(pdata->out,
+            "# Run with flag '-a <nodes>' to size the first arena "
+            "page.\n");
+    fprintf(
+        pdata->out,
+        "# Run with flag '-p <l1|large|huge>' to select the arena "
+        "page type.\n");
+    fprintf(
+        pdata->out,
+        "# Run with flag '-t <threads>' to set the number of worker "
+        "threads.\n");
+    fprintf(pdata->out,
+            "# Run with flag '-f <file>' to run the commands in a "
+            "file.\n");
+    fprintf(pdata->out,
+            "# Run with flag '-j <file>' to run the jobs in a file "
+            "on all worker threads.\n");
+    fprintf(pdata->out,
+            "# Run with flag '-c' to fold the constants while "
+            "parsing.\n");
     cli_menu[CLI_MENU_OPTION_HELP](pdata);
     return CLI_RT_OK;
 }
@@ -263,7 +1057,7 @@ cli_rt_e cli_print_top_silent(cli_parser_data_t *pdata) {
 }
 
 cli_rt_e cli_print_prompt(cli_parser_data_t *pdata) {
-    printf("$ ");
+    fprintf(pdata->out, "$ ");
     return CLI_RT_OK;
 }
 
@@ -271,67 +1065,415 @@ cli_rt_e cli_print_prompt_silent(cli_parser_data_t *pdata) {
     return CLI_RT_OK;
 }
 
-void cli_loop(bool silent) {
-    tree_arena_handle_t const *ah = tree_arena_malloc();
-    tree_arena_handle_t const *bh = tree_arena_malloc();
+// Het commando dat op de regel l begint, de regel moet met een '\0'
+// afgesloten zijn.
+static cli_menu_option_e cli_command(char const *l) {
+    cli_menu_option_e i = CLI_MENU_OPTION_INVALID;
+    if (l[0] == 'p' && l[1] == 'r')
+        i = CLI_MENU_OPTION_PRINT;
+    else if (l[0] == 'e' && l[1] == 'x' && l[2] == 'p' &&
+             l[3] == 'a')
+        i = CLI_MENU_OPTION_EXPAND;
+    else if (l[0] == 'e' && l[1] == 'x')
+        i = CLI_MENU_OPTION_EXP;
+    else if (l[0] == 'e' && l[1] == 'm')
+        i = CLI_MENU_OPTION_EMIT;
+    else if (l[0] == 'e' && l[1] == 'n')
+        i = CLI_MENU_OPTION_END;
+    else if (l[0] == 'd' && l[1] == 'o')
+        i = CLI_MENU_OPTION_DOT;
+    else if (l[0] == 's' && l[1] == 'i')
+        i = CLI_MENU_OPTION_SIMP;
+    else if (l[0] == 'c' && l[1] == 's')
+        i = CLI_MENU_OPTION_CSE;
+    else if (l[0] == 'n' && l[1] == 'o')
+        i = CLI_MENU_OPTION_NORMALIZE;
+    else if (l[0] == 'e' && l[1] == 'v' && l[2] == 'a' &&
+             l[3] == 'l' && l[4] == 'v')
+        i = CLI_MENU_OPTION_EVALV;
+    else if (l[0] == 'e' && l[1] == 'v' && l[2] == 'a' &&
+             l[3] == 'l' && l[4] == 'd')
+        i = CLI_MENU_OPTION_EVALD;
+    else if (l[0] == 'e' && l[1] == 'v')
+        i = CLI_MENU_OPTION_EVAL;
+    else if (l[0] == 't' && l[1] == 'a')
+        i = CLI_MENU_OPTION_TAYLOR;
+    else if (l[0] == 'r' && l[1] == 'o')
+        i = CLI_MENU_OPTION_ROOTS;
+    else if (l[0] == 'i' && l[1] == 'n')
+        i = CLI_MENU_OPTION_INTEGRATE;
+    else if (l[0] == 'g' && l[1] == 'r')
+        i = CLI_MENU_OPTION_GRAD;
+    else if (l[0] == 'd' && l[1] == 'i')
+        i = CLI_MENU_OPTION_DIFF;
+    else if (l[0] == 's' && l[1] == 'a')
+        i = CLI_MENU_OPTION_SAMPLE;
+    else if (l[0] == 'l' && l[1] == 'o')
+        i = CLI_MENU_OPTION_LOAD;
+    else if (l[0] == 'h' && l[1] == 'e')
+        i = CLI_MENU_OPTION_HELP;
+    return i;
+}
+
+// Voer het commando uit dat op b->l begint, de regel moet met een
+// '\0' afgesloten zijn.
+cli_rt_e cli_dispatch(cli_parser_data_t *pdata) {
+    parser_buf_t *b = pdata->b;
+    cli_menu_option_e i = cli_command(b->l);
+
+    b->p = b->l;
+    while (!ascii_char_is_whitespace[(int)*(b->p)] &&
+           *(b->p) != '\0') {
+        b->p++;
+    };
+
+    // De function call is verantwoordelijk voor het verplaatsen
+    // van de pointer naar de volgende stuk text in de buffer.
+    return cli_menu[i](pdata);
+}
+
+// Voer de commando's uit een file uit. De file wordt in het geheugen
+// gemapt en iedere regel wordt in de mapping zelf afgesloten, zodat
+// de commando's zonder kopie uitgevoerd worden.
+void cli_batch(cli_parser_data_t *pdata, char const *path) {
+    char *d;      // de mapping van de file.
+    size_t size;  // lengte van de mapping.
+    if (file_map(path, &d, &size) != FILE_RT_OK) {
+        fprintf(pdata->out,
+                "ERR! Failed to open the command file.\n");
+        return;
+    }
+
+    parser_buf_t *b = pdata->b;
+    char *e = d + size;
+    cli_rt_e rt = CLI_RT_OK;
+    for (char *l = d; rt != CLI_RT_END && l < e;) {
+        char *n = memchr(l, '\n', e - l);
+        if (n != NULL) {
+            *n = '\0';
+            b->l = l;
+            b->e = n;
+            l = n + 1;
+        } else {
+            // De laatste regel heeft geen '\n' die afgesloten kan
+            // worden, deze wordt net als bij stdin in d gelezen.
+            size_t m = e - l;
+            m = (m < PARSER_STRING_BUFFER_SIZE)
+                    ? m
+                    : PARSER_STRING_BUFFER_SIZE - 1;
+            memcpy(b->d, l, m);
+            b->d[m] = '\0';
+            b->l = b->d;
+            b->e = b->d + m;
+            l = e;
+        }
+
+        rt = cli_dispatch(pdata);
+    }
+
+    file_unmap(d, size);
+}
+
+// De toestand van een interpreter van de commando's. Iedere worker
+// van cli_jobs() heeft een eigen toestand met een eigen paar arenas.
+typedef struct {
+    parser_buf_t b;
+    comp_program_t p;
+    jit_t j;
+    emit_lib_t l;
+    grad_tape_t g;
+    diff_cache_t dc;
+    cli_parser_data_t pdata;
+} cli_state_t;
+
+// Geeft false wanneer de arenas niet gealloceerd konden worden, de
+// toestand moet dan nog wel vrijgegeven worden.
+static bool cli_state_init(cli_state_t *s, bool fold, pool_t *pool,
+                           FILE *out) {
+    memset(s, 0, sizeof(cli_state_t));
+    s->pdata = (cli_parser_data_t){
+        .ah = tree_arena_malloc(),
+        .bh = tree_arena_malloc(),
+        .dc = &s->dc,
+        .r = NULL,
+        .b = &s->b,
+        .p = &s->p,
+        .j = &s->j,
+        .l = &s->l,
+        .g = &s->g,
+        .pc = false,
+        .gc = false,
+        .ps = false,
+        .fold = fold,
+        .pool = pool,
+        .out = out,
+    };
+    s->pdata.rh = s->pdata.ah;
+    return (s->pdata.ah != NULL && s->pdata.bh != NULL);
+}
+
+static void cli_state_free(cli_state_t *s) {
+    if (s->pdata.ah != NULL) {
+        tree_arena_free(s->pdata.ah);
+    }
+    if (s->pdata.bh != NULL) {
+        tree_arena_free(s->pdata.bh);
+    }
+    comp_free(&s->p);
+    jit_free(&s->j);
+    emit_unload(&s->l);
+    grad_free(&s->g);
+    diff_cache_clear(&s->dc);
+}
+
+// Een job, de regels lines[first] tot lines[first + n].
+typedef struct {
+    size_t first;
+    size_t n;
+} cli_job_t;
+
+// Waar de output van een job in de buffer van zijn worker staat.
+typedef struct {
+    int w;
+    size_t start;
+    size_t end;
+} cli_job_out_t;
+
+typedef struct {
+    cli_state_t s;
+    pool_t *pool;  // pool zonder threads voor sample, roots, etc.
+    char *d;       // de output van de huidige ronde.
+    size_t size;   // lengte van d na een fflush().
+} cli_worker_t;
+
+typedef struct {
+    cli_worker_t *w;      // een worker per thread van de pool.
+    char **lines;         // de regels, afgesloten met een '\0'.
+    cli_job_t *jobs;
+    cli_job_out_t *out;   // per job van de ronde.
+    size_t first;         // eerste job van de ronde.
+} cli_jobs_ctx_t;
+
+static void cli_job(void *ctx, pool_worker_t *pw, void *item) {
+    cli_jobs_ctx_t *c = ctx;
+    size_t i = *(size_t *)item;
+    int id = pool_worker_id(pw);
+    cli_worker_t *w = &c->w[id];
+    cli_parser_data_t *pdata = &w->s.pdata;
+    cli_job_out_t *o = &c->out[i - c->first];
+
+    // Een job begint zonder boom, net als het programma. De arenas
+    // worden door exp geleegd en zo hergebruikt.
+    pdata->r = NULL;
+    fflush(pdata->out);
+    o->w = id;
+    o->start = w->size;
+    for (size_t k = 0; k < c->jobs[i].n; k++) {
+        char *l = c->lines[c->jobs[i].first + k];
+        pdata->b->l = l;
+        pdata->b->e = l + strlen(l);
+        cli_dispatch(pdata);
+    }
+    fflush(pdata->out);
+    o->end = w->size;
+}
+
+// Deel de regels van de mapping op in jobs, iedere exp begint een
+// nieuwe job. Net als in cli_batch() stopt het lezen bij end. Een
+// laatste regel zonder '\n' wordt naar tail gekopieerd.
+static bool cli_jobs_split(char *d, size_t size, char ***lines,
+                           cli_job_t **jobs, size_t *n, char **tail) {
+    size_t nl = 0, sl = 0;  // aantal regels en capaciteit.
+    size_t sj = 0;          // capaciteit van jobs.
+    char *e = d + size;
+
+    *n = 0;
+    for (char *l = d; l < e;) {
+        char *r = memchr(l, '\n', e - l);
+        if (r != NULL) {
+            *r = '\0';
+        } else {
+            *tail = strndup(l, e - l);
+            if (*tail == NULL) {
+                return false;
+            }
+        }
+
+        char *line = (r != NULL) ? l : *tail;
+        l = (r != NULL) ? r + 1 : e;
+        cli_menu_option_e i = cli_command(line);
+        if (i == CLI_MENU_OPTION_END) {
+            break;
+        }
+
+        if (nl >= sl) {
+            sl = sl ? sl * 2 : 1024;
+            char **t = realloc(*lines, sl * sizeof(char *));
+            if (t == NULL) {
+                return false;
+            }
+            *lines = t;
+        }
+
+        if (*n == 0 || i == CLI_MENU_OPTION_EXP) {
+            if (*n >= sj) {
+                sj = sj ? sj * 2 : 1024;
+                cli_job_t *t = realloc(*jobs, sj * sizeof(cli_job_t));
+                if (t == NULL) {
+                    return false;
+                }
+                *jobs = t;
+            }
+            (*jobs)[(*n)++] = (cli_job_t){.first = nl, .n = 0};
+        }
+
+        (*lines)[nl++] = line;
+        (*jobs)[*n - 1].n++;
+    }
+
+    return true;
+}
+
+// Voer de jobs uit een file parallel uit, de output van de jobs komt
+// in de volgorde van de file. Iedere worker heeft een eigen
+// toestand, de jobs worden met work stealing over de workers
+// verdeeld.
+static void cli_jobs(cli_config_t const *const config, pool_t *pool) {
+    char *d;      // de mapping van de file.
+    size_t size;  // lengte van de mapping.
+    if (file_map(config->jobs, &d, &size) != FILE_RT_OK) {
+        printf("ERR! Failed to open the job file.\n");
+        return;
+    }
+
+    int workers = pool_get_workers(pool);
+    char **lines = NULL;
+    char *tail = NULL;
+    size_t n = 0;  // aantal jobs.
+    cli_jobs_ctx_t c = {
+        .w = calloc(workers, sizeof(cli_worker_t)),
+        .out = malloc(CLI_JOBS_ROUND * sizeof(cli_job_out_t)),
+    };
+    size_t *items = malloc(CLI_JOBS_ROUND * sizeof(size_t));
+    bool ok = (c.w != NULL && c.out != NULL && items != NULL);
+
+    ok = ok && cli_jobs_split(d, size, &lines, &c.jobs, &n, &tail);
+    c.lines = lines;
+    for (int i = 0; ok && i < workers; i++) {
+        c.w[i].pool = pool_malloc(1);
+        ok = (c.w[i].pool != NULL) &&
+             cli_state_init(&c.w[i].s, config->fold, c.w[i].pool,
+                            NULL);
+    }
+    if (!ok) {
+        printf("ERR! Failed to allocate the jobs.\n");
+    }
+
+    // Per ronde schrijft iedere worker naar een eigen buffer, daarna
+    // wordt de output van de jobs in volgorde weggeschreven.
+    for (c.first = 0; ok && c.first < n; c.first += CLI_JOBS_ROUND) {
+        size_t r = (n - c.first < CLI_JOBS_ROUND) ? n - c.first
+                                                  : CLI_JOBS_ROUND;
+        for (int i = 0; i < workers; i++) {
+            cli_worker_t *w = &c.w[i];
+            w->s.pdata.out = open_memstream(&w->d, &w->size);
+            ok = ok && (w->s.pdata.out != NULL);
+        }
+        for (size_t k = 0; k < r; k++) {
+            items[k] = c.first + k;
+        }
+
+        ok = ok &&
+             pool_run(pool, items, r, sizeof(size_t), cli_job, &c);
+        for (int i = 0; i < workers; i++) {
+            if (c.w[i].s.pdata.out != NULL) {
+                fclose(c.w[i].s.pdata.out);
+                c.w[i].s.pdata.out = NULL;
+            }
+        }
+
+        for (size_t k = 0; ok && k < r; k++) {
+            cli_job_out_t const *o = &c.out[k];
+            fwrite(c.w[o->w].d + o->start, 1, o->end - o->start,
+                   stdout);
+        }
+        for (int i = 0; i < workers; i++) {
+            free(c.w[i].d);
+            c.w[i].d = NULL;
+        }
+
+        if (!ok) {
+            printf("ERR! Failed to run the jobs.\n");
+        }
+    }
+
+    for (int i = 0; c.w != NULL && i < workers; i++) {
+        cli_state_free(&c.w[i].s);
+        if (c.w[i].pool != NULL) {
+            pool_free(c.w[i].pool);
+        }
+    }
+    free(c.w);
+    free(c.out);
+    free(c.jobs);
+    free(items);
+    free(lines);
+    free(tail);
+    file_unmap(d, size);
+}
+
+void cli_loop(cli_config_t const *const config) {
+    // Met een file gaat alle output via een grote buffer, dit moet
+    // gebeuren voordat er iets naar stdout geschreven wordt.
+    bool file = (config->batch != NULL || config->jobs != NULL);
+    if (file) {
+        setvbuf(stdout, NULL, _IOFBF, CLI_BATCH_BUFFER_SIZE);
+    }
+
+    pool_t *pool = pool_malloc(config->workers);
+    if (pool == NULL) {
+        printf("ERR! Failed to allocate the worker threads.\n");
+        return;
+    }
+
+    if (config->jobs != NULL) {
+        cli_jobs(config, pool);
+        pool_free(pool);
+        return;
+    }
+
+    cli_state_t s;
+    if (!cli_state_init(&s, config->fold, pool, stdout)) {
+        printf("ERR! Failed to allocate the tree arenas.\n");
+        cli_state_free(&s);
+        pool_free(pool);
+        return;
+    }
+
     cli_parser_t print_top[] = {
         [false] = cli_print_top, [true] = cli_print_top_silent};
     cli_parser_t print_prompt[] = {
         [false] = cli_print_prompt, [true] = cli_print_prompt_silent};
-    parser_buf_t b = {0};
-    cli_parser_data_t pdata = {
-        .ah = ah,
-        .bh = bh,
-        .r = NULL,
-        .b = &b,
-    };
 
-    print_top[silent](&pdata);
+    // Een file met commando's heeft geen prompts nodig.
+    bool silent = config->silent || file;
+    print_top[silent](&s.pdata);
+
+    if (config->batch != NULL) {
+        cli_batch(&s.pdata, config->batch);
+    }
 
     cli_rt_e rt = CLI_RT_OK;
-    while (rt != CLI_RT_END &&
-           print_prompt[silent](&pdata) == CLI_RT_OK &&
-           fgets(b.d, PARSER_STRING_BUFFER_SIZE, stdin) != NULL) {
-        // Het zou eigenlijk beter zijn om in secties de data uit
-        // stdin te lezen om te enige afhandeling van buffer overflows
-        // te voorkomen. Nu leiden een buffer overflow in een invalid
-        // command, terwijl het eigen nog een onderdeel is van
-        // bijvoorbeeld een syntax boom. Heb alleen geen zin om dit te
-        // veranderen, heb al genoeg tijd besteed aan deze opdracht.
-
-        for (int i = 0; b.d[i] != '\0'; i++) {
-            b.d[i] = (b.d[i] == '\n') ? 0 : b.d[i];
-        }
-        b.p = &b.d[0];
-
-        cli_menu_option_e i = CLI_MENU_OPTION_INVALID;
-        if (b.d[0] == 'p' && b.d[1] == 'r')
-            i = CLI_MENU_OPTION_PRINT;
-        else if (b.d[0] == 'e' && b.d[1] == 'x')
-            i = CLI_MENU_OPTION_EXP;
-        else if (b.d[0] == 'e' && b.d[1] == 'n')
-            i = CLI_MENU_OPTION_END;
-        else if (b.d[0] == 'd' && b.d[1] == 'o')
-            i = CLI_MENU_OPTION_DOT;
-        else if (b.d[0] == 's' && b.d[1] == 'i')
-            i = CLI_MENU_OPTION_SIMP;
-        else if (b.d[0] == 'e' && b.d[1] == 'v')
-            i = CLI_MENU_OPTION_EVAL;
-        else if (b.d[0] == 'd' && b.d[1] == 'i')
-            i = CLI_MENU_OPTION_DIFF;
-        else if (b.d[0] == 'h' && b.d[1] == 'e')
-            i = CLI_MENU_OPTION_HELP;
-
-        while (!ascii_char_is_whitespace[(int)*(b.p)] &&
-               *(b.p) != '\0') {
-            b.p++;
-        };
-
-        // De function call is verantwoordelijk voor het verplaatsen
-        // van de pointer naar de volgende stuk text in de buffer.
-        rt = cli_menu[i](&pdata);
-    }
-
-    tree_arena_free(pdata.ah);
-    tree_arena_free(pdata.bh);
+    while (config->batch == NULL && rt != CLI_RT_END &&
+           print_prompt[silent](&s.pdata) == CLI_RT_OK &&
+           parser_read_line(&s.b, stdin)) {
+        // Een regel die niet in de buffer past wordt tijdens het
+        // parsen in blokken verder gelezen, wat een commando niet
+        // gebruikt wordt overgeslagen.
+        rt = cli_dispatch(&s.pdata);
+        parser_skip_line(&s.b);
+    }
+
+    cli_state_free(&s);
+    pool_free(pool);
 }
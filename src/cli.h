@@ -10,7 +10,14 @@
 
 #include "tree.h"
 
-// silent bepaald of er randzaken worden geprint.
-void cli_loop(bool silent);
+typedef struct {
+    bool silent;  // bepaald of er randzaken worden geprint.
+    int workers;  // aantal threads, 0 is het aantal CPU's.
+    char const *batch;  // file met commando's, NULL leest stdin.
+    char const *jobs;   // file met jobs, NULL zonder jobs.
+    bool fold;          // vouw constanten tijdens het parsen.
+} cli_config_t;
+
+void cli_loop(cli_config_t const *const config);
 
 #endif  // __CLI_H
@@ -0,0 +1,522 @@
+/* Implementatie van een compiler die een ABS boom omzet naar een
+ * programma in postfix notatie, en de stack machine die het
+ * programma uitvoert.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "comp.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI acos(0.0f) * 2.0f
+
+// Aantal doubles op de stack van de machine voordat er op de heap
+// gealloceerd moet worden.
+#define COMP_STACK_SIZE 256
+
+comp_op_e comp_map_type[] = {
+    [0 ... TOKEN_TYPE_INVALID] = COMP_OP_INVALID,
+    [TOKEN_TYPE_MINUS] = COMP_OP_MINUS,
+    [TOKEN_TYPE_PLUS] = COMP_OP_PLUS,
+    [TOKEN_TYPE_MULTIPLY] = COMP_OP_MULTIPLY,
+    [TOKEN_TYPE_DIVIDE] = COMP_OP_DIVIDE,
+    [TOKEN_TYPE_POWER] = COMP_OP_POWER,
+    [TOKEN_TYPE_SIN] = COMP_OP_SIN,
+    [TOKEN_TYPE_COS] = COMP_OP_COS,
+    [TOKEN_TYPE_NUMBER] = COMP_OP_NUMBER,
+    [TOKEN_TYPE_VARIABLE] = COMP_OP_X,
+    [TOKEN_TYPE_PI] = COMP_OP_NUMBER,
+};
+
+// Verandering van de stack diepte per instructie.
+int comp_map_depth[] = {
+    [0 ... COMP_OP_INVALID] = 0,   [COMP_OP_NUMBER] = 1,
+    [COMP_OP_X] = 1,               [COMP_OP_MINUS] = -1,
+    [COMP_OP_PLUS] = -1,           [COMP_OP_MULTIPLY] = -1,
+    [COMP_OP_DIVIDE] = -1,         [COMP_OP_POWER] = -1,
+    [COMP_OP_LOAD] = 1,
+};
+
+typedef struct {
+    comp_program_t *p;
+    int depth;          // huidige diepte van de stack.
+    tree_map_t refs;    // node naar het aantal ouders.
+    tree_map_t slots;   // gedeelde node naar zijn slot + 1.
+    tree_map_t consts;  // gedeelde constante node naar zijn waarde.
+} comp_state_t;
+
+// Pas een operatie toe op de operanden, r wordt genegeerd door de
+// unaire operaties.
+static inline double comp_apply(comp_op_e op, double l, double r) {
+    switch (op) {
+        case COMP_OP_MINUS:
+            return l - r;
+        case COMP_OP_PLUS:
+            return l + r;
+        case COMP_OP_MULTIPLY:
+            return l * r;
+        case COMP_OP_DIVIDE:
+            return l / r;
+        case COMP_OP_POWER:
+            return pow(l, r);
+        case COMP_OP_SIN:
+            return sin(l);
+        case COMP_OP_COS:
+            return cos(l);
+        default:
+            return NAN;
+    }
+}
+
+static comp_rt_e comp_emit(comp_state_t *s, comp_op_e op, int slot,
+                           double value) {
+    comp_program_t *p = s->p;
+    if (p->n >= p->size) {
+        int size = p->size ? p->size * 2 : 64;
+        comp_instr_t *d = realloc(p->d, size * sizeof(comp_instr_t));
+        if (d == NULL) {
+            return COMP_RT_ERR;
+        }
+        p->d = d;
+        p->size = size;
+    }
+
+    p->d[p->n++] =
+        (comp_instr_t){.op = op, .slot = slot, .value = value};
+    s->depth += comp_map_depth[op];
+    p->depth = (s->depth > p->depth) ? s->depth : p->depth;
+    return COMP_RT_OK;
+}
+
+// Is de instructie op index i de enige instructie van een operand
+// en een constante?
+static inline bool comp_is_constant(comp_program_t const *const p,
+                                    int i, int end) {
+    return (end - i == 1 && p->d[i].op == COMP_OP_NUMBER);
+}
+
+// Tel een ouder bij het kind c op, *seen geeft of c al eerder een
+// ouder had.
+static inline comp_rt_e comp_count_ref(tree_map_t *refs,
+                                       tree_t const *const c,
+                                       bool *seen) {
+    void *n = NULL;  // aantal ouders van het kind.
+    *seen = tree_map_get(refs, c, &n);
+    return tree_map_put(refs, c, (void *)((intptr_t)n + 1))
+               ? COMP_RT_OK
+               : COMP_RT_ERR;
+}
+
+// Versie van comp_count_refs() met een expliciete stack. De volgorde
+// waarin de ouders geteld worden maakt niet uit.
+static comp_rt_e comp_count_refs_iter(tree_map_t *refs,
+                                      tree_t const *const t) {
+    tree_stack_t s = {.w = sizeof(tree_t const *)};
+    tree_t const **f = tree_stack_push(&s);
+    comp_rt_e rt = (f != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+
+    if (f != NULL) {
+        *f = t;
+    }
+
+    while (rt == COMP_RT_OK && s.n > 0) {
+        tree_t const *n = *(tree_t const **)tree_stack_top(&s);
+        tree_stack_pop(&s);
+
+        tree_t const *c[] = {n->left, n->right};  // de kinderen.
+        for (int i = 0; rt == COMP_RT_OK && i < 2; i++) {
+            bool seen;
+            if (c[i] == NULL) {
+                continue;
+            }
+
+            rt = comp_count_ref(refs, c[i], &seen);
+            if (rt == COMP_RT_OK && !seen) {
+                f = tree_stack_push(&s);
+                rt = (f != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+                if (f != NULL) {
+                    *f = c[i];
+                }
+            }
+        }
+    }
+
+    tree_stack_free(&s);
+    return rt;
+}
+
+// Tel het aantal ouders van iedere node in de DAG.
+static comp_rt_e comp_count_refs(tree_map_t *refs,
+                                 tree_t const *const t, int depth) {
+    tree_t const *c[] = {t->left, t->right};  // de kinderen.
+
+    if (depth > TREE_DEPTH_MAX) {
+        return comp_count_refs_iter(refs, t);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        bool seen;
+        if (c[i] == NULL) {
+            continue;
+        }
+
+        if (comp_count_ref(refs, c[i], &seen) != COMP_RT_OK) {
+            return COMP_RT_ERR;
+        }
+
+        if (!seen &&
+            comp_count_refs(refs, c[i], depth + 1) != COMP_RT_OK) {
+            return COMP_RT_ERR;
+        }
+    }
+
+    return COMP_RT_OK;
+}
+
+// Begin met het compileren van een node. Een node die al
+// gecompileerd is wordt meteen uit zijn slot of als constante
+// gelezen, *done is dan true.
+static comp_rt_e comp_node_begin(comp_state_t *s,
+                                 tree_t const *const t, bool *done) {
+    void *v;  // slot of waarde van een al gecompileerde node.
+
+    *done = true;
+    if (tree_map_get(&s->slots, t, &v)) {
+        return comp_emit(s, COMP_OP_LOAD, (int)(intptr_t)v - 1, 0.0f);
+    } else if (tree_map_get(&s->consts, t, &v)) {
+        double c;
+        memcpy(&c, &v, sizeof(double));
+        return comp_emit(s, COMP_OP_NUMBER, 0, c);
+    }
+
+    *done = false;
+    if (comp_map_type[t->token.type] == COMP_OP_INVALID) {
+        return COMP_RT_ERR;
+    }
+
+    if (t->token.type == TOKEN_TYPE_VARIABLE &&
+        t->token.value.variable != 'x') {
+        return COMP_RT_ERR_FREE;
+    }
+
+    return COMP_RT_OK;
+}
+
+// Rond het compileren van een node af nadat de operanden gecompileerd
+// zijn, de operanden beginnen op l en r. Een operatie met meerdere
+// ouders wordt in een slot bewaard.
+static comp_rt_e comp_node_end(comp_state_t *s, tree_t const *const t,
+                               int l, int r) {
+    comp_program_t *p = s->p;
+    comp_op_e op = comp_map_type[t->token.type];
+    void *v;
+
+    if (t->token.type == TOKEN_TYPE_NUMBER) {
+        return comp_emit(s, op, 0, t->token.value.number);
+    }
+
+    if (t->token.type == TOKEN_TYPE_PI) {
+        return comp_emit(s, op, 0, PI);
+    }
+
+    // Vouw operaties met enkel constante operanden meteen op, zodat
+    // de machine alleen werk doet dat van x afhangt.
+    comp_rt_e rt;
+    bool binairy = token_is_operation_binairy(&t->token);
+    if (comp_is_constant(p, l, r) &&
+        (!binairy || comp_is_constant(p, r, p->n))) {
+        double c = comp_apply(op, p->d[l].value,
+                              binairy ? p->d[r].value : 0.0f);
+        s->depth -= binairy ? 2 : 1;
+        p->n = l;
+        rt = comp_emit(s, COMP_OP_NUMBER, 0, c);
+    } else {
+        rt = comp_emit(s, op, 0, 0.0f);
+    }
+
+    if (rt != COMP_RT_OK || !token_is_operation(&t->token) ||
+        !tree_map_get(&s->refs, t, &v) || (intptr_t)v < 2) {
+        return rt;
+    }
+
+    if (comp_is_constant(p, l, p->n)) {
+        memcpy(&v, &p->d[l].value, sizeof(double));
+        return tree_map_put(&s->consts, t, v) ? COMP_RT_OK
+                                                : COMP_RT_ERR;
+    }
+
+    int slot = p->slots++;
+    if (!tree_map_put(&s->slots, t, (void *)(intptr_t)(slot + 1))) {
+        return COMP_RT_ERR;
+    }
+    return comp_emit(s, COMP_OP_STORE, slot, 0.0f);
+}
+
+// Frame van de compiler met een expliciete stack.
+typedef struct {
+    tree_t const *t;
+    int l;  // start van de linkse operand.
+    int r;  // start van de rechtse operand.
+    int s;  // 0: begin, 1: links is klaar, 2: beide zijn klaar.
+} comp_frame_t;
+
+// Versie van comp_node() met een expliciete stack, de instructies
+// komen in dezelfde volgorde.
+static comp_rt_e comp_node_iter(comp_state_t *s,
+                                tree_t const *const t) {
+    tree_stack_t st = {.w = sizeof(comp_frame_t)};
+    comp_frame_t *f = tree_stack_push(&st);
+    comp_rt_e rt = (f != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+    tree_t const *c = NULL;  // het kind dat nu gecompileerd wordt.
+
+    if (f != NULL) {
+        f->t = t;
+    }
+
+    while (rt == COMP_RT_OK && st.n > 0) {
+        f = tree_stack_top(&st);
+        c = NULL;
+
+        if (f->s == 0) {
+            bool done;
+            rt = comp_node_begin(s, f->t, &done);
+            if (rt != COMP_RT_OK || done) {
+                tree_stack_pop(&st);
+                continue;
+            }
+
+            f->l = f->r = s->p->n;
+            f->s = 1;
+            if (token_is_operation(&f->t->token)) {
+                c = f->t->left;
+                rt = (c != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+            }
+        } else if (f->s == 1) {
+            f->r = s->p->n;
+            f->s = 2;
+            if (token_is_operation_binairy(&f->t->token)) {
+                c = f->t->right;
+                rt = (c != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+            }
+        } else {
+            rt = comp_node_end(s, f->t, f->l, f->r);
+            tree_stack_pop(&st);
+        }
+
+        if (rt == COMP_RT_OK && c != NULL) {
+            f = tree_stack_push(&st);
+            rt = (f != NULL) ? COMP_RT_OK : COMP_RT_ERR;
+            if (f != NULL) {
+                f->t = c;
+            }
+        }
+    }
+
+    tree_stack_free(&st);
+    return rt;
+}
+
+// Compileer een node, een operatie met meerdere ouders wordt maar een
+// keer gecompileerd en daarna uit een slot gelezen.
+static comp_rt_e comp_node(comp_state_t *s, tree_t const *const t,
+                           int depth) {
+    if (depth > TREE_DEPTH_MAX) {
+        return comp_node_iter(s, t);
+    }
+
+    bool done;
+    comp_rt_e rt = comp_node_begin(s, t, &done);
+    if (rt != COMP_RT_OK || done) {
+        return rt;
+    }
+
+    comp_program_t *p = s->p;
+    int l = p->n;  // start van de linkse operand.
+    int r = p->n;  // start van de rechtse operand.
+
+    if (token_is_operation(&t->token)) {
+        if (t->left == NULL) {
+            return COMP_RT_ERR;
+        }
+        rt = comp_node(s, t->left, depth + 1);
+        r = p->n;
+    }
+
+    if (rt == COMP_RT_OK && token_is_operation_binairy(&t->token)) {
+        if (t->right == NULL) {
+            return COMP_RT_ERR;
+        }
+        rt = comp_node(s, t->right, depth + 1);
+    }
+
+    if (rt != COMP_RT_OK) {
+        return rt;
+    }
+
+    return comp_node_end(s, t, l, r);
+}
+
+comp_rt_e comp_tree(comp_program_t *p, tree_t const *const t) {
+    p->n = 0;
+    p->depth = 0;
+    p->slots = 0;
+
+    if (t == NULL) {
+        return COMP_RT_ERR;
+    }
+
+    comp_state_t s = {.p = p, .depth = 0};
+    comp_rt_e rt = comp_count_refs(&s.refs, t, 0);
+    if (rt == COMP_RT_OK) {
+        rt = comp_node(&s, t, 0);
+    }
+
+    tree_map_free(&s.refs);
+    tree_map_free(&s.slots);
+    tree_map_free(&s.consts);
+    return rt;
+}
+
+double comp_eval(comp_program_t const *const p, double x) {
+    double b[COMP_STACK_SIZE];
+    double *s = b;  // de stack, gevolgd door de slots.
+    int i = -1;     // top van de stack.
+
+    if (p->depth + p->slots > COMP_STACK_SIZE) {
+        s = malloc((p->depth + p->slots) * sizeof(double));
+        if (s == NULL) {
+            return NAN;
+        }
+    }
+    double *sl = s + p->depth;  // de slots.
+
+    for (comp_instr_t const *c = p->d, *e = p->d + p->n; c < e; c++) {
+        switch (c->op) {
+            case COMP_OP_NUMBER:
+                s[++i] = c->value;
+                break;
+            case COMP_OP_X:
+                s[++i] = x;
+                break;
+            case COMP_OP_SIN:
+            case COMP_OP_COS:
+                s[i] = comp_apply(c->op, s[i], 0.0f);
+                break;
+            case COMP_OP_LOAD:
+                s[++i] = sl[c->slot];
+                break;
+            case COMP_OP_STORE:
+                sl[c->slot] = s[i];
+                break;
+            default:
+                i--;
+                s[i] = comp_apply(c->op, s[i], s[i + 1]);
+                break;
+        }
+    }
+
+    double v = (i == 0) ? s[0] : NAN;
+    if (s != b) {
+        free(s);
+    }
+    return v;
+}
+
+// Een duaal getal v + d * e, met e * e = 0.
+typedef struct {
+    double v;  // de waarde.
+    double d;  // de afgeleide.
+} comp_dual_t;
+
+// Pas een operatie toe op duale getallen, r wordt genegeerd door de
+// unaire operaties.
+static inline comp_dual_t comp_apply_dual(comp_op_e op, comp_dual_t l,
+                                          comp_dual_t r) {
+    double v = comp_apply(op, l.v, r.v);
+    switch (op) {
+        case COMP_OP_MINUS:
+            return (comp_dual_t){v, l.d - r.d};
+        case COMP_OP_PLUS:
+            return (comp_dual_t){v, l.d + r.d};
+        case COMP_OP_MULTIPLY:
+            return (comp_dual_t){v, l.d * r.v + l.v * r.d};
+        case COMP_OP_DIVIDE:
+            return (comp_dual_t){v, (l.d - v * r.d) / r.v};
+        case COMP_OP_POWER: {
+            // Een constante exponent geeft geen log, zodat een
+            // negatief grondtal geen nan geeft. Bij exponent 0 is de
+            // term 0, ook waar 0^-1 oneindig is, net als bij diff.
+            double d = (r.v == 0.0f)
+                           ? 0.0f
+                           : l.d * r.v * pow(l.v, r.v - 1.0f);
+            if (r.d != 0.0f) {
+                d += r.d * v * log(l.v);
+            }
+            return (comp_dual_t){v, d};
+        }
+        case COMP_OP_SIN:
+            return (comp_dual_t){v, l.d * cos(l.v)};
+        case COMP_OP_COS:
+            return (comp_dual_t){v, -l.d * sin(l.v)};
+        default:
+            return (comp_dual_t){NAN, NAN};
+    }
+}
+
+double comp_eval_dual(comp_program_t const *const p, double x,
+                      double *dx) {
+    comp_dual_t b[COMP_STACK_SIZE];
+    comp_dual_t *s = b;  // de stack, gevolgd door de slots.
+    int i = -1;          // top van de stack.
+
+    *dx = NAN;
+    if (p->depth + p->slots > COMP_STACK_SIZE) {
+        s = malloc((p->depth + p->slots) * sizeof(comp_dual_t));
+        if (s == NULL) {
+            return NAN;
+        }
+    }
+    comp_dual_t *sl = s + p->depth;  // de slots.
+
+    for (comp_instr_t const *c = p->d, *e = p->d + p->n; c < e; c++) {
+        switch (c->op) {
+            case COMP_OP_NUMBER:
+                s[++i] = (comp_dual_t){c->value, 0.0f};
+                break;
+            case COMP_OP_X:
+                s[++i] = (comp_dual_t){x, 1.0f};
+                break;
+            case COMP_OP_SIN:
+            case COMP_OP_COS:
+                s[i] = comp_apply_dual(c->op, s[i], s[i]);
+                break;
+            case COMP_OP_LOAD:
+                s[++i] = sl[c->slot];
+                break;
+            case COMP_OP_STORE:
+                sl[c->slot] = s[i];
+                break;
+            default:
+                i--;
+                s[i] = comp_apply_dual(c->op, s[i], s[i + 1]);
+                break;
+        }
+    }
+
+    comp_dual_t v = (i == 0) ? s[0] : (comp_dual_t){NAN, NAN};
+    if (s != b) {
+        free(s);
+    }
+    *dx = v.d;
+    return v.v;
+}
+
+void comp_free(comp_program_t *p) {
+    free(p->d);
+    p->d = NULL;
+    p->n = p->size = p->depth = p->slots = 0;
+}
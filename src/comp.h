@@ -0,0 +1,68 @@
+/* Header van een compiler die een ABS boom omzet naar een platte
+ * programma in postfix notatie, en een stack machine die dit
+ * programma uitvoert. Het programma kan herhaaldelijk uitgevoerd
+ * worden voor verschillende waardes van x zonder de boom aan te
+ * passen. Gedeelde subbomen van een DAG worden een keer uitgerekend
+ * en daarna uit een slot gelezen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __COMP_H
+#define __COMP_H
+
+#include "tree.h"
+
+typedef enum {
+    COMP_RT_OK = 0,
+    COMP_RT_ERR,       // de boom is geen geldige expressie.
+    COMP_RT_ERR_FREE,  // de boom bevat variabelen anders dan x.
+} comp_rt_e;
+
+typedef enum {
+    COMP_OP_NUMBER,  // push value.
+    COMP_OP_X,       // push x.
+    COMP_OP_MINUS,
+    COMP_OP_PLUS,
+    COMP_OP_MULTIPLY,
+    COMP_OP_DIVIDE,
+    COMP_OP_POWER,
+    COMP_OP_SIN,
+    COMP_OP_COS,
+    COMP_OP_LOAD,   // push de waarde van een slot.
+    COMP_OP_STORE,  // kopieer de top van de stack naar een slot.
+    COMP_OP_INVALID,
+} comp_op_e;
+
+typedef struct {
+    comp_op_e op;
+    int slot;      // slot van COMP_OP_LOAD en COMP_OP_STORE.
+    double value;  // waarde van COMP_OP_NUMBER.
+} comp_instr_t;
+
+typedef struct {
+    comp_instr_t *d;  // de instructies in postfix volgorde.
+    int n;            // aantal instructies.
+    int size;         // capaciteit van d.
+    int depth;        // maximale diepte van de stack.
+    int slots;        // aantal slots voor gedeelde subbomen.
+} comp_program_t;
+
+// Compileer de boom naar een programma, het programma wordt
+// overschreven. Constanten en pi worden tijdens het compileren
+// uitgerekend, de boom wordt niet aangepast.
+comp_rt_e comp_tree(comp_program_t *p, tree_t const *const t);
+
+// Voer het programma uit voor een waarde van x.
+double comp_eval(comp_program_t const *const p, double x);
+
+// Voer het programma uit op duale getallen (x, 1), geeft de waarde in
+// x en schrijft de afgeleide naar x in dx. Er worden geen nodes
+// gealloceerd.
+double comp_eval_dual(comp_program_t const *const p, double x,
+                      double *dx);
+
+// Geef het geheugen van de instructies vrij.
+void comp_free(comp_program_t *p);
+
+#endif  // __COMP_H
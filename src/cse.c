@@ -0,0 +1,118 @@
+/* Implementatie van een pass die gemeenschappelijke subexpressies
+ * samenvoegt. De boom wordt van onder naar boven doorlopen, iedere
+ * node wordt met kinderen die al gedeeld zijn opgezocht in de tabel
+ * van tree_arena_intern(). Twee subbomen zijn daardoor gelijk precies
+ * wanneer hun wortels gelijk zijn, zodat een verwachte lineaire tijd
+ * genoeg is.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "cse.h"
+
+// Deel een node waarvan de kinderen al gedeeld zijn, n is het aantal
+// kinderen dat daarbij door een gedeelde subboom vervangen is. Die
+// tellen alleen wanneer de node zelf blijft, anders is de vervanging
+// al geteld bij de ouder die deze node vervangt.
+static tree_t* cse_node(tree_arena_handle_t const* const h, tree_t* t,
+                        tree_map_t* done, size_t* replaced,
+                        size_t n) {
+    // Verwijderde nodes blijven in de arena staan tot de volgende
+    // clear, ze kunnen nog gedeeld zijn met een node die later
+    // bezocht wordt.
+    tree_t* r = tree_arena_intern_node(h, t);
+    if (r == t) {
+        *replaced += n;
+    }
+
+    tree_map_put(done, t, r);
+    return r;
+}
+
+// Frame van de pass met een expliciete stack.
+typedef struct {
+    tree_t* t;
+    int s;  // aantal bezochte kinderen.
+} cse_frame_t;
+
+// Versie van _cse_tree() met een expliciete stack. De gedeelde versie
+// van een kind wordt na het bezoeken uit done gelezen.
+static tree_t* cse_tree_iter(tree_arena_handle_t const* const h,
+                             tree_t* t, tree_map_t* done,
+                             size_t* replaced) {
+    tree_stack_t s = {.w = sizeof(cse_frame_t)};
+    cse_frame_t* f = tree_stack_push(&s);
+    tree_t* r = t;  // de gedeelde versie van de laatste node.
+    void* v;
+
+    if (f != NULL) {
+        f->t = t;
+    }
+
+    while (f != NULL && s.n > 0) {
+        f = tree_stack_top(&s);
+        if (f->s < 2) {
+            tree_t* c = (f->s++ == 0) ? f->t->left : f->t->right;
+            if (c != NULL && !tree_map_get(done, c, &v)) {
+                f = tree_stack_push(&s);
+                if (f != NULL) {
+                    f->t = c;
+                }
+            }
+            continue;
+        }
+
+        tree_t* n = f->t;
+        size_t k = 0;  // aantal vervangen kinderen.
+        tree_stack_pop(&s);
+        if (n->left != NULL && tree_map_get(done, n->left, &v)) {
+            k += (n->left != v);
+            n->left = v;
+        }
+        if (n->right != NULL && tree_map_get(done, n->right, &v)) {
+            k += (n->right != v);
+            n->right = v;
+        }
+        r = cse_node(h, n, done, replaced, k);
+    }
+
+    if (f == NULL) {
+        tree_arena_set_err(h, TREE_ARENA_ERR_OVERFILLED);
+    }
+
+    tree_stack_free(&s);
+    return r;
+}
+
+static tree_t* _cse_tree(tree_arena_handle_t const* const h,
+                         tree_t* t, tree_map_t* done,
+                         size_t* replaced, int depth) {
+    void* r;  // de gedeelde versie van t.
+    if (t == NULL) {
+        return NULL;
+    } else if (tree_map_get(done, t, &r)) {
+        return r;
+    } else if (depth > TREE_DEPTH_MAX) {
+        return cse_tree_iter(h, t, done, replaced);
+    }
+
+    tree_t* left = _cse_tree(h, t->left, done, replaced, depth + 1);
+    tree_t* right =
+        _cse_tree(h, t->right, done, replaced, depth + 1);
+    size_t k = (left != t->left) + (right != t->right);
+    t->left = left;
+    t->right = right;
+
+    return cse_node(h, t, done, replaced, k);
+}
+
+size_t cse_tree(tree_arena_handle_t const* const h, tree_t* root) {
+    size_t replaced = 0;
+    tree_map_t done = {0};  // node naar de gedeelde versie.
+
+    // De wortel zelf staat nog niet in de tabel, dus blijft altijd
+    // de wortel.
+    _cse_tree(h, root, &done, &replaced, 0);
+    tree_map_free(&done);
+    return replaced;
+}
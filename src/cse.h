@@ -0,0 +1,21 @@
+/* Header van een pass die gemeenschappelijke subexpressies
+ * samenvoegt. Structureel gelijke subbomen worden vervangen door een
+ * enkele gedeelde subboom, waardoor de boom een DAG wordt.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __CSE_H
+#define __CSE_H
+
+#include <stddef.h>
+
+#include "tree.h"
+
+// Voeg de gelijke subbomen van root samen, root moet in de arena van
+// h staan. Geeft het aantal subbomen dat door een eerdere gelijke
+// subboom vervangen is. Een vervangen subboom binnen een subboom die
+// zelf vervangen wordt telt niet mee.
+size_t cse_tree(tree_arena_handle_t const *const h, tree_t *root);
+
+#endif  // __CSE_H
@@ -7,198 +7,277 @@
  *  - sin / cos
  *  - somregel
  *
- * De regels worden enkel toegepast op de variable 'x'.
+ * De regels worden enkel toegepast op de variable 'x'. Het resultaat
+ * is een DAG, operanden worden gedeeld in plaats van gekopieerd.
  *
  * Door: Jenny Vermeltfoort, Universiteit van Leiden.
  */
 
 #include "diff.h"
 
+#include <stdlib.h>
+
 #include "simp.h"
 
 typedef tree_t* (*diff_op_t)(tree_t const* const t,
-                             tree_arena_handle_t const* const h);
+                             tree_arena_handle_t const* const h,
+                             diff_cache_t* const c);
 
 diff_op_t diff_map_op[TOKEN_TYPE_INVALID + 1];
 
+// Frame van de versie van diff_sub() met een expliciete stack.
+typedef struct {
+    tree_t const* t;
+    int s;  // aantal bezochte kinderen.
+} diff_frame_t;
+
+// Versie van diff_sub() met een expliciete stack. De afgeleides van
+// de kinderen worden eerst uitgerekend en in de cache gezet, de regel
+// van een node vindt de afgeleides van zijn operanden daarna in de
+// cache en hoeft dus niet verder te recursen.
+static tree_t* diff_sub_iter(tree_t const* const t,
+                             tree_arena_handle_t const* const h,
+                             diff_cache_t* const c) {
+    tree_stack_t s = {.w = sizeof(diff_frame_t)};
+    diff_frame_t* f = tree_stack_push(&s);
+    tree_t* r = tree_arena_get_dummy(h);  // de laatste afgeleide.
+    void* v;
+
+    if (f != NULL) {
+        f->t = t;
+    }
+
+    while (f != NULL && s.n > 0 &&
+           tree_arena_get_err(h) == TREE_ARENA_ERR_NONE) {
+        f = tree_stack_top(&s);
+        if (f->s < 2) {
+            tree_t const* k =
+                (f->s++ == 0) ? f->t->left : f->t->right;
+            if (k != NULL && !tree_map_get(&c->d[0], k, &v)) {
+                f = tree_stack_push(&s);
+                if (f != NULL) {
+                    f->t = k;
+                }
+            }
+            continue;
+        }
+
+        tree_t const* n = f->t;
+        tree_stack_pop(&s);
+        r = diff_map_op[n->token.type](n, h, c);
+        if (tree_arena_get_err(h) == TREE_ARENA_ERR_NONE) {
+            tree_map_put(&c->d[0], n, r);
+        }
+    }
+
+    if (f == NULL) {
+        tree_arena_set_err(h, TREE_ARENA_ERR_OVERFILLED);
+    }
+
+    tree_stack_free(&s);
+    return r;
+}
+
+// Geef de afgeleide van een subboom. Een afgeleide die al in de cache
+// staat wordt hergebruikt, anders wordt hij uitgerekend met de regels
+// uit diff_map_op en bewaard.
+static tree_t* diff_sub(tree_t const* const t,
+                        tree_arena_handle_t const* const h,
+                        diff_cache_t* const c) {
+    void* v;  // de afgeleide uit de cache.
+    c->lookups++;
+    if (tree_map_get(&c->d[0], t, &v)) {
+        c->hits++;
+        return v;
+    } else if (c->depth > TREE_DEPTH_MAX) {
+        return diff_sub_iter(t, h, c);
+    }
+
+    // Een volle map is geen fout, de afgeleide wordt dan de volgende
+    // keer opnieuw uitgerekend.
+    c->depth++;
+    tree_t* r = diff_map_op[t->token.type](t, h, c);
+    c->depth--;
+    if (tree_arena_get_err(h) == TREE_ARENA_ERR_NONE) {
+        tree_map_put(&c->d[0], t, r);
+    }
+
+    return r;
+}
+
+// Zorg dat de cache een map heeft voor de ordes 1 tot en met n.
+static bool diff_cache_reserve(diff_cache_t* const c, int n) {
+    if (n <= c->orders) {
+        return true;
+    }
+
+    tree_map_t* d = realloc(c->d, n * sizeof(tree_map_t));
+    if (d == NULL) {
+        return false;
+    }
+
+    for (int k = c->orders; k < n; k++) {
+        d[k] = (tree_map_t){0};
+    }
+    c->d = d;
+    c->orders = n;
+    return true;
+}
+
+void diff_cache_clear(diff_cache_t* const c) {
+    for (int k = 0; k < c->orders; k++) {
+        tree_map_free(&c->d[k]);
+    }
+    free(c->d);
+    *c = (diff_cache_t){0};
+}
+
+// Geef een operatie node uit de arena. De nodes worden gedeeld via
+// tree_arena_intern(), dus operanden worden gerefereerd in plaats van
+// gekopieerd.
+static inline tree_t* diff_node(tree_arena_handle_t const* const h,
+                                token_type_e type, tree_t* left,
+                                tree_t* right) {
+    token_t token;
+    token_make_type(&token, type);
+    return tree_arena_intern(h, &token, left, right);
+}
+
+static inline tree_t* diff_number(tree_arena_handle_t const* const h,
+                                  double value) {
+    token_t token;
+    token_make_number(&token, value);
+    return tree_arena_intern(h, &token, NULL, NULL);
+}
+
 tree_t* diff_op_product(tree_t const* const t,
-                        tree_arena_handle_t const* const h) {
+                        tree_arena_handle_t const* const h,
+                        diff_cache_t* const c) {
+    // doel: * f g -> + * f g' * g f'
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* f = tree_deepcopy_sub(h, t->left);
-    tree_t* df = diff_map_op[t->left->token.type](t->left, h);
-    tree_t* g = tree_deepcopy_sub(h, t->right);
-    tree_t* dg = diff_map_op[t->right->token.type](t->right, h);
-
-    tree_t* r = tree_arena_new_node(h);  // root
-    r->left = tree_arena_new_node(h);
-    r->right = tree_arena_new_node(h);
-    r->left->left = f;
-    r->left->right = dg;
-    r->right->left = g;
-    r->right->right = df;
-    token_make_type(&r->token, TOKEN_TYPE_PLUS);
-    token_make_type(&r->left->token, TOKEN_TYPE_MULTIPLY);
-    token_make_type(&r->right->token, TOKEN_TYPE_MULTIPLY);
+    tree_t* df = diff_sub(t->left, h, c);
+    tree_t* dg = diff_sub(t->right, h, c);
 
-    return r;
+    return diff_node(
+        h, TOKEN_TYPE_PLUS,
+        diff_node(h, TOKEN_TYPE_MULTIPLY, t->left, dg),
+        diff_node(h, TOKEN_TYPE_MULTIPLY, t->right, df));
 }
 
 tree_t* diff_op_sum(tree_t const* const t,
-                    tree_arena_handle_t const* const h) {
+                    tree_arena_handle_t const* const h,
+                    diff_cache_t* const c) {
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* r = tree_arena_new_node(h);  // root
-    token_copy(&r->token, &t->token);
-    r->left = diff_map_op[t->left->token.type](t->left, h);
-    r->right = diff_map_op[t->right->token.type](t->right, h);
+    tree_t* df = diff_sub(t->left, h, c);
+    tree_t* dg = diff_sub(t->right, h, c);
 
-    return r;
+    return diff_node(h, t->token.type, df, dg);
 }
 
 tree_t* diff_op_variable(tree_t const* const t,
-                         tree_arena_handle_t const* const h) {
+                         tree_arena_handle_t const* const h,
+                         diff_cache_t* const c) {
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* r = tree_arena_new_node(h);  // root
-
     double v = (t->token.value.variable == 'x') ? 1.0f : 0.0f;
-    token_make_number(&r->token, v);
-
-    return r;
+    return diff_number(h, v);
 }
 
 tree_t* diff_op_quotient(tree_t const* const t,
-                         tree_arena_handle_t const* const h) {
-    // doel: / f g -> / - * f' g - f g' ^ g 2
+                         tree_arena_handle_t const* const h,
+                         diff_cache_t* const c) {
+    // doel: / f g -> / - * f' g * f g' ^ g 2
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* f = tree_deepcopy_sub(h, t->left);
-    tree_t* df = diff_map_op[t->left->token.type](t->left, h);
-    tree_t* g = tree_deepcopy_sub(h, t->right);
-    tree_t* dg = diff_map_op[t->right->token.type](t->right, h);
-
-    tree_t* d = tree_arena_new_node(h);  // denominator/noemer
-    d->left = tree_deepcopy_sub(h, t->right);
-    d->right = tree_arena_new_node(h);
-    token_make_type(&d->token, TOKEN_TYPE_POWER);
-    token_make_number(&d->right->token, 2.0f);
-
-    tree_t* n = tree_arena_new_node(h);  // numerator/teller
-    n->left = tree_arena_new_node(h);
-    n->right = tree_arena_new_node(h);
-    n->left->left = df;
-    n->left->right = g;
-    n->right->left = f;
-    n->right->right = dg;
-    token_make_type(&n->token, TOKEN_TYPE_MINUS);
-    token_make_type(&n->left->token, TOKEN_TYPE_MULTIPLY);
-    token_make_type(&n->right->token, TOKEN_TYPE_MULTIPLY);
-
-    tree_t* r = tree_arena_new_node(h);  // doel
-    r->left = n;
-    r->right = d;
-    token_make_type(&r->token, TOKEN_TYPE_DIVIDE);
+    tree_t* df = diff_sub(t->left, h, c);
+    tree_t* dg = diff_sub(t->right, h, c);
 
-    return r;
+    // denominator/noemer
+    tree_t* d = diff_node(h, TOKEN_TYPE_POWER, t->right,
+                          diff_number(h, 2.0f));
+
+    // numerator/teller
+    tree_t* n = diff_node(
+        h, TOKEN_TYPE_MINUS,
+        diff_node(h, TOKEN_TYPE_MULTIPLY, df, t->right),
+        diff_node(h, TOKEN_TYPE_MULTIPLY, t->left, dg));
+
+    return diff_node(h, TOKEN_TYPE_DIVIDE, n, d);
 }
 
 tree_t* diff_op_constant(tree_t const* const t,
-                         tree_arena_handle_t const* const h) {
+                         tree_arena_handle_t const* const h,
+                         diff_cache_t* const c) {
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* r = tree_arena_new_node(h);  // root
-    token_make_number(&r->token, 0.0f);
-    return r;
+    return diff_number(h, 0.0f);
 }
 
 tree_t* diff_op_power(tree_t const* const t,
-                      tree_arena_handle_t const* const h) {
+                      tree_arena_handle_t const* const h,
+                      diff_cache_t* const c) {
     // doel: ^ f(g) num ->  * * num ^ f'(g) num g'
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* df = tree_arena_new_node(h);  // f'(g)
-    tree_t* dg = diff_map_op[t->left->token.type](t->left, h);  // g'
-
-    tree_t* n = tree_arena_new_node(h);   // x^n -> n * x ^ (m)
-    tree_t* e = tree_deepcopy_sub(h, t);  // original expression
+    tree_t* dg = diff_sub(t->left, h, c);  // g'
 
     // f' = ^ e num -> * num ^ e (num-1)
-    token_make_type(&df->token, TOKEN_TYPE_MULTIPLY);  // *_1
-    df->left = n;
-    df->right = e;
-    token_make_number(&n->token, t->right->token.value.number);
-    token_make_number(&e->right->token,
-                      (e->right->token.value.number - 1.0f));
-
-    tree_t* r = tree_arena_new_node(h);  // doel
-    r->left = df;
-    r->right = dg;
-    token_make_type(&r->token, TOKEN_TYPE_MULTIPLY);  // * f'(g) g'
+    double n = t->right->token.value.number;
+    tree_t* e = diff_node(h, TOKEN_TYPE_POWER, t->left,
+                          diff_number(h, n - 1.0f));
+    tree_t* df =
+        diff_node(h, TOKEN_TYPE_MULTIPLY, diff_number(h, n), e);
 
-    return r;
+    return diff_node(h, TOKEN_TYPE_MULTIPLY, df, dg);  // * f'(g) g'
 }
 
 tree_t* diff_op_sin(tree_t const* const t,
-                    tree_arena_handle_t const* const h) {
+                    tree_arena_handle_t const* const h,
+                    diff_cache_t* const c) {
     // doel: sin(f) -> cos(f) * f'
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* dsin = tree_deepcopy_sub(h, t);
-    token_make_type(&dsin->token, TOKEN_TYPE_COS);
-
-    tree_t* df = diff_map_op[t->left->token.type](t->left, h);
+    tree_t* dsin = diff_node(h, TOKEN_TYPE_COS, t->left, NULL);
+    tree_t* df = diff_sub(t->left, h, c);
 
-    tree_t* r = tree_arena_new_node(h);  // doel
-    r->left = dsin;
-    r->right = df;
-    token_make_type(&r->token, TOKEN_TYPE_MULTIPLY);
-
-    return r;
+    return diff_node(h, TOKEN_TYPE_MULTIPLY, dsin, df);
 }
 
 tree_t* diff_op_cos(tree_t const* const t,
-                    tree_arena_handle_t const* const h) {
+                    tree_arena_handle_t const* const h,
+                    diff_cache_t* const c) {
     // doel: cos (f) -> -sin(f) * f'
     if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(h);
     }
 
-    tree_t* sin = tree_deepcopy_sub(h, t);  // cos_f = sin
-    token_make_type(&sin->token, TOKEN_TYPE_SIN);
-
-    tree_t* dcos = tree_arena_new_node(h);  // -sin
-    dcos->left = tree_arena_new_node(h);
-    dcos->right = sin;
-    token_make_type(&dcos->token, TOKEN_TYPE_MULTIPLY);
-    token_make_number(&dcos->left->token, -1.0f);
-
-    tree_t* df = diff_map_op[t->left->token.type](t->left, h);
-
-    tree_t* r = tree_arena_new_node(h);  // doel
-    r->left = dcos;
-    r->right = df;
-    token_make_type(&r->token, TOKEN_TYPE_MULTIPLY);
+    tree_t* sin = diff_node(h, TOKEN_TYPE_SIN, t->left, NULL);
+    tree_t* dcos = diff_node(h, TOKEN_TYPE_MULTIPLY,
+                             diff_number(h, -1.0f), sin);  // -sin
+    tree_t* df = diff_sub(t->left, h, c);
 
-    return r;
+    return diff_node(h, TOKEN_TYPE_MULTIPLY, dcos, df);
 }
 
 tree_t* diff_op_invalid(tree_t const* const t,
-                        tree_arena_handle_t const* const h) {
+                        tree_arena_handle_t const* const h,
+                        diff_cache_t* const c) {
     return tree_arena_get_dummy(h);
 }
 
@@ -216,12 +295,24 @@ diff_op_t diff_map_op[] = {
     [TOKEN_TYPE_PI] = diff_op_constant,
 };
 
-tree_t* diff_tree(tree_t* t, tree_arena_handle_t const* const h) {
-    if (t == NULL || h == NULL) {
+tree_t* diff_tree_n(tree_t* t, tree_arena_handle_t const* const th,
+                    tree_arena_handle_t const* const h, int n,
+                    diff_cache_t* const c) {
+    if (t == NULL || th == NULL || h == NULL || n < 1 ||
+        !diff_cache_reserve(c, n)) {
         return NULL;
     }
 
-    simp_tree(t);
+    simp_stats_t stats = {0};  // het standaard budget.
+    simp_tree(th, t, &stats);
+    c->zeros += stats.zeros;
+
+    // De bron wordt eerst gedeeld in de arena gezet, zodat de
+    // regels naar de operanden kunnen verwijzen in plaats van ze te
+    // kopieren. Een bron die al in de arena staat, bijvoorbeeld een
+    // eerdere afgeleide, geeft dezelfde nodes en dus dezelfde
+    // sleutels in de cache.
+    tree_t* s = tree_arena_intern_sub(h, t);
 
     // De implementatie maakt gebruik van de arena error handling om
     // te bepalen of alle nieuwe nodes binnen de page van de arena
@@ -236,12 +327,35 @@ tree_t* diff_tree(tree_t* t, tree_arena_handle_t const* const h) {
     // vol is, hierdoor krijgen we geen segfaults en gaat het
     // programma gewoon door. Is wat efficienter dan constant alle
     // node pointers te moeten matchen met NULL.
-    tree_t* r = diff_map_op[t->token.type](t, h);
-    if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
-        return NULL;
+    tree_t* r = s;  // de afgeleide van orde k.
+    for (int k = 1; k <= n; k++) {
+        void* v;  // de k-de afgeleide van s uit de cache.
+        c->lookups++;
+        if (tree_map_get(&c->d[k - 1], s, &v)) {
+            c->hits++;
+            r = v;
+            continue;
+        }
+
+        r = diff_sub(r, h, c);
+        if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
+            return NULL;
+        }
+
+        // Het simplificeren behoudt de waarde van de nodes, de
+        // afgeleides in de cache blijven dus geldig.
+        simp_tree(h, r, &stats);
+        c->zeros += stats.zeros;
+        tree_map_put(&c->d[k - 1], s, r);
     }
 
-    simp_tree(r);
+    return r;
+}
 
+tree_t* diff_tree(tree_t* t, tree_arena_handle_t const* const th,
+                  tree_arena_handle_t const* const h) {
+    diff_cache_t c = {0};
+    tree_t* r = diff_tree_n(t, th, h, 1, &c);
+    diff_cache_clear(&c);
     return r;
 }
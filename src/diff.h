@@ -8,6 +8,33 @@
 
 #include "tree.h"
 
-tree_t* diff_tree(tree_t* t, tree_arena_handle_t const* const h);
+// Cache van afgeleides binnen een arena. Per orde k is er een map van
+// een subboom naar zijn k-de afgeleide. De subbomen worden gedeeld
+// via tree_arena_intern(), gelijke subbomen hebben dus hetzelfde
+// adres en het adres dient als structurele sleutel. De cache is
+// geldig tot de arena geleegd wordt, een lege cache is {0}.
+typedef struct {
+    tree_map_t *d;   // de maps, d[k - 1] voor orde k.
+    int orders;      // aantal maps in d.
+    size_t lookups;  // aantal keer dat er gezocht is.
+    size_t hits;     // aantal keer dat de afgeleide bestond.
+    int depth;       // diepte van de recursie van de regels.
+    size_t zeros;    // aantal delingen door 0 bij het versimpelen.
+} diff_cache_t;
+
+// Differentieer de boom uit arena th een keer naar x, het resultaat
+// komt in h.
+tree_t* diff_tree(tree_t* t, tree_arena_handle_t const* const th,
+                  tree_arena_handle_t const* const h);
+
+// Differentieer de boom uit arena th n keer naar x, de boom wordt
+// eerst in th versimpeld. Afgeleides van subbomen die al eerder in c
+// uitgerekend zijn worden hergebruikt, c moet dus bij h horen.
+tree_t* diff_tree_n(tree_t* t, tree_arena_handle_t const* const th,
+                    tree_arena_handle_t const* const h, int n,
+                    diff_cache_t* const c);
+
+// Geef het geheugen van de cache vrij, de cache is daarna weer leeg.
+void diff_cache_clear(diff_cache_t* const c);
 
 #endif  // __DIFF_H
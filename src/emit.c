@@ -0,0 +1,190 @@
+/* Implementatie van een backend die een gecompileerd programma als C
+ * code schrijft en deze met gcc en dlopen kan laden.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "emit.h"
+
+#include <dlfcn.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Compiler en opties waarmee emit_load() de file compileert. Zonder
+// contractie naar FMA en zonder het herschrijven van pow, sin en cos
+// rondt de code precies af als de interpreter.
+#define EMIT_CC "gcc"
+#define EMIT_CFLAGS                              \
+    "-O3", "-march=native", "-ffp-contract=off", \
+        "-fno-builtin", "-shared", "-fPIC"
+
+// Aantal variabelen per regel in de declaratie van de stack.
+#define EMIT_DECL_LINE 8
+
+// Grootte van een operand als tekst, genoeg voor een double in %a.
+#define EMIT_OPERAND_SIZE 32
+
+// Operators die in infix notatie geschreven worden, de rest wordt
+// een aanroep van libm.
+char const *emit_map_infix[] = {
+    [0 ... COMP_OP_INVALID] = NULL, [COMP_OP_MINUS] = "-",
+    [COMP_OP_PLUS] = "+",           [COMP_OP_MULTIPLY] = "*",
+    [COMP_OP_DIVIDE] = "/",
+};
+
+char const *emit_map_call[] = {
+    [0 ... COMP_OP_INVALID] = NULL,
+    [COMP_OP_POWER] = "pow",
+    [COMP_OP_SIN] = "sin",
+    [COMP_OP_COS] = "cos",
+};
+
+static inline bool emit_is_binairy(comp_op_e op) {
+    return (op == COMP_OP_MINUS || op == COMP_OP_PLUS ||
+            op == COMP_OP_MULTIPLY || op == COMP_OP_DIVIDE ||
+            op == COMP_OP_POWER);
+}
+
+// Schrijf de operand die c op de stack zet naar d. Een getal wordt
+// hexadecimaal geschreven, zodat de waarde exact gelijk blijft.
+static void emit_operand(char *d, comp_instr_t const *c) {
+    switch (c->op) {
+        case COMP_OP_X:
+            strcpy(d, "x");
+            break;
+        case COMP_OP_LOAD:
+            snprintf(d, EMIT_OPERAND_SIZE, "s%d", c->slot);
+            break;
+        default:
+            // Ook het teken van een nan blijft gelijk.
+            if (!isfinite(c->value)) {
+                snprintf(d, EMIT_OPERAND_SIZE, "%s%s",
+                         signbit(c->value) ? "-" : "",
+                         isnan(c->value) ? "NAN" : "INFINITY");
+            } else {
+                snprintf(d, EMIT_OPERAND_SIZE, "%a", c->value);
+            }
+            break;
+    }
+}
+
+// Schrijf t[k] = t[k] op r, waarbij r een variabele of getal is.
+static void emit_binairy(FILE *f, comp_op_e op, int k,
+                         char const *r) {
+    if (emit_map_infix[op] != NULL) {
+        fprintf(f, "    t%d = t%d %s %s;\n", k, k, emit_map_infix[op],
+                r);
+    } else {
+        fprintf(f, "    t%d = %s(t%d, %s);\n", k,
+                emit_map_call[op], k, r);
+    }
+}
+
+emit_rt_e emit_write(FILE *f, comp_program_t const *const p) {
+    fprintf(f,
+            "/* Generated by boom.bin. */\n\n"
+            "#include <math.h>\n\n"
+            "double " EMIT_NAME "(double x) {\n");
+
+    // Iedere plek op de stack is een variabele, gcc wijst deze zelf
+    // aan registers toe.
+    fprintf(f, "    double t0");
+    for (int k = 1; k < p->depth; k++) {
+        fprintf(f, (k % EMIT_DECL_LINE == 0) ? ",\n           t%d"
+                                             : ", t%d",
+                k);
+    }
+    fprintf(f, ";\n");
+
+    char o[EMIT_OPERAND_SIZE];  // de huidige operand als tekst.
+    int k = -1;                 // de top van de stack.
+    comp_instr_t const *e = p->d + p->n;
+    for (comp_instr_t const *c = p->d; c < e; c++) {
+        switch (c->op) {
+            case COMP_OP_NUMBER:
+            case COMP_OP_X:
+            case COMP_OP_LOAD:
+                // Een operand die direct gebruikt wordt hoeft niet
+                // eerst op de stack gezet te worden.
+                emit_operand(o, c);
+                if (c + 1 < e && emit_is_binairy(c[1].op)) {
+                    emit_binairy(f, c[1].op, k, o);
+                    c++;
+                    break;
+                }
+                fprintf(f, "    t%d = %s;\n", ++k, o);
+                break;
+            case COMP_OP_SIN:
+            case COMP_OP_COS:
+                fprintf(f, "    t%d = %s(t%d);\n", k,
+                        emit_map_call[c->op], k);
+                break;
+            case COMP_OP_STORE:
+                // Een gedeelde subboom wordt een keer uitgerekend.
+                fprintf(f, "    double const s%d = t%d;\n", c->slot,
+                        k);
+                break;
+            default:
+                k--;
+                snprintf(o, sizeof(o), "t%d", k + 1);
+                emit_binairy(f, c->op, k, o);
+                break;
+        }
+    }
+
+    fprintf(f, "    return t0;\n}\n");
+    return ferror(f) ? EMIT_RT_ERR_WRITE : EMIT_RT_OK;
+}
+
+emit_rt_e emit_load(emit_lib_t *l, char const *path) {
+    emit_unload(l);
+
+    // dlopen zoekt een naam zonder '/' in de library paden.
+    size_t n = strlen(path);
+    char *so = malloc(n + sizeof("./.so"));
+    if (so == NULL) {
+        return EMIT_RT_ERR_LOAD;
+    }
+    sprintf(so, "%s%s.so", (strchr(path, '/') == NULL) ? "./" : "",
+            path);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp(EMIT_CC, EMIT_CC, EMIT_CFLAGS, "-o", so, path, "-lm",
+               (char *)NULL);
+        _exit(127);
+    }
+
+    int status;
+    if (pid < 0 || waitpid(pid, &status, 0) != pid ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        free(so);
+        return EMIT_RT_ERR_CC;
+    }
+
+    l->h = dlopen(so, RTLD_NOW | RTLD_LOCAL);
+    free(so);
+    if (l->h == NULL) {
+        return EMIT_RT_ERR_LOAD;
+    }
+
+    l->f = (emit_fn_t)dlsym(l->h, EMIT_NAME);
+    if (l->f == NULL) {
+        emit_unload(l);
+        return EMIT_RT_ERR_LOAD;
+    }
+
+    return EMIT_RT_OK;
+}
+
+void emit_unload(emit_lib_t *l) {
+    if (l->h != NULL) {
+        dlclose(l->h);
+    }
+    l->h = NULL;
+    l->f = NULL;
+}
@@ -0,0 +1,48 @@
+/* Header van een backend die een gecompileerd programma als C code
+ * schrijft. De code is een enkele functie zonder branches, iedere
+ * plek op de stack van de machine is een lokale variabele en een
+ * gedeelde subboom wordt een keer uitgerekend in een eigen lokale
+ * variabele. De file kan ook met gcc gecompileerd en met dlopen
+ * geladen worden.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __EMIT_H
+#define __EMIT_H
+
+#include <stdio.h>
+
+#include "comp.h"
+
+// Naam van de functie in de gegenereerde code.
+#define EMIT_NAME "boom_eval"
+
+typedef enum {
+    EMIT_RT_OK = 0,
+    EMIT_RT_ERR_WRITE,  // schrijven naar de file is mislukt.
+    EMIT_RT_ERR_CC,     // de compiler kon niet uitgevoerd worden of
+                        // gaf een fout.
+    EMIT_RT_ERR_LOAD,   // dlopen of dlsym is mislukt.
+} emit_rt_e;
+
+// De geladen functie, geeft de waarde van de expressie in x.
+typedef double (*emit_fn_t)(double x);
+
+typedef struct {
+    emit_fn_t f;  // de functie, of NULL.
+    void *h;      // handle van dlopen.
+} emit_lib_t;
+
+// Schrijf het programma als de C functie
+// double EMIT_NAME(double x) naar f.
+emit_rt_e emit_write(FILE *f, comp_program_t const *const p);
+
+// Compileer de C file in path met gcc tot path.so en laad de
+// functie in l, een eerder geladen functie wordt vrijgegeven.
+emit_rt_e emit_load(emit_lib_t *l, char const *path);
+
+// Sluit de geladen library, l->f is daarna NULL.
+void emit_unload(emit_lib_t *l);
+
+#endif  // __EMIT_H
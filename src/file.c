@@ -5,24 +5,114 @@
 
 #include "file.h"
 
-void _file_write_tree(FILE* f, tree_t* root, int* i) {
-    token_string_t string = {0};
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Schrijf een node met de token als label.
+static void file_write_node(FILE* f, int id, tree_t const* t) {
+    token_string_t string;
+    int n = token_string(&t->token, string);
+    fprintf(f, "\t%i [label=\"%.*s\"]\n", id, n, string);
+}
+
+// Frame van de schrijver met een expliciete stack.
+typedef struct {
+    tree_t* t;
+    int id;  // id van de node.
+    int s;   // 0: schrijf de node, 1 en 2: schrijf een kind.
+} file_frame_t;
+
+// Versie van _file_write_tree() met een expliciete stack, de nodes en
+// verbindingen worden in dezelfde volgorde geschreven.
+static file_rt_e file_write_tree_iter(FILE* f, tree_t* root,
+                                      int* i, tree_map_t* ids) {
+    tree_stack_t s = {.w = sizeof(file_frame_t)};
+    file_frame_t* fr = tree_stack_push(&s);
+    void* id;  // id van een al geschreven kind.
+
+    if (fr != NULL) {
+        fr->t = root;
+        fr->id = *i;
+    }
+
+    while (fr != NULL && s.n > 0) {
+        fr = tree_stack_top(&s);
+        file_frame_t c = *fr;
+
+        if (c.s == 0) {
+            tree_map_put(ids, c.t, (void*)(intptr_t)c.id);
+            file_write_node(f, c.id, c.t);
+        }
+
+        // Na de node volgen het linkse en het rechtse kind, het frame
+        // is klaar zodra het rechtse kind aan de beurt is.
+        tree_t* child = (c.s == 1) ? c.t->left : c.t->right;
+        fr->s++;
+        if (c.s == 2) {
+            tree_stack_pop(&s);
+        }
+
+        if (c.s == 0 || child == NULL) {
+            continue;
+        } else if (tree_map_get(ids, child, &id)) {
+            fprintf(f, "\t%i -> %i\n", c.id, (int)(intptr_t)id);
+            continue;
+        }
+
+        (*i)++;
+        fprintf(f, "\t%i -> %i\n", c.id, *i);
+        fr = tree_stack_push(&s);
+        if (fr != NULL) {
+            fr->t = child;
+            fr->id = *i;
+        }
+    }
+
+    tree_stack_free(&s);
+    return (fr != NULL) ? FILE_RT_OK : FILE_RT_ERR;
+}
+
+file_rt_e _file_write_tree(FILE* f, tree_t* root, int* i,
+                           tree_map_t* ids, int depth);
+
+// Schrijf de verbinding naar een kind. Een gedeeld kind wordt maar
+// een keer geschreven, daarna wordt naar het bestaande id verwezen.
+file_rt_e _file_write_edge(FILE* f, int ir, tree_t* child, int* i,
+                           tree_map_t* ids, int depth) {
+    void* id;  // id van een al geschreven kind.
+    if (tree_map_get(ids, child, &id)) {
+        fprintf(f, "\t%i -> %i\n", ir, (int)(intptr_t)id);
+        return FILE_RT_OK;
+    }
+
+    (*i)++;
+    fprintf(f, "\t%i -> %i\n", ir, *i);
+    return _file_write_tree(f, child, i, ids, depth);
+}
+
+file_rt_e _file_write_tree(FILE* f, tree_t* root, int* i,
+                           tree_map_t* ids, int depth) {
+    if (depth > TREE_DEPTH_MAX) {
+        return file_write_tree_iter(f, root, i, ids);
+    }
+
     int ir = *i;
+    file_rt_e rt = FILE_RT_OK;
 
-    token_string(&root->token, string);
-    fprintf(f, "\t%i [label=\"%s\"]\n", *i, string);
+    tree_map_put(ids, root, (void*)(intptr_t)ir);
+    file_write_node(f, ir, root);
 
     if (root->left) {
-        (*i)++;
-        fprintf(f, "\t%i -> %i\n", ir, *i);
-        _file_write_tree(f, root->left, i);
+        rt = _file_write_edge(f, ir, root->left, i, ids, depth + 1);
     }
 
-    if (root->right) {
-        (*i)++;
-        fprintf(f, "\t%i -> %i\n", ir, *i);
-        _file_write_tree(f, root->right, i);
+    if (rt == FILE_RT_OK && root->right) {
+        rt = _file_write_edge(f, ir, root->right, i, ids, depth + 1);
     }
+
+    return rt;
 }
 
 file_rt_e file_write_tree(FILE* f, tree_t* root) {
@@ -32,8 +122,48 @@ file_rt_e file_write_tree(FILE* f, tree_t* root) {
 
     fprintf(f, "digraph G {\n");
     int i = 1;
-    _file_write_tree(f, root, &i);
+    tree_map_t ids = {0};  // node naar id van de al geschreven nodes.
+    file_rt_e rt = _file_write_tree(f, root, &i, &ids, 0);
+    tree_map_free(&ids);
     fprintf(f, "}\n");
 
+    return rt;
+}
+
+file_rt_e file_map(char const* path, char** d, size_t* size) {
+    *d = NULL;
+    *size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return FILE_RT_ERR;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return FILE_RT_ERR;
+    }
+
+    if (st.st_size > 0) {
+        void* m = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (m == MAP_FAILED) {
+            close(fd);
+            return FILE_RT_ERR;
+        }
+        madvise(m, st.st_size, MADV_SEQUENTIAL);
+        *d = m;
+        *size = st.st_size;
+    }
+
+    // De mapping blijft bestaan nadat de file gesloten is.
+    close(fd);
     return FILE_RT_OK;
 }
+
+void file_unmap(char* d, size_t size) {
+    if (d != NULL) {
+        munmap(d, size);
+    }
+}
@@ -24,4 +24,12 @@ file_rt_e file_write_tree(FILE* f, tree_t* root);
 // tree opgebouwd worden.
 file_rt_e file_read_tree(FILE* f, tree_t* root);
 
+// Map een file in het geheugen. De mapping is prive, de inhoud mag
+// dus aangepast worden zonder dat de file verandert. Een lege file
+// geeft d = NULL en size = 0.
+file_rt_e file_map(char const* path, char** d, size_t* size);
+
+// Verwijder een mapping van file_map().
+void file_unmap(char* d, size_t size);
+
 #endif  // __FILE_H
\ No newline at end of file
@@ -0,0 +1,287 @@
+/* Implementatie van reverse mode automatisch differentieren met een
+ * tape.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "grad.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI acos(0.0f) * 2.0f
+
+// Frame voor het op de tape zetten met een expliciete stack.
+typedef struct {
+    tree_t const *t;
+    int s;  // 0: begin, 1: de operanden staan op de tape.
+} grad_frame_t;
+
+static grad_rt_e grad_push(grad_tape_t *t, grad_node_t const *n) {
+    if (t->n >= t->size) {
+        int size = t->size ? t->size * 2 : 64;
+        grad_node_t *d = realloc(t->d, size * sizeof(grad_node_t));
+        if (d == NULL) {
+            return GRAD_RT_ERR;
+        }
+        t->d = d;
+
+        double *v = realloc(t->v, size * sizeof(double));
+        if (v == NULL) {
+            return GRAD_RT_ERR;
+        }
+        t->v = v;
+
+        double *a = realloc(t->a, size * sizeof(double));
+        if (a == NULL) {
+            return GRAD_RT_ERR;
+        }
+        t->a = a;
+        t->size = size;
+    }
+
+    t->d[t->n++] = *n;
+    return GRAD_RT_OK;
+}
+
+// Pas een operatie toe op de operanden, r wordt genegeerd door de
+// unaire operaties.
+static inline double grad_apply(token_type_e type, double l,
+                                double r) {
+    switch (type) {
+        case TOKEN_TYPE_MINUS:
+            return l - r;
+        case TOKEN_TYPE_PLUS:
+            return l + r;
+        case TOKEN_TYPE_MULTIPLY:
+            return l * r;
+        case TOKEN_TYPE_DIVIDE:
+            return l / r;
+        case TOKEN_TYPE_POWER:
+            return pow(l, r);
+        case TOKEN_TYPE_SIN:
+            return sin(l);
+        case TOKEN_TYPE_COS:
+            return cos(l);
+        default:
+            return NAN;
+    }
+}
+
+static inline bool grad_is_constant(grad_tape_t const *const t,
+                                    int i) {
+    return (i < 0 || t->d[i].type == TOKEN_TYPE_NUMBER);
+}
+
+// Index op de tape van een node die al op de tape staat.
+static inline int grad_index(tree_map_t const *const m,
+                             tree_t const *const n) {
+    void *v = NULL;
+    tree_map_get(m, n, &v);
+    return (int)(intptr_t)v - 1;
+}
+
+// Zet een node op de tape nadat zijn operanden op de tape staan.
+static grad_rt_e grad_node_end(grad_tape_t *t, tree_map_t *m,
+                               tree_t const *const n, bool *seen) {
+    token_t const *k = &n->token;
+    grad_node_t g = {.type = k->type, .l = -1, .r = -1};
+
+    if (token_is_operation_binairy(k)) {
+        g.l = grad_index(m, n->left);
+        g.r = grad_index(m, n->right);
+    } else if (token_is_operation(k)) {
+        g.l = grad_index(m, n->left);
+    } else if (k->type == TOKEN_TYPE_NUMBER) {
+        g.c = k->value.number;
+    } else if (k->type == TOKEN_TYPE_PI) {
+        g.type = TOKEN_TYPE_NUMBER;
+        g.c = PI;
+    } else if (k->type == TOKEN_TYPE_VARIABLE &&
+               (unsigned char)k->value.variable < ASCII_SYMBOLS) {
+        g.l = (unsigned char)k->value.variable;
+        seen[g.l] = true;
+    } else {
+        return GRAD_RT_ERR_TREE;
+    }
+
+    // Vouw een operatie met enkel constante operanden meteen op,
+    // zodat de sweeps alleen werk doen dat van de variabelen afhangt.
+    if (token_is_operation(k) && grad_is_constant(t, g.l) &&
+        grad_is_constant(t, g.r)) {
+        g.c = grad_apply(k->type, t->d[g.l].c,
+                         (g.r >= 0) ? t->d[g.r].c : 0.0f);
+        g.type = TOKEN_TYPE_NUMBER;
+        g.l = g.r = -1;
+    }
+
+    if (grad_push(t, &g) != GRAD_RT_OK ||
+        !tree_map_put(m, n, (void *)(intptr_t)t->n)) {
+        return GRAD_RT_ERR;
+    }
+    return GRAD_RT_OK;
+}
+
+grad_rt_e grad_record(grad_tape_t *t, tree_t const *const r) {
+    bool seen[ASCII_SYMBOLS] = {false};  // komt de variabele voor?
+    tree_map_t m = {0};  // node naar zijn index op de tape + 1.
+    tree_stack_t s = {.w = sizeof(grad_frame_t)};
+    grad_frame_t *f = tree_stack_push(&s);
+    grad_rt_e rt = (f != NULL) ? GRAD_RT_OK : GRAD_RT_ERR;
+
+    t->n = 0;
+    t->vars = 0;
+    if (f != NULL) {
+        f->t = r;
+    }
+
+    // Een gedeelde node komt maar een keer op de tape, zijn afgeleide
+    // wordt in de achterwaartse sweep over alle ouders opgeteld.
+    while (rt == GRAD_RT_OK && s.n > 0) {
+        f = tree_stack_top(&s);
+        tree_t const *n = f->t;
+        void *v;
+
+        if (f->s == 1) {
+            tree_stack_pop(&s);
+            rt = grad_node_end(t, &m, n, seen);
+            continue;
+        } else if (tree_map_get(&m, n, &v)) {
+            tree_stack_pop(&s);
+            continue;
+        }
+
+        // De rechtse operand wordt als eerste op de stack gelegd, zo
+        // komt de linkse operand eerst op de tape.
+        f->s = 1;
+        int k = token_is_operation_binairy(&n->token) ? 2
+                : token_is_operation(&n->token)       ? 1
+                                                      : 0;
+        tree_t const *c[] = {n->left, n->right};  // de kinderen.
+        for (int i = k - 1; rt == GRAD_RT_OK && i >= 0; i--) {
+            if (c[i] == NULL) {
+                rt = GRAD_RT_ERR_TREE;
+                break;
+            }
+
+            f = tree_stack_push(&s);
+            rt = (f != NULL) ? GRAD_RT_OK : GRAD_RT_ERR;
+            if (f != NULL) {
+                f->t = c[i];
+            }
+        }
+    }
+
+    tree_stack_free(&s);
+    tree_map_free(&m);
+    if (rt != GRAD_RT_OK) {
+        t->n = 0;
+        return rt;
+    }
+
+    // Nummer de variabelen op alfabet.
+    int index[ASCII_SYMBOLS];  // variabele naar zijn index.
+    for (int c = 0; c < ASCII_SYMBOLS; c++) {
+        if (seen[c]) {
+            t->var[t->vars] = c;
+            index[c] = t->vars++;
+        }
+    }
+
+    for (int i = 0; i < t->n; i++) {
+        if (t->d[i].type == TOKEN_TYPE_VARIABLE) {
+            t->d[i].l = index[t->d[i].l];
+        }
+    }
+
+    return GRAD_RT_OK;
+}
+
+double grad_eval(grad_tape_t *t, double const *x, double *g) {
+    grad_node_t const *d = t->d;
+    double *v = t->v;
+    double *a = t->a;
+
+    if (t->n == 0) {
+        return NAN;
+    }
+
+    // Voorwaarts, de waarde van iedere node.
+    for (int i = 0; i < t->n; i++) {
+        int l = d[i].l;
+        int r = d[i].r;
+        if (d[i].type == TOKEN_TYPE_NUMBER) {
+            v[i] = d[i].c;
+        } else if (d[i].type == TOKEN_TYPE_VARIABLE) {
+            v[i] = x[l];
+        } else {
+            v[i] =
+                grad_apply(d[i].type, v[l], (r >= 0) ? v[r] : 0.0f);
+        }
+    }
+
+    // Achterwaarts, a[i] is de afgeleide van de root naar node i. De
+    // operanden van een node staan voor de node, dus a[i] is compleet
+    // wanneer node i bereikt wordt.
+    memset(a, 0, t->n * sizeof(double));
+    memset(g, 0, t->vars * sizeof(double));
+    a[t->n - 1] = 1.0f;
+    for (int i = t->n - 1; i >= 0; i--) {
+        int l = d[i].l;
+        int r = d[i].r;
+        switch (d[i].type) {
+            case TOKEN_TYPE_VARIABLE:
+                g[l] += a[i];
+                break;
+            case TOKEN_TYPE_MINUS:
+                a[l] += a[i];
+                a[r] -= a[i];
+                break;
+            case TOKEN_TYPE_PLUS:
+                a[l] += a[i];
+                a[r] += a[i];
+                break;
+            case TOKEN_TYPE_MULTIPLY:
+                a[l] += a[i] * v[r];
+                a[r] += a[i] * v[l];
+                break;
+            case TOKEN_TYPE_DIVIDE:
+                a[l] += a[i] / v[r];
+                a[r] -= a[i] * v[i] / v[r];
+                break;
+            case TOKEN_TYPE_POWER:
+                // Een constante exponent heeft geen afgeleide nodig,
+                // log van een negatief grondtal zou nan geven. Bij
+                // exponent 0 is de term 0, ook waar 0^-1 oneindig is.
+                if (v[r] != 0.0f) {
+                    a[l] += a[i] * v[r] * pow(v[l], v[r] - 1.0f);
+                }
+                if (d[r].type != TOKEN_TYPE_NUMBER) {
+                    a[r] += a[i] * v[i] * log(v[l]);
+                }
+                break;
+            case TOKEN_TYPE_SIN:
+                a[l] += a[i] * cos(v[l]);
+                break;
+            case TOKEN_TYPE_COS:
+                a[l] -= a[i] * sin(v[l]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return v[t->n - 1];
+}
+
+void grad_free(grad_tape_t *t) {
+    free(t->d);
+    free(t->v);
+    free(t->a);
+    t->d = NULL;
+    t->v = NULL;
+    t->a = NULL;
+    t->n = t->size = t->vars = 0;
+}
@@ -0,0 +1,54 @@
+/* Header van reverse mode automatisch differentieren. De boom wordt
+ * een keer op een tape gezet, iedere gedeelde node maar een keer.
+ * Een voorwaartse sweep over de tape geeft de waarde van iedere
+ * node, een achterwaartse sweep geeft de afgeleide van de expressie
+ * naar iedere node. Zo kost de hele gradient een paar evaluaties,
+ * hoeveel variabelen de expressie ook heeft.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __GRAD_H
+#define __GRAD_H
+
+#include "ascii.h"
+#include "tree.h"
+
+typedef enum {
+    GRAD_RT_OK = 0,
+    GRAD_RT_ERR,       // er is geen geheugen meer.
+    GRAD_RT_ERR_TREE,  // de boom is geen geldige expressie.
+} grad_rt_e;
+
+typedef struct {
+    token_type_e type;  // operatie, getal of variabele.
+    int l;              // index van de linkse operand of variabele.
+    int r;              // index van de rechtse operand.
+    double c;           // waarde van een getal of pi.
+} grad_node_t;
+
+// De tape, in postfix volgorde zodat de operanden van een node altijd
+// voor de node staan.
+typedef struct {
+    grad_node_t *d;  // de nodes.
+    double *v;       // waarde van iedere node na grad_eval().
+    double *a;       // afgeleide naar iedere node na grad_eval().
+    int n;           // aantal nodes.
+    int size;        // capaciteit van d, v en a.
+    int vars;        // aantal verschillende variabelen.
+    // De variabelen, gesorteerd op het alfabet.
+    char var[ASCII_SYMBOLS];
+} grad_tape_t;
+
+// Zet de boom op de tape, de tape wordt overschreven.
+grad_rt_e grad_record(grad_tape_t *t, tree_t const *const r);
+
+// Geef de waarde van de expressie in het punt x, x[i] is de waarde
+// van variabele t->var[i]. De partiele afgeleide naar t->var[i] komt
+// in g[i].
+double grad_eval(grad_tape_t *t, double const *x, double *g);
+
+// Geef het geheugen van de tape vrij.
+void grad_free(grad_tape_t *t);
+
+#endif  // __GRAD_H
@@ -0,0 +1,427 @@
+/* Implementatie van de JIT compiler voor x86-64. Het programma wordt
+ * in een keer van voor naar achter vertaald. Plek k van de stack
+ * staat in xmm k, een plek vanaf JIT_REGS en de slots staan in het
+ * frame van de functie. Constanten staan achter de code en worden
+ * relatief aan rip gelezen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "jit.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+
+// Aantal plekken van de stack in een register, xmm14 en xmm15 zijn
+// vrij voor tussenresultaten.
+#define JIT_REGS 14
+#define JIT_BASE 14
+#define JIT_SCRATCH 15
+// Grootste gehele exponent die met herhaald kwadrateren wordt
+// uitgerekend, net als bij de gevectoriseerde evaluator.
+#define JIT_POWER_MAX 64
+// Grootste frame van de functie, voor een groter programma wordt de
+// interpreter gebruikt.
+#define JIT_FRAME_MAX (64 * 1024)
+// Het frame wordt per page aangesproken, zodat de guard page van de
+// stack van een thread niet overgeslagen wordt.
+#define JIT_PAGE 4096
+
+// Opcodes van de SSE2 instructies, na de escape 0x0F.
+#define JIT_MOVSD_LOAD 0x10
+#define JIT_MOVSD_STORE 0x11
+#define JIT_MOVAPD 0x28
+#define JIT_ADDSD 0x58
+#define JIT_MULSD 0x59
+#define JIT_SUBSD 0x5C
+#define JIT_DIVSD 0x5E
+
+typedef enum {
+    JIT_OPND_REG,  // een xmm register.
+    JIT_OPND_RSP,  // geheugen op een offset van rsp.
+    JIT_OPND_RIP,  // een constante achter de code.
+} jit_opnd_e;
+
+// Operand van een instructie, v is het register, de offset of de
+// index van de constante.
+typedef struct {
+    jit_opnd_e kind;
+    int32_t v;
+} jit_opnd_t;
+
+// Een constante en de plek van de disp32 die er naar wijst. Iedere
+// constante wordt door precies een instructie gelezen.
+typedef struct {
+    size_t at;
+    double v;
+} jit_const_t;
+
+typedef struct {
+    uint8_t *d;  // de code.
+    size_t n;
+    size_t size;
+    jit_const_t *c;  // de constanten.
+    size_t cn;
+    size_t csize;
+    int slots;  // aantal slots, de stack staat erachter.
+    bool err;   // is er geen geheugen meer?
+} jit_buf_t;
+
+// Map operaties aan de opcode van de SSE2 instructie.
+uint8_t jit_map_op[] = {
+    [0 ... COMP_OP_INVALID] = 0,
+    [COMP_OP_MINUS] = JIT_SUBSD,
+    [COMP_OP_PLUS] = JIT_ADDSD,
+    [COMP_OP_MULTIPLY] = JIT_MULSD,
+    [COMP_OP_DIVIDE] = JIT_DIVSD,
+};
+
+static void jit_emit(jit_buf_t *b, uint8_t const *s, size_t n) {
+    if (b->n + n > b->size) {
+        size_t size = b->size ? b->size * 2 : JIT_PAGE;
+        uint8_t *d = realloc(b->d, size);
+        if (d == NULL) {
+            b->err = true;
+            return;
+        }
+        b->d = d;
+        b->size = size;
+    }
+
+    memcpy(b->d + b->n, s, n);
+    b->n += n;
+}
+
+#define JIT_EMIT(b, ...)                                  \
+    jit_emit(b, (uint8_t const[]){__VA_ARGS__},           \
+             sizeof((uint8_t const[]){__VA_ARGS__}))
+
+static void jit_emit32(jit_buf_t *b, uint32_t v) {
+    uint8_t d[4];
+    memcpy(d, &v, sizeof(d));
+    jit_emit(b, d, sizeof(d));
+}
+
+static void jit_emit64(jit_buf_t *b, uint64_t v) {
+    uint8_t d[8];
+    memcpy(d, &v, sizeof(d));
+    jit_emit(b, d, sizeof(d));
+}
+
+// Voeg een constante toe, geeft de operand die hem leest.
+static jit_opnd_t jit_const(jit_buf_t *b, double v) {
+    if (b->cn >= b->csize) {
+        size_t size = b->csize ? b->csize * 2 : 64;
+        jit_const_t *c = realloc(b->c, size * sizeof(jit_const_t));
+        if (c == NULL) {
+            b->err = true;
+            return (jit_opnd_t){.kind = JIT_OPND_REG, .v = 0};
+        }
+        b->c = c;
+        b->csize = size;
+    }
+
+    b->c[b->cn] = (jit_const_t){.at = 0, .v = v};
+    return (jit_opnd_t){.kind = JIT_OPND_RIP, .v = b->cn++};
+}
+
+static inline jit_opnd_t jit_reg(int r) {
+    return (jit_opnd_t){.kind = JIT_OPND_REG, .v = r};
+}
+
+// De plek van de slot in het frame, na x.
+static inline jit_opnd_t jit_slot(int s) {
+    return (jit_opnd_t){.kind = JIT_OPND_RSP, .v = 8 * (1 + s)};
+}
+
+// De plek in het frame waar plek k van de stack bewaard wordt.
+static inline jit_opnd_t jit_home(jit_buf_t const *b, int k) {
+    return jit_slot(b->slots + k);
+}
+
+// Plek k van de stack, in een register of in het frame.
+static inline jit_opnd_t jit_pos(jit_buf_t const *b, int k) {
+    return (k < JIT_REGS) ? jit_reg(k) : jit_home(b, k);
+}
+
+// Schrijf een SSE2 instructie met register reg en operand o. De
+// prefix komt voor de REX byte, die alleen nodig is voor xmm8 en
+// hoger.
+static void jit_sse(jit_buf_t *b, uint8_t prefix, uint8_t op,
+                    int reg, jit_opnd_t o) {
+    int rm = (o.kind == JIT_OPND_REG) ? o.v : 0;
+    uint8_t rex = 0x40 | ((reg & 8) >> 1) | ((rm & 8) >> 3);
+
+    JIT_EMIT(b, prefix);
+    if (rex != 0x40) {
+        JIT_EMIT(b, rex);
+    }
+    JIT_EMIT(b, 0x0F, op);
+
+    switch (o.kind) {
+        case JIT_OPND_REG:
+            JIT_EMIT(b, 0xC0 | (reg & 7) << 3 | (rm & 7));
+            break;
+        case JIT_OPND_RSP:
+            JIT_EMIT(b, 0x84 | (reg & 7) << 3, 0x24);
+            jit_emit32(b, o.v);
+            break;
+        case JIT_OPND_RIP:
+            JIT_EMIT(b, 0x05 | (reg & 7) << 3);
+            if (!b->err) {
+                b->c[o.v].at = b->n;
+            }
+            jit_emit32(b, 0);
+            break;
+    }
+}
+
+// Kopieer src naar dst, via xmm15 wanneer beide in het geheugen
+// staan.
+static void jit_move(jit_buf_t *b, jit_opnd_t dst, jit_opnd_t src) {
+    if (dst.kind == JIT_OPND_REG && src.kind == JIT_OPND_REG) {
+        if (dst.v != src.v) {
+            jit_sse(b, 0x66, JIT_MOVAPD, dst.v, src);
+        }
+    } else if (dst.kind == JIT_OPND_REG) {
+        jit_sse(b, 0xF2, JIT_MOVSD_LOAD, dst.v, src);
+    } else if (src.kind == JIT_OPND_REG) {
+        jit_sse(b, 0xF2, JIT_MOVSD_STORE, src.v, dst);
+    } else {
+        jit_sse(b, 0xF2, JIT_MOVSD_LOAD, JIT_SCRATCH, src);
+        jit_sse(b, 0xF2, JIT_MOVSD_STORE, JIT_SCRATCH, dst);
+    }
+}
+
+// dst = dst op src, via xmm15 wanneer dst in het geheugen staat.
+static void jit_arith(jit_buf_t *b, uint8_t op, jit_opnd_t dst,
+                      jit_opnd_t src) {
+    if (dst.kind == JIT_OPND_REG) {
+        jit_sse(b, 0xF2, op, dst.v, src);
+        return;
+    }
+
+    jit_move(b, jit_reg(JIT_SCRATCH), dst);
+    jit_sse(b, 0xF2, op, JIT_SCRATCH, src);
+    jit_move(b, dst, jit_reg(JIT_SCRATCH));
+}
+
+// dst = dst^n met herhaald kwadrateren, n is minstens 1.
+static void jit_power(jit_buf_t *b, jit_opnd_t dst, int n) {
+    bool first = true;  // is xmm15 nog leeg?
+
+    jit_move(b, jit_reg(JIT_BASE), dst);
+    for (; n > 0; n >>= 1) {
+        if ((n & 1) && first) {
+            jit_move(b, jit_reg(JIT_SCRATCH), jit_reg(JIT_BASE));
+            first = false;
+        } else if (n & 1) {
+            jit_sse(b, 0xF2, JIT_MULSD, JIT_SCRATCH,
+                    jit_reg(JIT_BASE));
+        }
+        if (n > 1) {
+            jit_sse(b, 0xF2, JIT_MULSD, JIT_BASE, jit_reg(JIT_BASE));
+        }
+    }
+    jit_move(b, dst, jit_reg(JIT_SCRATCH));
+}
+
+// Roep fn aan met plek k, en bij een binaire functie plek k + 1, als
+// argumenten. Het resultaat komt op plek k. Alle xmm registers worden
+// door de aanroep overschreven, dus de plekken onder k worden
+// eromheen in het frame bewaard.
+static void jit_call(jit_buf_t *b, void *fn, int k, bool binairy) {
+    int live = (k < JIT_REGS) ? k : JIT_REGS;
+
+    for (int i = 0; i < live; i++) {
+        jit_move(b, jit_home(b, i), jit_reg(i));
+    }
+    jit_move(b, jit_reg(0), jit_pos(b, k));
+    if (binairy) {
+        jit_move(b, jit_reg(1), jit_pos(b, k + 1));
+    }
+
+    JIT_EMIT(b, 0x48, 0xB8);  // mov rax, imm64
+    jit_emit64(b, (uint64_t)(uintptr_t)fn);
+    JIT_EMIT(b, 0xFF, 0xD0);  // call rax
+
+    jit_move(b, jit_pos(b, k), jit_reg(0));
+    for (int i = 0; i < live; i++) {
+        jit_move(b, jit_reg(i), jit_home(b, i));
+    }
+}
+
+static inline bool jit_is_arith(comp_instr_t const *c,
+                                comp_instr_t const *e) {
+    return c < e && jit_map_op[c->op] != 0;
+}
+
+// Is de instructie een constante gehele exponent van de volgende
+// macht?
+static inline bool jit_is_power(comp_instr_t const *c,
+                                comp_instr_t const *e) {
+    return c + 1 < e && c[1].op == COMP_OP_POWER &&
+           c->op == COMP_OP_NUMBER && c->value >= 1 &&
+           c->value <= JIT_POWER_MAX && c->value == (int)c->value;
+}
+
+// Vertaal de instructies, k is de top van de stack.
+static void jit_program(jit_buf_t *b, comp_program_t const *const p) {
+    comp_instr_t const *e = p->d + p->n;
+    int k = -1;
+
+    for (comp_instr_t const *c = p->d; c < e && !b->err; c++) {
+        jit_opnd_t src;  // operand van een push.
+
+        switch (c->op) {
+            case COMP_OP_NUMBER:
+                if (jit_is_power(c, e)) {
+                    jit_power(b, jit_pos(b, k), (int)c->value);
+                    c++;
+                    continue;
+                }
+                src = jit_const(b, c->value);
+                break;
+            case COMP_OP_X:
+                src = jit_slot(-1);
+                break;
+            case COMP_OP_LOAD:
+                src = jit_slot(c->slot);
+                break;
+            case COMP_OP_STORE:
+                jit_move(b, jit_slot(c->slot), jit_pos(b, k));
+                continue;
+            case COMP_OP_SIN:
+                jit_call(b, (void *)sin, k, false);
+                continue;
+            case COMP_OP_COS:
+                jit_call(b, (void *)cos, k, false);
+                continue;
+            case COMP_OP_POWER:
+                k--;
+                jit_call(b, (void *)pow, k, true);
+                continue;
+            case COMP_OP_MINUS:
+            case COMP_OP_PLUS:
+            case COMP_OP_MULTIPLY:
+            case COMP_OP_DIVIDE:
+                k--;
+                jit_arith(b, jit_map_op[c->op], jit_pos(b, k),
+                          jit_pos(b, k + 1));
+                continue;
+            default:
+                b->err = true;
+                continue;
+        }
+
+        // Een operand die direct door een operatie gebruikt wordt
+        // komt niet eerst op de stack.
+        if (jit_is_arith(c + 1, e)) {
+            jit_arith(b, jit_map_op[c[1].op], jit_pos(b, k), src);
+            c++;
+        } else {
+            k++;
+            jit_move(b, jit_pos(b, k), src);
+        }
+    }
+}
+
+// Zet de code en constanten in een nieuwe page, die daarna alleen nog
+// uitgevoerd kan worden.
+static jit_rt_e jit_map(jit_t *j, jit_buf_t *b) {
+    while (b->n % sizeof(double) != 0) {
+        JIT_EMIT(b, 0xCC);  // int3
+    }
+    if (b->err) {
+        return JIT_RT_ERR;
+    }
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = b->n + b->cn * sizeof(double);
+    size = (size + page - 1) / page * page;
+    uint8_t *d = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (d == MAP_FAILED) {
+        return JIT_RT_UNAVAILABLE;
+    }
+
+    memcpy(d, b->d, b->n);
+    for (size_t i = 0; i < b->cn; i++) {
+        size_t at = b->n + i * sizeof(double);
+        int32_t disp = (int32_t)(at - (b->c[i].at + 4));
+        memcpy(d + at, &b->c[i].v, sizeof(double));
+        memcpy(d + b->c[i].at, &disp, sizeof(disp));
+    }
+
+    if (mprotect(d, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(d, size);
+        return JIT_RT_UNAVAILABLE;
+    }
+
+    j->code = d;
+    j->size = size;
+    j->f = (jit_fn_t)(void *)d;
+    return JIT_RT_OK;
+}
+
+jit_rt_e jit_compile(jit_t *j, comp_program_t const *const p) {
+    jit_free(j);
+
+    // Het frame bevat x, de slots en de stack. Bij de ingang staat
+    // rsp op 8 modulo 16, de aanroepen van libm verwachten 0.
+    size_t frame = 8 * (1 + (size_t)p->slots + (size_t)p->depth);
+    frame += (frame % 16 == 8) ? 0 : 8;
+    if (p->n == 0 || frame > JIT_FRAME_MAX) {
+        return JIT_RT_UNAVAILABLE;
+    }
+
+    jit_buf_t b = {.slots = p->slots};
+    size_t left = frame;  // deel van het frame dat nog moet.
+    for (; left > JIT_PAGE; left -= JIT_PAGE) {
+        JIT_EMIT(&b, 0x48, 0x81, 0xEC);  // sub rsp, imm32
+        jit_emit32(&b, JIT_PAGE);
+        JIT_EMIT(&b, 0x48, 0x83, 0x0C, 0x24, 0x00);  // or [rsp], 0
+    }
+    JIT_EMIT(&b, 0x48, 0x81, 0xEC);
+    jit_emit32(&b, left);
+    jit_move(&b, jit_slot(-1), jit_reg(0));
+
+    jit_program(&b, p);
+
+    // Het resultaat staat op plek 0, dus al in xmm0.
+    JIT_EMIT(&b, 0x48, 0x81, 0xC4);  // add rsp, imm32
+    jit_emit32(&b, frame);
+    JIT_EMIT(&b, 0xC3);  // ret
+
+    jit_rt_e rt = jit_map(j, &b);
+    free(b.d);
+    free(b.c);
+    return rt;
+}
+
+void jit_free(jit_t *j) {
+    if (j->code != NULL) {
+        munmap(j->code, j->size);
+    }
+    *j = (jit_t){0};
+}
+
+#else
+
+jit_rt_e jit_compile(jit_t *j, comp_program_t const *const p) {
+    jit_free(j);
+    return JIT_RT_UNAVAILABLE;
+}
+
+void jit_free(jit_t *j) {
+    *j = (jit_t){0};
+}
+
+#endif
@@ -0,0 +1,41 @@
+/* Header van een JIT compiler die een gecompileerd programma omzet
+ * naar x86-64 machinecode. Iedere plek op de stack van de machine
+ * krijgt een eigen SSE2 register, alleen een diepe stack en de slots
+ * van gedeelde subbomen staan in het geheugen. Voor sin, cos en pow
+ * wordt libm aangeroepen. De code staat in een eigen executable page
+ * en wordt als een gewone functie aangeroepen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __JIT_H
+#define __JIT_H
+
+#include <stddef.h>
+
+#include "comp.h"
+
+typedef enum {
+    JIT_RT_OK = 0,
+    JIT_RT_ERR,          // er is geen geheugen meer.
+    JIT_RT_UNAVAILABLE,  // geen x86-64, of het programma is te groot.
+} jit_rt_e;
+
+// De gecompileerde functie, geeft de waarde van de expressie in x.
+typedef double (*jit_fn_t)(double x);
+
+typedef struct {
+    jit_fn_t f;  // de functie, of NULL.
+    void *code;  // de executable page.
+    size_t size;  // grootte van de mapping.
+} jit_t;
+
+// Compileer het programma naar machinecode, een eerdere functie in j
+// wordt vrijgegeven. Bij een fout blijft j->f NULL en moet
+// comp_eval() gebruikt worden.
+jit_rt_e jit_compile(jit_t *j, comp_program_t const *const p);
+
+// Geef de executable page vrij.
+void jit_free(jit_t *j);
+
+#endif  // __JIT_H
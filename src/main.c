@@ -8,9 +8,86 @@
  * Door: Jenny Vermeltfoort, Universiteit van Leiden.
  */
 
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
 #include "cli.h"
 
+// Grootste aantal nodes van de eerste arena page.
+#define MAIN_ARENA_NODES_MAX (1UL << 30)
+// Grootste aantal threads van de pool.
+#define MAIN_WORKERS_MAX 1024
+
+// Lees een aantal van hooguit max uit s, alleen cijfers zijn
+// toegestaan. Geeft false wanneer s geen geldig aantal is.
+static bool main_read_size(char const* s, size_t max, size_t* n) {
+    char* e;
+    if (*s < '0' || *s > '9') {
+        return false;
+    }
+
+    errno = 0;
+    unsigned long v = strtoul(s, &e, 10);
+    if (*e != '\0' || errno == ERANGE || v > max) {
+        return false;
+    }
+
+    *n = v;
+    return true;
+}
+
 int main(int argc, char** argv) {
-    cli_loop((argc == 2 && argv[1][0] == '-' && argv[1][1] == 's'));
+    cli_config_t config = {
+        .silent = false,
+        .workers = 0,
+        .batch = NULL,
+        .jobs = NULL,
+        .fold = false,
+    };
+    size_t first = 0;  // aantal nodes van de eerste arena page.
+    size_t workers = 0;  // aantal threads, 0 is het aantal CPU's.
+    tree_arena_page_e type = TREE_ARENA_PAGE_L1;
+
+    int o;
+    bool ok = true;  // zijn de flags geldig?
+    while (ok && (o = getopt(argc, argv, "sca:p:t:f:j:")) != -1) {
+        if (o == 's') {
+            config.silent = true;
+        } else if (o == 'c') {
+            config.fold = true;
+        } else if (o == 't') {
+            ok = main_read_size(optarg, MAIN_WORKERS_MAX, &workers);
+        } else if (o == 'f') {
+            config.batch = optarg;
+        } else if (o == 'j') {
+            config.jobs = optarg;
+        } else if (o == 'a') {
+            ok = main_read_size(optarg, MAIN_ARENA_NODES_MAX, &first);
+        } else if (o == 'p' && strcmp(optarg, "l1") == 0) {
+            type = TREE_ARENA_PAGE_L1;
+        } else if (o == 'p' && strcmp(optarg, "large") == 0) {
+            type = TREE_ARENA_PAGE_LARGE;
+        } else if (o == 'p' && strcmp(optarg, "huge") == 0) {
+            type = TREE_ARENA_PAGE_HUGE;
+        } else {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        fprintf(stderr,
+                "usage: %s [-s] [-c] [-a <nodes>] "
+                "[-p <l1|large|huge>] [-t <threads>] "
+                "[-f <file>] [-j <file>]\n",
+                argv[0]);
+        return 1;
+    }
+
+    config.workers = (int)workers;
+    tree_arena_configure(first, type);
+    cli_loop(&config);
     return 0;
 }
@@ -6,15 +6,30 @@
 
 #include "parser.h"
 
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "ascii.h"
+#include "parser_pow5.h"
 
 #define SYMBOL_LENGTH_SIN 3
 #define SYMBOL_LENGTH_COS 3
 #define SYMBOL_LENGTH_PI 2
 
+#define PI acos(0.0f) * 2.0f
+
+// Aantal significante cijfers dat exact in een uint64_t past.
+#define PARSER_DIGITS_FAST 19
+// Aantal significante cijfers dat voor strtod() bewaard wordt, vanaf
+// 768 cijfers kan een cijfer de afronding niet meer veranderen.
+#define PARSER_DIGITS_MAX 800
+// Grootste exponent die gelezen wordt, daarboven is het getal toch 0
+// of oneindig.
+#define PARSER_EXPONENT_MAX 100000
+
 token_type_e parser_char_token_type_translator[ASCII_SYMBOLS] = {
     [0 ...(ASCII_SYMBOLS - 1)] = TOKEN_TYPE_INVALID,
     ['*'] = TOKEN_TYPE_MULTIPLY,
@@ -24,44 +39,313 @@ token_type_e parser_char_token_type_translator[ASCII_SYMBOLS] = {
     ['^'] = TOKEN_TYPE_POWER,
 };
 
-void parser_read_int(parser_buf_t* buf, int* n, int* length) {
-    while (ascii_char_is_number[(int)*(buf->p)]) {
-        *n = *n * 10 + (*(buf->p) - 48);
-        (*length)++;
+void parser_refill(parser_buf_t* buf) {
+    size_t m = buf->e - buf->p;  // aantal karakters dat over is.
+    memmove(buf->d, buf->p, m);
+    buf->p = buf->d;
+    buf->l = buf->d;
+
+    size_t n = buf->refill(buf, buf->d + m,
+                           PARSER_STRING_BUFFER_SIZE - m);
+    buf->e = buf->d + m + n;
+    *(buf->e) = '\0';
+}
+
+// Lees het volgende blok van de regel uit de file in buf->ctx, de
+// '\n' aan het einde van de regel wordt niet in de buffer gezet.
+static size_t parser_refill_file(parser_buf_t* buf, char* d,
+                                 size_t size) {
+    if (fgets(d, size, buf->ctx) == NULL) {
+        buf->refill = NULL;
+        return 0;
+    }
+
+    size_t n = strlen(d);
+    if (n > 0 && d[n - 1] == '\n') {
+        d[--n] = '\0';
+        buf->refill = NULL;
+    }
+    return n;
+}
+
+bool parser_read_line(parser_buf_t* buf, FILE* f) {
+    buf->refill = parser_refill_file;
+    buf->ctx = f;
+    buf->p = buf->d;
+    buf->e = buf->d;
+    parser_refill(buf);
+
+    // Een lege regel bevat nog altijd de '\n', alleen aan het einde
+    // van de file wordt er niks gelezen.
+    return buf->e != buf->d || !feof(f);
+}
+
+void parser_skip_line(parser_buf_t* buf) {
+    while (buf->refill != NULL) {
+        buf->p = buf->e;
+        parser_refill(buf);
+    }
+    buf->p = buf->e;
+}
+
+void parser_skip_whitespace(parser_buf_t* buf) {
+    do {
+        while (ascii_char_is_whitespace[(int)*(buf->p)]) {
+            buf->p++;
+        }
+        parser_fill(buf, PARSER_TOKEN_MAX);
+    } while (ascii_char_is_whitespace[(int)*(buf->p)]);
+}
+
+// Een getal tijdens het lezen. De eerste PARSER_DIGITS_FAST
+// significante cijfers staan in w met waarde w * 10^e, de eerste
+// PARSER_DIGITS_MAX cijfers staan als tekst in d met waarde
+// d * 10^de voor wanneer strtod() nodig is.
+typedef struct {
+    uint64_t w;
+    int64_t e;
+    int n;           // aantal cijfers in w.
+    bool truncated;  // vielen er cijfers anders dan 0 buiten w?
+    char d[PARSER_DIGITS_MAX + 32];
+    int dn;       // aantal cijfers in d.
+    int64_t de;   // exponent van d.
+    bool sticky;  // vielen er cijfers anders dan 0 buiten d?
+} parser_number_t;
+
+// Voeg een cijfer toe aan het getal, frac geeft of het cijfer achter
+// de komma staat.
+static inline void parser_number_digit(parser_number_t* m, char c,
+                                       bool frac) {
+    if (m->n == 0 && c == '0') {  // voorloopnullen tellen niet mee.
+        m->e -= frac;
+        m->de -= frac;
+        return;
+    }
+
+    if (m->n < PARSER_DIGITS_FAST) {
+        m->w = m->w * 10 + (c - '0');
+        m->n++;
+        m->e -= frac;
+    } else {
+        m->e += !frac;
+        m->truncated |= (c != '0');
+    }
+
+    if (m->dn < PARSER_DIGITS_MAX) {
+        m->d[m->dn++] = c;
+        m->de -= frac;
+    } else {
+        m->de += !frac;
+        m->sticky |= (c != '0');
+    }
+}
+
+// Lees 8 cijfers tegelijk met SWAR, geeft false wanneer niet alle 8
+// karakters een cijfer zijn. Zie ook fast_float van Daniel Lemire.
+static inline bool parser_read_digits8(char const* p, uint64_t* v) {
+    uint64_t b;
+    memcpy(&b, p, sizeof(uint64_t));
+
+    if (((b + 0x4646464646464646) | (b - 0x3030303030303030)) &
+        0x8080808080808080) {
+        return false;
+    }
+
+    b -= 0x3030303030303030;
+    b = (b * 10) + (b >> 8);
+    b = (((b & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) +
+         (((b >> 16) & 0x000000FF000000FF) *
+          (1 + (10000ULL << 32)))) >>
+        32;
+    *v = (uint32_t)b;
+    return true;
+}
+
+// Lees een reeks cijfers in het getal, geeft het aantal cijfers. De
+// cijfers mogen over de grens van een blok heen lopen.
+static size_t parser_read_digits(parser_buf_t* buf,
+                                 parser_number_t* m, bool frac) {
+    size_t k = 0;  // aantal gelezen cijfers.
+    uint64_t v;    // waarde van 8 cijfers.
+
+    while (true) {
+        parser_fill(buf, 8);
+
+        // Zolang de cijfers in w passen worden er 8 tegelijk gelezen.
+        if ((m->n > 0 || *(buf->p) != '0') &&
+            m->n + 8 <= PARSER_DIGITS_FAST &&
+            m->dn + 8 <= PARSER_DIGITS_MAX && buf->e - buf->p >= 8 &&
+            parser_read_digits8(buf->p, &v)) {
+            m->w = m->w * 100000000 + v;
+            m->n += 8;
+            m->e -= frac ? 8 : 0;
+            memcpy(m->d + m->dn, buf->p, 8);
+            m->dn += 8;
+            m->de -= frac ? 8 : 0;
+            buf->p += 8;
+            k += 8;
+            continue;
+        }
+
+        if (!ascii_char_is_number[(int)*(buf->p)]) {
+            return k;
+        }
+
+        parser_number_digit(m, *(buf->p), frac);
         buf->p++;
+        k++;
+    }
+}
+
+// Lees de exponent achter een 'e', wanneer er geen exponent staat
+// wordt er niks gelezen.
+static void parser_read_exponent(parser_buf_t* buf,
+                                 parser_number_t* m) {
+    parser_fill(buf, 3);
+    char const* q = buf->p;
+    if (*q != 'e' && *q != 'E') {
+        return;
+    }
+
+    bool negative = (q[1] == '-');
+    q += (q[1] == '-' || q[1] == '+') ? 2 : 1;
+    if (!ascii_char_is_number[(int)*q]) {
+        return;
+    }
+
+    int64_t x = 0;  // de exponent.
+    buf->p += q - buf->p;
+    while (true) {
+        parser_fill(buf, 1);
+        if (!ascii_char_is_number[(int)*(buf->p)]) {
+            break;
+        }
+        if (x < PARSER_EXPONENT_MAX) {
+            x = x * 10 + (*(buf->p) - '0');
+        }
+        buf->p++;
+    }
+
+    m->e += negative ? -x : x;
+    m->de += negative ? -x : x;
+}
+
+// Reken w * 10^q uit met het algoritme van Eisel en Lemire, zie
+// "Number Parsing at a Gigabyte per Second". Geeft false wanneer de
+// afronding niet met zekerheid bepaald kan worden.
+static bool parser_eisel_lemire(uint64_t w, int64_t q, double* v) {
+    if (q < PARSER_POW5_MIN || q > PARSER_POW5_MAX) {
+        return false;
+    }
+
+    uint64_t const* f = parser_pow5[q - PARSER_POW5_MIN];
+    int64_t exponent = (((152170 + 65536) * q) >> 16) + 1024 + 63;
+    int lz = __builtin_clzll(w);
+    w <<= lz;
+
+    __uint128_t product = (__uint128_t)w * f[0];
+    uint64_t lower = (uint64_t)product;
+    uint64_t upper = (uint64_t)(product >> 64);
+
+    // Zijn de hoge bits niet genoeg, neem dan de lage 64 bits van de
+    // macht mee.
+    if ((upper & 0x1FF) == 0x1FF && lower + w < lower) {
+        __uint128_t low = (__uint128_t)w * f[1];
+        uint64_t middle = lower + (uint64_t)(low >> 64);
+        upper += (middle < lower);
+        if (middle + 1 == 0 && (upper & 0x1FF) == 0x1FF &&
+            (uint64_t)low + w < (uint64_t)low) {
+            return false;
+        }
+        lower = middle;
+    }
+
+    uint64_t upperbit = upper >> 63;
+    uint64_t mantissa = upper >> (upperbit + 9);
+    lz += (int)(1 ^ upperbit);
+
+    // Precies tussen twee doubles in, de afronding is onzeker.
+    if (lower == 0 && (upper & 0x1FF) == 0 && (mantissa & 3) == 1) {
+        return false;
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (1ULL << 53)) {
+        mantissa = (1ULL << 52);
+        lz--;
+    }
+    mantissa &= ~(1ULL << 52);
+
+    int64_t e = exponent - lz;
+    if (e < 1 || e > 2046) {  // subnormaal of oneindig.
+        return false;
+    }
+
+    mantissa |= (uint64_t)e << 52;
+    memcpy(v, &mantissa, sizeof(double));
+    return true;
+}
+
+// De waarde van het gelezen getal, zonder teken.
+static double parser_number_value(parser_number_t* m) {
+    static const double pow10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+        1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+        1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    double v;
+
+    if (m->n == 0) {
+        return 0.0f;
+    }
+
+    if (!m->truncated) {
+        // Zijn w en 10^e exact als double, dan is een enkele
+        // vermenigvuldiging of deling correct afgerond (Clinger).
+        if (m->w <= (1ULL << 53) && m->e >= -22 && m->e <= 22) {
+            v = (double)m->w;
+            return (m->e < 0) ? v / pow10[-m->e] : v * pow10[m->e];
+        }
+
+        if (parser_eisel_lemire(m->w, m->e, &v)) {
+            return v;
+        }
+    }
+
+    // Vanaf 768 cijfers kan een volgend cijfer de afronding niet meer
+    // veranderen, een enkel cijfer staat dus voor de rest.
+    if (m->sticky) {
+        m->d[m->dn++] = '1';
+        m->de--;
     }
+    snprintf(m->d + m->dn, sizeof(m->d) - m->dn, "e%lld",
+             (long long)m->de);
+    return strtod(m->d, NULL);
 }
 
 parser_rt_e parser_read_double(parser_buf_t* buf, double* n) {
-    int c = 0;     // characteristic
-    int m = 0;     // mantissa
-    int ml = 0;    // mantissa length
-    double p = 1;  // polarity of n
+    parser_fill(buf, PARSER_TOKEN_MAX);
+
+    parser_number_t m = {0};
+    bool negative = false;
 
     if (*(buf->p) == '-') {
-        p = -1;
+        negative = true;
         buf->p++;
     }
 
-    parser_read_int(buf, &c, ({
-                        int l;
-                        &l;
-                    }));
+    parser_read_digits(buf, &m, false);
     if (*(buf->p) == '.' || *(buf->p) == ',') {
         buf->p++;
-        parser_read_int(buf, &m, &ml);
-        if (ml == 0) {
+        if (parser_read_digits(buf, &m, true) == 0) {
             return PARSER_RT_INVALID_CHAR;
         }
     }
+    parser_read_exponent(buf, &m);
 
-    // verplaats de getallan van de mantissa in een double.
-    double md = (double)m;  // mantissa cast als double
-    while (ml--) {
-        md /= 10.0;
-    }
-
-    *n = ((double)c + md) * p;
+    double v = parser_number_value(&m);
+    *n = negative ? -v : v;
     return PARSER_RT_OK;
 }
 
@@ -135,16 +419,102 @@ int parser_cat_leaf_balance_value[] = {
     [TOKEN_CAT_OP_BINAIR] = 2,
 };
 
-parser_rt_e _parser_tokenize_string(
+typedef double (*parser_fold_op_t)(double l, double r);
+
+static double parser_fold_plus(double l, double r) {
+    return l + r;
+}
+
+static double parser_fold_minus(double l, double r) {
+    return l - r;
+}
+
+static double parser_fold_multiply(double l, double r) {
+    return l * r;
+}
+
+static double parser_fold_divide(double l, double r) {
+    return l / r;
+}
+
+static double parser_fold_power(double l, double r) {
+    return pow(l, r);
+}
+
+static double parser_fold_sin(double l, double r) {
+    return sin(l);
+}
+
+static double parser_fold_cos(double l, double r) {
+    return cos(l);
+}
+
+// Map operaties aan een token type, met dezelfde rekenregels als
+// simp.
+parser_fold_op_t parser_fold_op[] = {
+    [0 ... TOKEN_TYPE_INVALID] = NULL,
+    [TOKEN_TYPE_PLUS] = parser_fold_plus,
+    [TOKEN_TYPE_MINUS] = parser_fold_minus,
+    [TOKEN_TYPE_MULTIPLY] = parser_fold_multiply,
+    [TOKEN_TYPE_DIVIDE] = parser_fold_divide,
+    [TOKEN_TYPE_POWER] = parser_fold_power,
+    [TOKEN_TYPE_SIN] = parser_fold_sin,
+    [TOKEN_TYPE_COS] = parser_fold_cos,
+};
+
+// Lees de waarde van een getal of pi, geeft false voor een ander
+// kind.
+static inline bool parser_fold_value(tree_t const* t, double* v) {
+    if (t == NULL) {
+        return false;
+    } else if (t->token.type == TOKEN_TYPE_NUMBER) {
+        *v = t->token.value.number;
+        return true;
+    } else if (t->token.type == TOKEN_TYPE_PI) {
+        *v = PI;
+        return true;
+    }
+    return false;
+}
+
+// Vouw een operatie met alleen getallen en pi als kinderen tot een
+// getal, de kinderen gaan terug naar de arena. Geeft true wanneer de
+// node gevouwen is.
+static bool parser_fold(tree_arena_handle_t const* const thandle,
+                        tree_t* node, parser_fold_t* fold) {
+    parser_fold_op_t op = parser_fold_op[node->token.type];
+    double l, r = 0.0f;
+
+    if (fold == NULL || op == NULL ||
+        tree_arena_get_err(thandle) != TREE_ARENA_ERR_NONE ||
+        !parser_fold_value(node->left, &l) ||
+        (token_is_operation_binairy(&node->token) &&
+         !parser_fold_value(node->right, &r))) {
+        return false;
+    }
+
+    // Een deling door 0 blijft staan, zodat simp de fout meldt.
+    if (node->token.type == TOKEN_TYPE_DIVIDE && r == 0) {
+        return false;
+    }
+
+    token_make_number(&node->token, op(l, r));
+    fold->freed += 1 + (node->right != NULL);
+    fold->folds++;
+    node->left = tree_arena_remove_node(thandle, node->left);
+    node->right = tree_arena_remove_node(thandle, node->right);
+    return true;
+}
+
+// Lees een enkele token in de node.
+static parser_rt_e parser_token_node(
     tree_arena_handle_t const* const thandle, parser_buf_t* buf,
-    tree_t* node, int* leaf_balance) {
+    tree_t* node) {
     if (tree_arena_get_err(thandle) != TREE_ARENA_ERR_NONE) {
         return PARSER_RT_ERR;
     }
 
-    while (ascii_char_is_whitespace[(int)*(buf->p)]) {
-        buf->p++;
-    };
+    parser_skip_whitespace(buf);
 
     if (*(buf->p) == '\0') {
         return PARSER_RT_END;
@@ -155,10 +525,141 @@ parser_rt_e _parser_tokenize_string(
         return PARSER_RT_INVALID_CHAR;
     }
 
+    return PARSER_RT_OK;
+}
+
+// Frame van de parser met een expliciete stack.
+typedef struct {
+    tree_t* node;    // de node die gelezen wordt.
+    tree_t* parent;  // ouder van node, NULL voor de eerste node.
+    bool right;      // is node het rechtse kind van parent?
+    bool next;       // moet het rechtse kind van node nog gelezen?
+    bool fold;       // moet node na de kinderen nog gevouwen worden?
+} parser_frame_t;
+
+// Versie van _parser_tokenize_string() met een expliciete stack. De
+// nodes worden in dezelfde volgorde gelezen en een kind dat niet
+// gelezen kan worden wordt net zo verwijderd. Een operatie wordt na
+// zijn kinderen gevouwen via een apart frame.
+static parser_rt_e parser_tokenize_iter(
+    tree_arena_handle_t const* const thandle, parser_buf_t* buf,
+    tree_t* node, int* leaf_balance, parser_fold_t* fold) {
+    tree_stack_t s = {.w = sizeof(parser_frame_t)};
+    parser_frame_t* f = tree_stack_push(&s);
+    parser_rt_e rt = PARSER_RT_OK;  // resultaat van de eerste node.
+
+    if (f != NULL) {
+        f->node = node;
+    }
+
+    while (f != NULL && s.n > 0) {
+        parser_frame_t c = *(parser_frame_t*)tree_stack_top(&s);
+        tree_stack_pop(&s);
+
+        if (c.fold) {
+            // De eerste node wordt door de recursieve ouder als
+            // operatie geteld, zie _parser_tokenize_string().
+            if (parser_fold(thandle, c.node, fold) &&
+                c.parent == NULL) {
+                (*leaf_balance)--;
+            }
+            continue;
+        } else if (c.next) {
+            c.node->right = tree_arena_new_node(thandle);
+            f = tree_stack_push(&s);
+            if (f != NULL) {
+                *f = (parser_frame_t){
+                    .node = c.node->right,
+                    .parent = c.node,
+                    .right = true,
+                };
+            }
+            continue;
+        }
+
+        parser_rt_e r = parser_token_node(thandle, buf, c.node);
+        if (r == PARSER_RT_INVALID_CHAR || c.parent == NULL) {
+            rt = r;
+        }
+        if (r == PARSER_RT_INVALID_CHAR ||
+            (r != PARSER_RT_OK && c.parent == NULL)) {
+            break;
+        } else if (r != PARSER_RT_OK) {
+            tree_t** k = c.right ? &c.parent->right : &c.parent->left;
+            *k = tree_arena_remove_node(thandle, *k);
+            continue;
+        }
+
+        token_cat_e cat = token_get_cat(&c.node->token);
+        *leaf_balance += parser_cat_leaf_balance_value[cat];
+        if (c.parent != NULL && token_is_operation(&c.node->token)) {
+            (*leaf_balance)--;
+        }
+        if (fold != NULL) {
+            fold->tokens++;
+        }
+
+        if (fold != NULL && token_is_operation(&c.node->token)) {
+            f = tree_stack_push(&s);
+            if (f == NULL) {
+                break;
+            }
+            *f = (parser_frame_t){
+                .node = c.node,
+                .parent = c.parent,
+                .fold = true,
+            };
+        }
+
+        if (token_is_operation_binairy(&c.node->token)) {
+            f = tree_stack_push(&s);
+            if (f == NULL) {
+                break;
+            }
+            *f = (parser_frame_t){.node = c.node, .next = true};
+        }
+
+        if (token_is_operation(&c.node->token)) {
+            c.node->left = tree_arena_new_node(thandle);
+            f = tree_stack_push(&s);
+            if (f != NULL) {
+                *f = (parser_frame_t){
+                    .node = c.node->left,
+                    .parent = c.node,
+                };
+            }
+        }
+    }
+
+    if (f == NULL) {
+        tree_arena_set_err(thandle, TREE_ARENA_ERR_OVERFILLED);
+        rt = PARSER_RT_ERR;
+    }
+
+    tree_stack_free(&s);
+    return rt;
+}
+
+parser_rt_e _parser_tokenize_string(
+    tree_arena_handle_t const* const thandle, parser_buf_t* buf,
+    tree_t* node, int* leaf_balance, int depth, parser_fold_t* fold) {
+    if (depth > TREE_DEPTH_MAX) {
+        return parser_tokenize_iter(thandle, buf, node, leaf_balance,
+                                    fold);
+    }
+
+    parser_rt_e rt = parser_token_node(thandle, buf, node);
+    if (rt != PARSER_RT_OK) {
+        return rt;
+    }
+    if (fold != NULL) {
+        fold->tokens++;
+    }
+
     if (token_is_operation(&node->token)) {
         node->left = tree_arena_new_node(thandle);
         parser_rt_e rt = _parser_tokenize_string(
-            thandle, buf, node->left, leaf_balance);
+            thandle, buf, node->left, leaf_balance, depth + 1, fold);
         if (rt != PARSER_RT_OK) {
             node->left = tree_arena_remove_node(thandle, node->left);
         }
@@ -173,7 +674,7 @@ parser_rt_e _parser_tokenize_string(
     if (token_is_operation_binairy(&node->token)) {
         node->right = tree_arena_new_node(thandle);
         parser_rt_e rt = _parser_tokenize_string(
-            thandle, buf, node->right, leaf_balance);
+            thandle, buf, node->right, leaf_balance, depth + 1, fold);
         if (rt != PARSER_RT_OK) {
             node->right =
                 tree_arena_remove_node(thandle, node->right);
@@ -189,19 +690,25 @@ parser_rt_e _parser_tokenize_string(
     *leaf_balance +=
         parser_cat_leaf_balance_value[token_get_cat(&node->token)];
 
+    // De ouder telt een kind dat een operatie was, een gevouwen kind
+    // is nu een getal en wordt daarom hier geteld.
+    if (parser_fold(thandle, node, fold) && depth > 0) {
+        (*leaf_balance)--;
+    }
+
     return PARSER_RT_OK;
 }
 
 parser_rt_e parser_tokenize_string(
     tree_arena_handle_t const* const thandle, parser_buf_t* buf,
-    tree_t* node) {
+    tree_t* node, parser_fold_t* fold) {
     if (node == NULL) {
         return PARSER_RT_ERR;
     }
 
     int leaf_balance = 0;
-    parser_rt_e rt =
-        _parser_tokenize_string(thandle, buf, node, &leaf_balance);
+    parser_rt_e rt = _parser_tokenize_string(thandle, buf, node,
+                                             &leaf_balance, 0, fold);
     if (rt == PARSER_RT_OK && leaf_balance != 0) {
         return PARSER_RT_INVALID_EXPR;
     }
@@ -8,15 +8,36 @@
 #ifndef __PARSER_H
 #define __PARSER_H
 
+#include <stdbool.h>
+#include <stdio.h>
+
 #include "tree.h"
 
-#define PARSER_STRING_BUFFER_SIZE 1024
+// Grootte van een blok van de invoer in de buffer.
+#define PARSER_STRING_BUFFER_SIZE (1 << 16)
+// Minimum aantal karakters dat aan het begin van een token in de
+// buffer staat, zodat een token niet over de grens van een blok valt.
+// Alleen de cijfers van een getal mogen daar overheen lopen.
+#define PARSER_TOKEN_MAX 256
 
-typedef struct {
+typedef struct parser_buf_s parser_buf_t;
+
+// Vul d aan met maximaal size - 1 karakters van de bron, geeft het
+// aantal gelezen karakters. Aan het einde van de bron wordt
+// buf->refill op NULL gezet.
+typedef size_t (*parser_refill_t)(parser_buf_t* buf, char* d,
+                                  size_t size);
+
+struct parser_buf_s {
     char* p;  // huidige pointer naar de te consumeren karakter in een
               // de buffer.
+    char* l;  // begin van de huidige regel, in d of in een mapping.
+    char* e;  // einde van de karakters, *e is altijd '\0'.
+    parser_refill_t refill;  // leest het volgende blok, of NULL
+                             // wanneer de regel compleet is.
+    void* ctx;                          // de bron van refill.
     char d[PARSER_STRING_BUFFER_SIZE];  // de buffer.
-} parser_buf_t;
+};
 
 typedef enum {
     PARSER_RT_OK = 0,
@@ -26,12 +47,49 @@ typedef enum {
     PARSER_RT_INVALID_CHAR,  // invalide karakter is gelezen.
 } parser_rt_e;
 
-// Leest een double uit de buffer vanaf buf->p.
+// Schuif de karakters vanaf buf->p naar het begin van de buffer en
+// lees het volgende blok van de bron. Pointers naar de buffer, buiten
+// p, l en e, zijn daarna ongeldig.
+void parser_refill(parser_buf_t* buf);
+
+// Zorg dat er minstens n karakters vanaf buf->p in de buffer staan,
+// tenzij de bron eerder ophoudt.
+static inline void parser_fill(parser_buf_t* buf, size_t n) {
+    while (buf->refill != NULL && (size_t)(buf->e - buf->p) < n) {
+        parser_refill(buf);
+    }
+}
+
+// Begin een nieuwe regel uit f. De regel wordt in blokken gelezen,
+// zodat een regel langer mag zijn dan de buffer. Geeft false aan het
+// einde van f.
+bool parser_read_line(parser_buf_t* buf, FILE* f);
+
+// Sla de rest van de huidige regel over.
+void parser_skip_line(parser_buf_t* buf);
+
+// Sla witruimte over, ook wanneer deze over een blok heen loopt.
+void parser_skip_whitespace(parser_buf_t* buf);
+
+// Leest een correct afgeronde double uit de buffer vanaf buf->p, met
+// een optionele exponent zoals in 1.5e-7.
 parser_rt_e parser_read_double(parser_buf_t* buf, double* n);
 
-// Maakt een boom met tokens van de string in de buffer.
+// Vouwen van constanten tijdens het parsen. Een operatie met alleen
+// getallen en pi als kinderen wordt direct een getal, de kinderen
+// gaan terug naar de arena en worden voor de volgende tokens
+// hergebruikt. Een deling door 0 blijft staan.
+typedef struct {
+    size_t tokens;  // aantal gelezen tokens, de nodes zonder vouwen.
+    size_t folds;   // aantal gevouwen operaties.
+    size_t freed;   // aantal nodes dat teruggegeven is.
+} parser_fold_t;
+
+// Maakt een boom met tokens van de string in de buffer. Wanneer fold
+// niet NULL is worden constanten gevouwen en komen de statistieken in
+// fold.
 parser_rt_e parser_tokenize_string(
     tree_arena_handle_t const* const thandle, parser_buf_t* buf,
-    tree_t* node);
+    tree_t* node, parser_fold_t* fold);
 
 #endif  // __PARSER_H
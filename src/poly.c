@@ -0,0 +1,1170 @@
+/* Implementatie van de normaalvorm voor polynomen in x.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "poly.h"
+
+#include <complex.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI acos(0.0f) * 2.0f
+
+// Tot dit aantal termen wordt een exponent lineair gezocht, daarboven
+// via de hash map.
+#define POLY_LINEAR_MAX 8
+// Grootste gehele exponent van een macht die uitgerekend wordt, tot
+// hier is iedere double met een gehele waarde exact.
+#define POLY_POWER_MAX 0x1p53
+// Grootste aantal coefficienten van een uitgewerkt product, zodat
+// expand niet al het geheugen opmaakt.
+#define POLY_EXPAND_MAX (1 << 22)
+// Een product wordt dense uitgerekend wanneer gemiddeld minstens een
+// op de POLY_DENSE_RATIO coefficienten een term is.
+#define POLY_DENSE_RATIO 4
+// Onder deze lengte wordt schoolbook gebruikt, daarboven Karatsuba.
+#define POLY_KARATSUBA_MIN 64
+// Vanaf deze lengte van de kortste factor wordt de FFT gebruikt.
+#define POLY_FFT_MIN 512
+
+void poly_free(poly_t *p) {
+    free(p->d);
+    free(p->m);
+    *p = (poly_t){.k = 1.0f};
+}
+
+static inline size_t poly_hash(int64_t e, size_t msize) {
+    return ((uint64_t)e * 0x9E3779B97F4A7C15ULL) >> 32 & (msize - 1);
+}
+
+// Bouw de hash map opnieuw op met ruimte voor minstens 2n termen.
+static bool poly_rehash(poly_t *p, size_t n) {
+    size_t msize = p->msize ? p->msize : 16;
+    while (msize < 2 * n) {
+        msize *= 2;
+    }
+
+    size_t *m = calloc(msize, sizeof(size_t));
+    if (m == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < p->n; i++) {
+        size_t j = poly_hash(p->d[i].e, msize);
+        while (m[j] != 0) {
+            j = (j + 1) & (msize - 1);
+        }
+        m[j] = i + 1;
+    }
+
+    free(p->m);
+    p->m = m;
+    p->msize = msize;
+    return true;
+}
+
+// Tel c * x^e op bij de polynoom, e en c zijn al gecorrigeerd voor
+// de verschuiving en factor van p.
+static bool poly_add_term(poly_t *p, int64_t e, double c) {
+    size_t *slot = NULL;  // leeg slot in de hash map voor e.
+
+    if (p->m == NULL) {
+        for (size_t i = 0; i < p->n; i++) {
+            if (p->d[i].e == e) {
+                p->d[i].c += c;
+                return true;
+            }
+        }
+    } else {
+        size_t j = poly_hash(e, p->msize);
+        for (; p->m[j] != 0; j = (j + 1) & (p->msize - 1)) {
+            if (p->d[p->m[j] - 1].e == e) {
+                p->d[p->m[j] - 1].c += c;
+                return true;
+            }
+        }
+        slot = &p->m[j];
+    }
+
+    if (p->n >= p->size) {
+        size_t size = p->size ? p->size * 2 : 4;
+        poly_term_t *d = realloc(p->d, size * sizeof(poly_term_t));
+        if (d == NULL) {
+            return false;
+        }
+        p->d = d;
+        p->size = size;
+    }
+
+    p->d[p->n++] = (poly_term_t){.e = e, .c = c};
+    if (slot != NULL && 2 * p->n <= p->msize) {
+        *slot = p->n;
+        return true;
+    } else if (slot != NULL || p->n > POLY_LINEAR_MAX) {
+        return poly_rehash(p, p->n);
+    }
+    return true;
+}
+
+// Geeft de polynoom c * x^e.
+static poly_t *poly_monomial(int64_t e, double c) {
+    poly_t *p = malloc(sizeof(poly_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    *p = (poly_t){.k = 1.0f};
+    if (!poly_add_term(p, e, c)) {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+static void poly_delete(poly_t *p) {
+    if (p != NULL) {
+        poly_free(p);
+        free(p);
+    }
+}
+
+static void poly_scale(poly_t *p, double c) {
+    if (c == 0) {
+        p->n = 0;
+        free(p->m);
+        p->m = NULL;
+        p->msize = 0;
+        p->k = 1.0f;
+    } else if (isnormal(p->k * c)) {
+        p->k *= c;
+    } else {
+        // De factor zou 0 of oneindig worden, de coefficienten zelf
+        // kunnen dat misschien wel aan.
+        for (size_t i = 0; i < p->n; i++) {
+            p->d[i].c = p->d[i].c * p->k * c;
+        }
+        p->k = 1.0f;
+    }
+}
+
+// Geeft a + sign * b. De kleinste van de twee wordt in de grootste
+// opgeteld, de andere wordt vrijgegeven. Zo kost een lange som niet
+// meer dan O(n log n) termen.
+static poly_t *poly_add(poly_t *a, poly_t *b, double sign) {
+    if (a->n < b->n) {
+        poly_t *t = a;
+        a = b;
+        b = t;
+        poly_scale(a, sign);
+        sign = 1.0f;
+    }
+
+    for (size_t i = 0; i < b->n; i++) {
+        double c = sign * b->k * b->d[i].c / a->k;
+        if (!poly_add_term(a, b->d[i].e + b->s - a->s, c)) {
+            poly_delete(a);
+            a = NULL;
+            break;
+        }
+    }
+
+    poly_delete(b);
+    return a;
+}
+
+// Is de polynoom een enkele term? e en c worden dan de term, de nul
+// polynoom geeft 0 * x^0.
+static bool poly_is_monomial(poly_t const *p, int64_t *e, double *c) {
+    *e = 0;
+    *c = 0.0f;
+    if (p->n > 1) {
+        return false;
+    } else if (p->n == 1) {
+        *e = p->d[0].e + p->s;
+        *c = p->d[0].c * p->k;
+    }
+    return true;
+}
+
+// Geeft de kleinste en grootste exponent van de termen, zonder de
+// verschuiving. De polynoom moet minstens een term hebben.
+static void poly_span(poly_t const *p, int64_t *lo, int64_t *hi) {
+    *lo = *hi = p->d[0].e;
+    for (size_t i = 1; i < p->n; i++) {
+        *lo = (p->d[i].e < *lo) ? p->d[i].e : *lo;
+        *hi = (p->d[i].e > *hi) ? p->d[i].e : *hi;
+    }
+}
+
+// Geeft de polynoom met de coefficienten c van x^e0 tot x^(e0+n-1),
+// coefficienten die 0 zijn worden weggelaten.
+static poly_t *poly_from_dense(double const *c, size_t n,
+                               int64_t e0) {
+    poly_t *p = malloc(sizeof(poly_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    *p = (poly_t){.k = 1.0f};
+    size_t m = 0;  // aantal termen.
+    for (size_t i = 0; i < n; i++) {
+        m += (c[i] != 0);
+    }
+    if (m == 0) {
+        return p;
+    }
+
+    p->d = malloc(m * sizeof(poly_term_t));
+    if (p->d == NULL) {
+        free(p);
+        return NULL;
+    }
+    p->size = m;
+    for (size_t i = 0; i < n; i++) {
+        if (c[i] != 0) {
+            p->d[p->n++] =
+                (poly_term_t){.e = e0 + (int64_t)i, .c = c[i]};
+        }
+    }
+
+    if (m > POLY_LINEAR_MAX && !poly_rehash(p, m)) {
+        poly_delete(p);
+        return NULL;
+    }
+    return p;
+}
+
+// c = a * b, c heeft la + lb - 1 plaatsen.
+static void poly_schoolbook(double const *a, size_t la,
+                            double const *b, size_t lb, double *c) {
+    memset(c, 0, (la + lb - 1) * sizeof(double));
+    for (size_t i = 0; i < la; i++) {
+        double ai = a[i];
+        for (size_t j = 0; j < lb; j++) {
+            c[i + j] += ai * b[j];
+        }
+    }
+}
+
+// Coefficient k van a * b, in dezelfde volgorde opgeteld als
+// poly_schoolbook().
+static double poly_schoolbook_at(double const *a, size_t la,
+                                 double const *b, size_t lb,
+                                 size_t k) {
+    size_t i = (k >= lb) ? k - lb + 1 : 0;
+    size_t e = (k < la) ? k : la - 1;
+    double c = 0.0f;
+    for (; i <= e; i++) {
+        c += a[i] * b[k - i];
+    }
+    return c;
+}
+
+// Foutgrens van poly_karatsuba() met lengte n, voor factoren met
+// coefficienten van hooguit 1. De factoren van z1 zijn hooguit 2, de
+// fout daarvan telt dus vier keer. Met poly_karatsuba_chunks() telt
+// de grens twee keer.
+static double poly_karatsuba_err(size_t n) {
+    if (n < POLY_KARATSUBA_MIN) {
+        return 2.0f * n * n * DBL_EPSILON;
+    }
+    size_t m = n - n / 2;
+    return poly_karatsuba_err(n / 2) + 5.0f * poly_karatsuba_err(m) +
+           32.0f * n * DBL_EPSILON;
+}
+
+// Benodigde ruimte voor de tussenresultaten van Karatsuba met
+// lengte n.
+static size_t poly_karatsuba_scratch(size_t n) {
+    size_t s = 0;
+    while (n >= POLY_KARATSUBA_MIN) {
+        n -= n / 2;
+        s += 4 * n;
+    }
+    return s;
+}
+
+// c = a * b met Karatsuba, a en b hebben beide lengte n en c heeft
+// 2n - 1 plaatsen. Met a = a0 + a1 x^h en b = b0 + b1 x^h is
+// a * b = z0 + (z1 - z0 - z2) x^h + z2 x^2h, met z0 = a0 * b0,
+// z2 = a1 * b1 en z1 = (a0 + a1) * (b0 + b1). w is de ruimte voor de
+// tussenresultaten.
+static void poly_karatsuba(double const *a, double const *b, size_t n,
+                           double *c, double *w) {
+    if (n < POLY_KARATSUBA_MIN) {
+        poly_schoolbook(a, n, b, n, c);
+        return;
+    }
+
+    size_t h = n / 2;  // lengte van a0, a1 heeft lengte m >= h.
+    size_t m = n - h;
+    double *sa = w;
+    double *sb = w + m;
+    double *z = w + 2 * m;  // z1, met 2m - 1 plaatsen.
+    double *wn = z + 2 * m - 1;
+
+    for (size_t i = 0; i < m; i++) {
+        sa[i] = a[h + i] + ((i < h) ? a[i] : 0.0f);
+        sb[i] = b[h + i] + ((i < h) ? b[i] : 0.0f);
+    }
+
+    poly_karatsuba(a, b, h, c, wn);
+    c[2 * h - 1] = 0.0f;
+    poly_karatsuba(a + h, b + h, m, c + 2 * h, wn);
+    poly_karatsuba(sa, sb, m, z, wn);
+
+    for (size_t i = 0; i < 2 * h - 1; i++) {
+        z[i] -= c[i];
+    }
+    for (size_t i = 0; i < 2 * m - 1; i++) {
+        z[i] -= c[2 * h + i];
+    }
+    for (size_t i = 0; i < 2 * m - 1; i++) {
+        c[h + i] += z[i];
+    }
+}
+
+// c = a * b met Karatsuba, met la >= lb. De langste factor wordt in
+// stukken met de lengte van de kortste opgedeeld, iedere coefficient
+// krijgt zo bijdragen van hooguit twee stukken.
+static bool poly_karatsuba_chunks(double const *a, size_t la,
+                                  double const *b, size_t lb,
+                                  double *c) {
+    size_t n = la + lb - 1;
+    double *t = malloc((3 * lb + poly_karatsuba_scratch(lb)) *
+                       sizeof(double));
+    if (t == NULL) {
+        return false;
+    }
+    double *pa = t + 2 * lb;  // een aangevuld laatste stuk van a.
+    double *w = pa + lb;
+
+    memset(c, 0, n * sizeof(double));
+    for (size_t o = 0; o < la; o += lb) {
+        double const *ap = a + o;
+        if (la - o < lb) {
+            memcpy(pa, ap, (la - o) * sizeof(double));
+            memset(pa + la - o, 0, (lb - la + o) * sizeof(double));
+            ap = pa;
+        }
+
+        poly_karatsuba(ap, b, lb, t, w);
+        for (size_t i = 0; i < 2 * lb - 1 && o + i < n; i++) {
+            c[o + i] += t[i];
+        }
+    }
+
+    free(t);
+    return true;
+}
+
+// Complexe vermenigvuldiging zonder de controle op oneindig en NaN
+// die GCC voor de operator * aanroept.
+static inline double complex poly_cmul(double complex a,
+                                       double complex b) {
+    return CMPLX(creal(a) * creal(b) - cimag(a) * cimag(b),
+                 creal(a) * cimag(b) + cimag(a) * creal(b));
+}
+
+// Iteratieve FFT van d met lengte n, een macht van 2. De twiddles van
+// de laag met lengte len staan vanaf w[len / 2], zodat iedere laag
+// ze achter elkaar leest. De inverse wordt niet door n gedeeld.
+static void poly_fft(double complex *d, size_t n,
+                     double complex const *w, bool inverse) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            double complex t = d[i];
+            d[i] = d[j];
+            d[j] = t;
+        }
+    }
+
+    for (size_t h = 1; h < n; h <<= 1) {
+        double complex const *wl = w + h;
+        for (size_t i = 0; i < n; i += 2 * h) {
+            for (size_t j = 0; j < h; j++) {
+                double complex t = inverse ? conj(wl[j]) : wl[j];
+                double complex u = d[i + j];
+                double complex v = poly_cmul(d[i + j + h], t);
+                d[i + j] = u + v;
+                d[i + j + h] = u - v;
+            }
+        }
+    }
+}
+
+// c = a * b via de FFT. a en b worden als reeel en imaginair deel in
+// een complexe rij gestopt, zodat een heen en een terug transformatie
+// genoeg zijn. Geeft de fout van de coefficienten via err.
+static bool poly_fft_mul(double const *a, size_t la, double const *b,
+                         size_t lb, double *c, double *err) {
+    size_t n = la + lb - 1;
+    size_t N = 2;
+    while (N < n) {
+        N <<= 1;
+    }
+
+    double complex *d = malloc(2 * N * sizeof(double complex));
+    if (d == NULL) {
+        return false;
+    }
+    double complex *w = d + N;
+
+    // De twiddles van de bovenste laag worden uitgerekend, die van de
+    // lagere lagen zijn daar een deel van.
+    for (size_t j = 0; j < N / 2; j++) {
+        double t = -2.0f * PI * (double)j / (double)N;
+        w[N / 2 + j] = CMPLX(cos(t), sin(t));
+    }
+    for (size_t h = N / 4; h > 0; h >>= 1) {
+        for (size_t j = 0; j < h; j++) {
+            w[h + j] = w[2 * h + 2 * j];
+        }
+    }
+
+    double na = 0.0f, nb = 0.0f;  // de 2-normen van a en b.
+    for (size_t i = 0; i < N; i++) {
+        double x = (i < la) ? a[i] : 0.0f;
+        double y = (i < lb) ? b[i] : 0.0f;
+        d[i] = CMPLX(x, y);
+        na += x * x;
+        nb += y * y;
+    }
+
+    // Met d = A + iB is A[k] = (d[k] + conj(d[-k])) / 2 en
+    // B[k] = (d[k] - conj(d[-k])) / 2i, dus
+    // A[k] * B[k] = (d[k]^2 - conj(d[-k])^2) / 4i.
+    poly_fft(d, N, w, false);
+    for (size_t k = 0; k <= N / 2; k++) {
+        size_t j = (N - k) & (N - 1);
+        double complex x = d[k], y = d[j];
+        double complex p =
+            poly_cmul(x, x) - poly_cmul(conj(y), conj(y));
+        double complex q =
+            poly_cmul(y, y) - poly_cmul(conj(x), conj(x));
+        d[k] = CMPLX(cimag(p), -creal(p)) * 0.25f;
+        d[j] = CMPLX(cimag(q), -creal(q)) * 0.25f;
+    }
+    poly_fft(d, N, w, true);
+
+    for (size_t i = 0; i < n; i++) {
+        c[i] = creal(d[i]) / (double)N;
+    }
+
+    *err = 8.0f * DBL_EPSILON * log2((double)N) * sqrt(na * nb);
+    free(d);
+    return true;
+}
+
+// Vul c met de coefficienten van p vanaf exponent lo, inclusief de
+// factor. Geeft de grootste absolute waarde.
+static double poly_to_dense(poly_t const *p, int64_t lo, double *c,
+                            bool *ints) {
+    double max = 0.0f;
+    for (size_t i = 0; i < p->n; i++) {
+        double v = p->d[i].c * p->k;
+        c[p->d[i].e - lo] = v;
+        max = fmax(max, fabs(v));
+        *ints &= (v == rint(v));
+    }
+    return max;
+}
+
+// Geeft a * b in een dense representatie. Voor Karatsuba en de FFT
+// worden de factoren met een macht van 2 geschaald zodat de grootste
+// coefficient rond 1 ligt, dan kunnen de tussenresultaten niet
+// overlopen. De fout van beide is begrensd ten opzichte van de
+// grootste coefficient, een kleine coefficient kan dus helemaal
+// verkeerd zijn. Bij gehele factoren wordt het resultaat afgerond
+// wanneer de fout dat toelaat. Anders wordt na de FFT iedere
+// coefficient waarvan de foutgrens boven die van schoolbook uitkomt
+// opnieuw met schoolbook uitgerekend, uit de ongeschaalde factoren.
+// De grens van Karatsuba is daarvoor te ruim, Karatsuba wordt dus
+// alleen gebruikt wanneer afronden kan.
+static poly_t *poly_mul_dense(poly_t const *a, poly_t const *b) {
+    int64_t loa, hia, lob, hib;
+    poly_span(a, &loa, &hia);
+    poly_span(b, &lob, &hib);
+    size_t la = hia - loa + 1, lb = hib - lob + 1, n = la + lb - 1;
+
+    double *d = calloc(2 * (la + lb + n), sizeof(double));
+    if (d == NULL) {
+        return NULL;
+    }
+    double *da = d, *db = d + la, *c = d + la + lb;
+    double *sa = c + n, *sb, *s;  // de geschaalde factoren.
+    bool ints = true;  // zijn alle coefficienten geheel?
+    double ma = poly_to_dense(a, loa, da, &ints);
+    double mb = poly_to_dense(b, lob, db, &ints);
+
+    if (la < lb) {
+        double *t = da;
+        da = db;
+        db = t;
+        size_t l = la;
+        la = lb;
+        lb = l;
+        double m = ma;
+        ma = mb;
+        mb = m;
+    }
+    sb = sa + la;
+    s = sb + lb;  // de sommen van |a_i * b_j| van de coefficienten.
+
+    // Oneindig en NaN worden alleen door schoolbook goed doorgegeven.
+    int ea = 0, eb = 0;
+    bool fast = isfinite(ma) && isfinite(mb) && ma != 0 && mb != 0 &&
+                lb >= POLY_KARATSUBA_MIN;
+    if (fast) {
+        frexp(ma, &ea);
+        frexp(mb, &eb);
+    }
+    if (fast && lb < POLY_FFT_MIN) {
+        fast = ints &&
+               ldexp(2.0f * poly_karatsuba_err(lb), ea + eb) < 0.25f;
+    }
+
+    bool ok = true;
+    if (!fast) {
+        poly_schoolbook(da, la, db, lb, c);
+    } else {
+        for (size_t i = 0; i < la; i++) {
+            sa[i] = ldexp(da[i], -ea);
+        }
+        for (size_t i = 0; i < lb; i++) {
+            sb[i] = ldexp(db[i], -eb);
+        }
+
+        double err = 0.0f;  // de fout van de FFT.
+        if (lb < POLY_FFT_MIN) {
+            ok = poly_karatsuba_chunks(sa, la, sb, lb, c);
+        } else {
+            ok = poly_fft_mul(sa, la, sb, lb, c, &err);
+            ints &= (ldexp(err, ea + eb) < 0.25f);
+            // sb ligt direct achter sa.
+            for (size_t i = 0; ok && !ints && i < la + lb; i++) {
+                sa[i] = fabs(sa[i]);
+            }
+            if (ok && !ints) {
+                ok = poly_fft_mul(sa, la, sb, lb, s, &err);
+            }
+        }
+
+        // De foutgrens van schoolbook is lb * eps * som |a_i * b_j|,
+        // de som zelf heeft na de FFT dezelfde fout err.
+        for (size_t i = 0; ok && i < n; i++) {
+            if (ints) {
+                c[i] = rint(ldexp(c[i], ea + eb));
+            } else if ((s[i] - err) * lb * DBL_EPSILON < err) {
+                c[i] = poly_schoolbook_at(da, la, db, lb, i);
+            } else {
+                c[i] = ldexp(c[i], ea + eb);
+            }
+        }
+    }
+
+    poly_t *p = ok ? poly_from_dense(c, n, loa + lob + a->s + b->s)
+                   : NULL;
+    free(d);
+    return p;
+}
+
+// Geeft a * b door alle paren van termen te vermenigvuldigen, voor
+// polynomen met weinig termen verspreid over grote exponenten.
+static poly_t *poly_mul_sparse(poly_t const *a, poly_t const *b) {
+    poly_t *p = poly_monomial(0, 0.0f);
+    if (p == NULL) {
+        return NULL;
+    }
+
+    p->n = 0;
+    p->s = a->s + b->s;
+    for (size_t i = 0; i < a->n; i++) {
+        double c = a->d[i].c * a->k;
+        for (size_t j = 0; j < b->n; j++) {
+            if (!poly_add_term(p, a->d[i].e + b->d[j].e,
+                               c * b->d[j].c * b->k)) {
+                poly_delete(p);
+                return NULL;
+            }
+        }
+    }
+    return p;
+}
+
+// Geeft a * b, de factoren blijven bestaan.
+static poly_t *poly_mul_poly(poly_t const *a, poly_t const *b) {
+    int64_t loa, hia, lob, hib;
+    if (a->n == 0 || b->n == 0) {
+        return poly_monomial(0, 0.0f);
+    }
+    poly_span(a, &loa, &hia);
+    poly_span(b, &lob, &hib);
+
+    uint64_t l = (uint64_t)(hia - loa) + (uint64_t)(hib - lob) + 2;
+    if (l <= POLY_DENSE_RATIO * (a->n + b->n)) {
+        return poly_mul_dense(a, b);
+    }
+    return poly_mul_sparse(a, b);
+}
+
+// Past het uitgewerkte product van a en b binnen POLY_EXPAND_MAX?
+static bool poly_mul_fits(poly_t const *a, poly_t const *b) {
+    int64_t loa, hia, lob, hib;
+    poly_span(a, &loa, &hia);
+    poly_span(b, &lob, &hib);
+
+    uint64_t n;
+    uint64_t l = (uint64_t)(hia - loa) + (uint64_t)(hib - lob) + 1;
+    return (!__builtin_mul_overflow(a->n, b->n, &n) &&
+            n <= POLY_EXPAND_MAX) ||
+           l <= POLY_EXPAND_MAX;
+}
+
+// Past a^k uitgewerkt binnen POLY_EXPAND_MAX?
+static bool poly_pow_fits(poly_t const *a, int64_t k) {
+    int64_t lo, hi;
+    poly_span(a, &lo, &hi);
+
+    uint64_t l;
+    if (!__builtin_mul_overflow((uint64_t)(hi - lo), (uint64_t)k,
+                                &l) &&
+        l < POLY_EXPAND_MAX) {
+        return true;
+    }
+
+    // Er zijn niet meer termen dan n^k.
+    uint64_t n = 1;
+    for (int64_t i = 0; i < k && n <= POLY_EXPAND_MAX; i++) {
+        n *= a->n;
+    }
+    return n <= POLY_EXPAND_MAX;
+}
+
+// Geeft a * b, een product van twee sommen wordt uitgewerkt.
+static poly_t *poly_mul(poly_t *a, poly_t *b) {
+    int64_t e;
+    double c;
+
+    if (!poly_is_monomial(b, &e, &c)) {
+        poly_t *t = a;
+        a = b;
+        b = t;
+        if (!poly_is_monomial(b, &e, &c)) {
+            poly_t *p = poly_mul_poly(a, b);
+            poly_delete(a);
+            poly_delete(b);
+            return p;
+        }
+    }
+
+    poly_delete(b);
+    poly_scale(a, c);
+    a->s += e;
+    return a;
+}
+
+// Geeft a / b, b moet een enkele term anders dan 0 zijn.
+static poly_t *poly_div(poly_t *a, poly_t *b) {
+    int64_t e;
+    double c;
+
+    poly_is_monomial(b, &e, &c);
+    poly_delete(b);
+    poly_scale(a, 1.0f / c);
+    a->s -= e;
+    return a;
+}
+
+// Geeft a^b met b een geheel getal. Een som wordt met herhaald
+// kwadrateren uitgewerkt, b is dan niet negatief.
+static poly_t *poly_pow(poly_t *a, poly_t *b) {
+    int64_t e, eb;
+    double c, n;
+
+    poly_is_monomial(b, &eb, &n);
+    poly_delete(b);
+    if (poly_is_monomial(a, &e, &c)) {
+        poly_delete(a);
+        return poly_monomial(e * (int64_t)n, pow(c, n));
+    }
+
+    poly_t *r = poly_monomial(0, 1.0f);
+    for (uint64_t k = (uint64_t)n; r != NULL && k > 0; k >>= 1) {
+        poly_t *t;
+        if (k & 1) {
+            t = poly_mul_poly(r, a);
+            poly_delete(r);
+            r = t;
+        }
+        if (r != NULL && k > 1) {
+            t = poly_mul_poly(a, a);
+            poly_delete(a);
+            a = t;
+            if (a == NULL) {
+                poly_delete(r);
+                r = NULL;
+            }
+        }
+    }
+
+    poly_delete(a);
+    return r;
+}
+
+// Frame van de omzetting met een expliciete stack.
+typedef struct {
+    tree_t *t;
+    int s;         // aantal bezochte kinderen.
+    poly_t *p[2];  // de polynomen van de kinderen, of NULL.
+} poly_frame_t;
+
+// Een gedeelde node die al omgezet is.
+typedef struct {
+    poly_t *p;  // kopie van de polynoom, of NULL.
+    tree_t *t;  // de normaalvorm als boom, of NULL.
+} poly_memo_t;
+
+// Een kind dat na afloop vervangen wordt door zijn normaalvorm.
+typedef struct {
+    tree_t **slot;
+    tree_t *t;
+} poly_patch_t;
+
+typedef struct {
+    tree_arena_handle_t const *h;
+    tree_map_t refs;     // node naar het aantal ouders.
+    tree_map_t memo;     // gedeelde node naar de index in memos.
+    poly_memo_t *memos;  // de omgezette gedeelde nodes.
+    size_t mn;
+    size_t msize;
+    tree_t *x;  // de gedeelde node van x.
+    poly_patch_t *patches;
+    size_t n;
+    size_t size;
+    poly_stats_t *stats;
+    bool expand;  // worden producten van sommen uitgewerkt?
+} poly_ctx_t;
+
+// Tel het aantal ouders van iedere node.
+static bool poly_count_refs(tree_map_t *refs, tree_t *t) {
+    tree_stack_t s = {.w = sizeof(tree_t *)};
+    tree_t **f = tree_stack_push(&s);
+    void *v;
+
+    if (f != NULL) {
+        *f = t;
+    }
+
+    while (f != NULL && s.n > 0) {
+        tree_t *r = *(tree_t **)tree_stack_top(&s);
+        tree_stack_pop(&s);
+
+        for (int i = 0; f != NULL && i < 2; i++) {
+            tree_t *c = i ? r->right : r->left;
+            if (c == NULL) {
+                continue;
+            }
+
+            bool seen = tree_map_get(refs, c, &v);
+            size_t n = seen ? (size_t)(uintptr_t)v + 1 : 1;
+            if (!tree_map_put(refs, c, (void *)(uintptr_t)n)) {
+                f = NULL;
+            } else if (!seen) {
+                f = tree_stack_push(&s);
+                if (f != NULL) {
+                    *f = c;
+                }
+            }
+        }
+    }
+
+    tree_stack_free(&s);
+    return f != NULL;
+}
+
+static int poly_term_cmp(void const *a, void const *b) {
+    int64_t ea = ((poly_term_t const *)a)->e;
+    int64_t eb = ((poly_term_t const *)b)->e;
+    return (ea < eb) - (ea > eb);
+}
+
+static tree_t *poly_number(poly_ctx_t *ctx, double v) {
+    token_t t;
+    token_make_number(&t, v);
+    return tree_arena_intern(ctx->h, &t, NULL, NULL);
+}
+
+static tree_t *poly_op(poly_ctx_t *ctx, token_type_e type,
+                       tree_t *l, tree_t *r) {
+    token_t t;
+    token_make_type(&t, type);
+    return tree_arena_intern(ctx->h, &t, l, r);
+}
+
+// Maak de boom van |c| * x^e.
+static tree_t *poly_term_tree(poly_ctx_t *ctx, int64_t e, double c) {
+    if (e == 0) {
+        return poly_number(ctx, c);
+    }
+
+    tree_t *t = ctx->x;
+    if (e != 1) {
+        t = poly_op(ctx, TOKEN_TYPE_POWER, t,
+                    poly_number(ctx, (double)e));
+    }
+    if (c != 1) {
+        t = poly_op(ctx, TOKEN_TYPE_MULTIPLY, poly_number(ctx, c), t);
+    }
+    return t;
+}
+
+// Zet de polynoom om naar een som van termen, van de hoogste naar de
+// laagste macht. De termen worden van links af opgeteld, een
+// negatieve coefficient na de eerste term wordt een aftrekking. De
+// termen van p worden daarbij gesorteerd, waarna p alleen nog
+// vrijgegeven kan worden.
+static tree_t *poly_tree(poly_ctx_t *ctx, poly_t *p) {
+    size_t n = 0;  // aantal termen anders dan 0.
+    for (size_t i = 0; i < p->n; i++) {
+        p->d[i].e += p->s;
+        p->d[i].c *= p->k;
+        if (p->d[i].c != 0) {
+            p->d[n++] = p->d[i];
+        }
+    }
+    p->n = n;
+    p->s = 0;
+    p->k = 1.0f;
+    qsort(p->d, n, sizeof(poly_term_t), poly_term_cmp);
+    ctx->stats->terms += n;
+
+    if (n == 0) {
+        return poly_number(ctx, 0.0f);
+    }
+
+    tree_t *t = poly_term_tree(ctx, p->d[0].e, p->d[0].c);
+    for (size_t i = 1; i < n; i++) {
+        double c = p->d[i].c;
+        t = poly_op(ctx, (c < 0) ? TOKEN_TYPE_MINUS : TOKEN_TYPE_PLUS,
+                    t, poly_term_tree(ctx, p->d[i].e, fabs(c)));
+    }
+    return t;
+}
+
+static poly_t *poly_copy(poly_t const *p) {
+    poly_t *q = poly_monomial(0, 0.0f);
+    if (q == NULL) {
+        return NULL;
+    }
+
+    q->n = 0;
+    for (size_t i = 0; i < p->n; i++) {
+        if (!poly_add_term(q, p->d[i].e, p->d[i].c)) {
+            poly_delete(q);
+            return NULL;
+        }
+    }
+    q->k = p->k;
+    q->s = p->s;
+    return q;
+}
+
+// Vervang na afloop het kind in slot door t.
+static bool poly_patch(poly_ctx_t *ctx, tree_t **slot, tree_t *t) {
+    if (ctx->n >= ctx->size) {
+        size_t size = ctx->size ? ctx->size * 2 : 64;
+        poly_patch_t *d =
+            realloc(ctx->patches, size * sizeof(poly_patch_t));
+        if (d == NULL) {
+            return false;
+        }
+        ctx->patches = d;
+        ctx->size = size;
+    }
+
+    ctx->patches[ctx->n++] = (poly_patch_t){.slot = slot, .t = t};
+    return true;
+}
+
+// Is de node met de polynomen p van de kinderen zelf een polynoom?
+static bool poly_is_poly(poly_ctx_t *ctx, token_t const *k,
+                         poly_t **p) {
+    int64_t e[2] = {0};
+    double c[2] = {0};
+
+    if (p[0] == NULL || (token_is_operation_binairy(k) && !p[1])) {
+        return false;
+    }
+
+    bool m0 = poly_is_monomial(p[0], &e[0], &c[0]);
+    bool m1 = token_is_operation_binairy(k) &&
+              poly_is_monomial(p[1], &e[1], &c[1]);
+    bool ok;
+
+    switch (k->type) {
+        case TOKEN_TYPE_PLUS:
+        case TOKEN_TYPE_MINUS:
+            return true;
+        case TOKEN_TYPE_MULTIPLY:
+            // Een product van twee sommen wordt alleen door expand
+            // uitgewerkt.
+            if (m0 || m1) {
+                return true;
+            }
+            ok = ctx->expand && poly_mul_fits(p[0], p[1]);
+            ctx->stats->products += ok;
+            return ok;
+        case TOKEN_TYPE_DIVIDE:
+            return m1 && c[1] != 0;
+        case TOKEN_TYPE_POWER:
+            if (!m0) {
+                ok = ctx->expand && m1 && e[1] == 0 &&
+                          c[1] >= 0 && c[1] <= POLY_EXPAND_MAX &&
+                          c[1] == (int64_t)c[1] &&
+                          poly_pow_fits(p[0], (int64_t)c[1]);
+                ctx->stats->products += ok;
+                return ok;
+            }
+            // De exponent van het resultaat moet in een int64_t
+            // passen.
+            return m0 && m1 && e[1] == 0 &&
+                   fabs(c[1]) <= POLY_POWER_MAX &&
+                   c[1] == (int64_t)c[1] &&
+                   !__builtin_mul_overflow(e[0], (int64_t)c[1],
+                                           &e[1]) &&
+                   (c[0] != 0 || c[1] >= 0);
+        default:
+            return false;
+    }
+}
+
+// Geeft de polynoom van een symbool, of NULL wanneer het symbool geen
+// polynoom is. ok wordt false wanneer er geen geheugen meer is.
+static poly_t *poly_symbol(poly_ctx_t *ctx, token_t const *k,
+                           bool *ok) {
+    poly_t *r;
+
+    if (k->type == TOKEN_TYPE_NUMBER) {
+        r = poly_monomial(0, k->value.number);
+    } else if (k->type == TOKEN_TYPE_PI) {
+        r = poly_monomial(0, PI);
+    } else if (k->type == TOKEN_TYPE_VARIABLE &&
+               k->value.variable == 'x') {
+        r = poly_monomial(1, 1.0f);
+    } else {
+        return NULL;
+    }
+
+    ctx->stats->symbols++;
+    *ok = (r != NULL);
+    return r;
+}
+
+typedef poly_t *(*poly_op_t)(poly_t *a, poly_t *b);
+
+static poly_t *poly_op_plus(poly_t *a, poly_t *b) {
+    return poly_add(a, b, 1.0f);
+}
+
+static poly_t *poly_op_minus(poly_t *a, poly_t *b) {
+    return poly_add(a, b, -1.0f);
+}
+
+// Map operaties aan een token type, de operatie neemt beide
+// polynomen over.
+poly_op_t poly_map_op[] = {
+    [0 ... TOKEN_TYPE_INVALID] = NULL,
+    [TOKEN_TYPE_PLUS] = poly_op_plus,
+    [TOKEN_TYPE_MINUS] = poly_op_minus,
+    [TOKEN_TYPE_MULTIPLY] = poly_mul,
+    [TOKEN_TYPE_DIVIDE] = poly_div,
+    [TOKEN_TYPE_POWER] = poly_pow,
+};
+
+// Vervang een kind dat een polynoom is door zijn normaalvorm, omdat
+// de ouder zelf geen polynoom is. Een symbool blijft staan.
+static bool poly_write_child(poly_ctx_t *ctx, tree_t **slot,
+                             poly_t **p) {
+    poly_memo_t *m = NULL;  // de gedeelde node van het kind.
+    tree_t *t = NULL;
+    void *v;
+
+    if (*p == NULL) {
+        return true;
+    } else if ((*slot)->left == NULL && (*slot)->right == NULL) {
+        poly_delete(*p);
+        *p = NULL;
+        return true;
+    }
+
+    if (tree_map_get(&ctx->memo, *slot, &v)) {
+        m = &ctx->memos[(uintptr_t)v];
+        t = m->t;
+    }
+
+    if (t == NULL) {
+        t = poly_tree(ctx, *p);
+        ctx->stats->polys++;
+    }
+    if (m != NULL) {
+        m->t = t;
+    }
+
+    poly_delete(*p);
+    *p = NULL;
+    return poly_patch(ctx, slot, t);
+}
+
+// Onthoud de polynoom p van een gedeelde node t.
+static bool poly_memo(poly_ctx_t *ctx, tree_t *t, poly_t *p) {
+    void *v;
+    if (!tree_map_get(&ctx->refs, t, &v) || (uintptr_t)v < 2) {
+        return true;
+    }
+
+    if (ctx->mn >= ctx->msize) {
+        size_t size = ctx->msize ? ctx->msize * 2 : 64;
+        poly_memo_t *d =
+            realloc(ctx->memos, size * sizeof(poly_memo_t));
+        if (d == NULL) {
+            return false;
+        }
+        ctx->memos = d;
+        ctx->msize = size;
+    }
+
+    poly_memo_t *m = &ctx->memos[ctx->mn];
+    *m = (poly_memo_t){.p = p ? poly_copy(p) : NULL, .t = NULL};
+    if ((p != NULL && m->p == NULL) ||
+        !tree_map_put(&ctx->memo, t, (void *)(uintptr_t)ctx->mn)) {
+        poly_delete(m->p);
+        return false;
+    }
+    ctx->mn++;
+    return true;
+}
+
+static void poly_ctx_free(poly_ctx_t *ctx) {
+    for (size_t i = 0; i < ctx->mn; i++) {
+        poly_delete(ctx->memos[i].p);
+    }
+    free(ctx->memos);
+    free(ctx->patches);
+    tree_map_free(&ctx->refs);
+    tree_map_free(&ctx->memo);
+}
+
+// Zet de polynomen van t om naar de normaalvorm, zie poly_normalize
+// en poly_expand.
+static tree_t *poly_convert(tree_arena_handle_t const *const h,
+                            tree_t *t, poly_stats_t *stats,
+                            bool expand) {
+    poly_ctx_t ctx = {.h = h, .stats = stats, .expand = expand};
+    tree_stack_t s = {.w = sizeof(poly_frame_t)};
+    poly_t *root = NULL;  // de polynoom van t.
+    token_t x;
+    void *v;
+
+    *stats = (poly_stats_t){0};
+    token_make_variable(&x, 'x');
+    ctx.x = tree_arena_intern(h, &x, NULL, NULL);
+
+    bool ok = poly_count_refs(&ctx.refs, t);
+    poly_frame_t *f = ok ? tree_stack_push(&s) : NULL;
+    ok = (f != NULL);
+    if (ok) {
+        f->t = t;
+    }
+
+    // De boom wordt in postorder omgezet. Een node met polynomen als
+    // kinderen wordt zelf een polynoom wanneer de operatie dat
+    // toelaat, anders worden de kinderen in de boom vervangen.
+    while (ok && s.n > 0) {
+        f = tree_stack_top(&s);
+        tree_t *r = f->t;
+
+        if (f->s < 2) {
+            int i = f->s++;
+            tree_t *c = i ? r->right : r->left;
+            if (c == NULL) {
+                continue;
+            } else if (tree_map_get(&ctx.memo, c, &v)) {
+                poly_t *p = ctx.memos[(uintptr_t)v].p;
+                f->p[i] = p ? poly_copy(p) : NULL;
+                ok = (p == NULL || f->p[i] != NULL);
+                continue;
+            }
+
+            f = tree_stack_push(&s);
+            ok = (f != NULL);
+            if (ok) {
+                f->t = c;
+            }
+            continue;
+        }
+
+        poly_t *p = NULL;  // de polynoom van r.
+        if (r->left == NULL && r->right == NULL) {
+            p = poly_symbol(&ctx, &r->token, &ok);
+        } else if (poly_is_poly(&ctx, &r->token, f->p)) {
+            p = poly_map_op[r->token.type](f->p[0], f->p[1]);
+            f->p[0] = f->p[1] = NULL;
+            ok = (p != NULL);
+        } else {
+            ok = poly_write_child(&ctx, &r->left, &f->p[0]) &&
+                 poly_write_child(&ctx, &r->right, &f->p[1]);
+        }
+
+        ok = ok && poly_memo(&ctx, r, p);
+        tree_stack_pop(&s);
+        if (s.n > 0) {
+            f = tree_stack_top(&s);
+            f->p[f->s - 1] = p;
+        } else {
+            root = p;
+        }
+    }
+
+    // Bij een fout blijven er polynomen op de stack achter.
+    for (size_t i = 0; i < s.n; i++) {
+        f = (poly_frame_t *)(s.d + i * s.w);
+        poly_delete(f->p[0]);
+        poly_delete(f->p[1]);
+    }
+
+    if (ok && root != NULL && (t->left != NULL || t->right != NULL)) {
+        t = poly_tree(&ctx, root);
+        stats->polys++;
+    }
+
+    // De boom wordt pas aangepast wanneer alle nodes gemaakt zijn.
+    ok = ok && tree_arena_get_err(h) == TREE_ARENA_ERR_NONE;
+    for (size_t i = 0; ok && i < ctx.n; i++) {
+        *(ctx.patches[i].slot) = ctx.patches[i].t;
+    }
+
+    poly_delete(root);
+    tree_stack_free(&s);
+    poly_ctx_free(&ctx);
+    return ok ? t : NULL;
+}
+
+tree_t *poly_normalize(tree_arena_handle_t const *const h, tree_t *t,
+                       poly_stats_t *stats) {
+    return poly_convert(h, t, stats, false);
+}
+
+tree_t *poly_expand(tree_arena_handle_t const *const h, tree_t *t,
+                    poly_stats_t *stats) {
+    return poly_convert(h, t, stats, true);
+}
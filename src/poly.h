@@ -0,0 +1,64 @@
+/* Header van een normaalvorm voor polynomen in x. Een subboom die
+ * alleen uit getallen, pi, x, +, -, * en machten met een gehele
+ * exponent bestaat wordt omgezet naar een lijst van termen c * x^e,
+ * waarbij gelijke termen samengevoegd worden. Daarna wordt de
+ * subboom vervangen door een compacte som van de termen, gesorteerd
+ * van de hoogste naar de laagste macht. Met expand worden ook
+ * producten van sommen uitgewerkt.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __POLY_H
+#define __POLY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tree.h"
+
+typedef struct {
+    int64_t e;  // de exponent van x.
+    double c;   // de coefficient.
+} poly_term_t;
+
+// Een polynoom k * x^s * som(c * x^e). De factor k en verschuiving s
+// maken negeren, vermenigvuldigen met een constante en met een macht
+// van x O(1). Een exponent komt maar een keer voor, de hash map m
+// wijst van een exponent naar de index van de term in d.
+typedef struct {
+    poly_term_t *d;  // de termen, niet gesorteerd.
+    size_t n;        // aantal termen.
+    size_t size;     // capaciteit van d.
+    size_t *m;       // index + 1 van de term, 0 is een leeg slot.
+    size_t msize;    // capaciteit van m, een macht van 2 of 0.
+    double k;        // factor van alle coefficienten.
+    int64_t s;       // verschuiving van alle exponenten.
+} poly_t;
+
+typedef struct {
+    size_t symbols;   // aantal omgezette getallen, pi en x.
+    size_t terms;     // aantal termen na het samenvoegen.
+    size_t polys;     // aantal vervangen subbomen.
+    size_t products;  // aantal uitgewerkte producten en machten.
+} poly_stats_t;
+
+// Zet iedere maximale polynoom subboom van t om naar de normaalvorm,
+// de nieuwe nodes komen uit de arena h. Een product van twee sommen
+// wordt niet uitgewerkt. Geeft de nieuwe root, of NULL wanneer er
+// geen geheugen meer is. De boom is dan niet aangepast.
+tree_t *poly_normalize(tree_arena_handle_t const *const h, tree_t *t,
+                       poly_stats_t *stats);
+
+// Als poly_normalize, maar een product van twee sommen en een som tot
+// een gehele macht worden ook uitgewerkt. Afhankelijk van de lengte
+// wordt met schoolbook, Karatsuba of de FFT vermenigvuldigd. Een
+// product met meer dan 2^22 coefficienten blijft staan.
+tree_t *poly_expand(tree_arena_handle_t const *const h, tree_t *t,
+                    poly_stats_t *stats);
+
+// Geef het geheugen van een polynoom vrij, de polynoom is daarna de
+// nul polynoom.
+void poly_free(poly_t *p);
+
+#endif  // __POLY_H
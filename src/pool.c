@@ -0,0 +1,294 @@
+/* Implementatie van een pool met worker threads.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Beginnende capaciteit van een deque in items.
+#define POOL_DEQUE_SIZE 64
+
+typedef struct {
+    pthread_t *t;  // de threads, zonder de aanroeper.
+    int workers;   // aantal threads inclusief de aanroeper.
+
+    pthread_mutex_t m;
+    pthread_cond_t c;   // signaal voor een nieuwe taak of stop.
+    pthread_cond_t d;   // signaal dat een thread klaar is.
+    unsigned long gen;  // generatie van de huidige taak.
+    int active;         // aantal threads dat nog werkt.
+    bool stop;
+
+    pool_task_t task;
+    void *ctx;
+    size_t n;
+    atomic_size_t i;  // volgende index die opgepakt kan worden.
+} pool_data_t;
+
+static void pool_work(pool_data_t *p) {
+    size_t i;
+    while ((i = atomic_fetch_add(&p->i, 1)) < p->n) {
+        p->task(p->ctx, i);
+    }
+}
+
+static void *pool_thread(void *arg) {
+    pool_data_t *p = arg;
+    unsigned long gen = 0;
+
+    pthread_mutex_lock(&p->m);
+    while (true) {
+        while (!p->stop && p->gen == gen) {
+            pthread_cond_wait(&p->c, &p->m);
+        }
+        if (p->stop) {
+            break;
+        }
+        gen = p->gen;
+        pthread_mutex_unlock(&p->m);
+
+        pool_work(p);
+
+        pthread_mutex_lock(&p->m);
+        if (--p->active == 0) {
+            pthread_cond_signal(&p->d);
+        }
+    }
+    pthread_mutex_unlock(&p->m);
+
+    return NULL;
+}
+
+pool_t *pool_malloc(int workers) {
+    pool_data_t *p = calloc(1, sizeof(pool_data_t));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    if (workers <= 0) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    p->workers = (workers > 0) ? workers : 1;
+    p->t = calloc(p->workers, sizeof(pthread_t));
+    if (p->t == NULL) {
+        p->workers = 1;
+    }
+    pthread_mutex_init(&p->m, NULL);
+    pthread_cond_init(&p->c, NULL);
+    pthread_cond_init(&p->d, NULL);
+
+    // Wanneer een thread niet gestart kan worden werkt de pool met
+    // minder threads verder.
+    for (int i = 0; i < p->workers - 1; i++) {
+        if (pthread_create(&p->t[i], NULL, pool_thread, p) != 0) {
+            p->workers = i + 1;
+        }
+    }
+
+    return p;
+}
+
+int pool_get_workers(pool_t const *const pool) {
+    pool_data_t const *p = pool;
+    return p->workers;
+}
+
+void pool_for(pool_t *pool, size_t n, pool_task_t task, void *ctx) {
+    pool_data_t *p = pool;
+
+    pthread_mutex_lock(&p->m);
+    p->task = task;
+    p->ctx = ctx;
+    p->n = n;
+    atomic_store(&p->i, 0);
+    p->active = p->workers - 1;
+    p->gen++;
+    pthread_cond_broadcast(&p->c);
+    pthread_mutex_unlock(&p->m);
+
+    pool_work(p);
+
+    pthread_mutex_lock(&p->m);
+    while (p->active > 0) {
+        pthread_cond_wait(&p->d, &p->m);
+    }
+    pthread_mutex_unlock(&p->m);
+}
+
+// Deque van een worker, een ring van items. De eigenaar werkt aan de
+// onderkant, dieven nemen het oudste item aan de bovenkant.
+typedef struct {
+    pthread_mutex_t m;
+    char *d;      // de items.
+    size_t head;  // index van het oudste item.
+    size_t n;     // aantal items.
+    size_t size;  // capaciteit van d in items, een macht van 2.
+} pool_deque_t;
+
+typedef struct {
+    pool_deque_t *q;  // een deque per worker.
+    int workers;
+    size_t w;  // grootte van een item.
+    pool_job_t job;
+    void *ctx;
+    atomic_size_t pending;  // aantal items dat nog niet klaar is.
+    atomic_bool err;
+} pool_run_t;
+
+struct POOL_WORKER_T {
+    pool_run_t *r;
+    int id;
+};
+
+static bool pool_deque_push(pool_deque_t *q, void const *item,
+                            size_t w) {
+    pthread_mutex_lock(&q->m);
+    if (q->n >= q->size) {
+        // De ring wordt bij het groeien weer vanaf 0 neergelegd.
+        size_t size = q->size ? q->size * 2 : POOL_DEQUE_SIZE;
+        char *d = malloc(size * w);
+        if (d == NULL) {
+            pthread_mutex_unlock(&q->m);
+            return false;
+        }
+        for (size_t i = 0; i < q->n; i++) {
+            memcpy(d + i * w,
+                   q->d + ((q->head + i) & (q->size - 1)) * w, w);
+        }
+        free(q->d);
+        q->d = d;
+        q->head = 0;
+        q->size = size;
+    }
+
+    memcpy(q->d + ((q->head + q->n) & (q->size - 1)) * w, item, w);
+    q->n++;
+    pthread_mutex_unlock(&q->m);
+    return true;
+}
+
+// Neem het nieuwste item, of het oudste wanneer er gestolen wordt.
+static bool pool_deque_pop(pool_deque_t *q, void *item, size_t w,
+                           bool steal) {
+    pthread_mutex_lock(&q->m);
+    bool found = (q->n > 0);
+    if (found && steal) {
+        memcpy(item, q->d + q->head * w, w);
+        q->head = (q->head + 1) & (q->size - 1);
+        q->n--;
+    } else if (found) {
+        q->n--;
+        memcpy(item, q->d + ((q->head + q->n) & (q->size - 1)) * w,
+               w);
+    }
+    pthread_mutex_unlock(&q->m);
+    return found;
+}
+
+// Iedere index van pool_for() is een worker met een eigen deque.
+static void pool_run_worker(void *ctx, size_t i) {
+    pool_run_t *r = ctx;
+    pool_worker_t w = {.r = r, .id = (int)i};
+    char item[r->w];
+
+    while (atomic_load(&r->pending) > 0) {
+        bool found = pool_deque_pop(&r->q[i], item, r->w, false);
+        for (int j = 1; !found && j < r->workers; j++) {
+            found = pool_deque_pop(&r->q[(i + j) % r->workers], item,
+                                   r->w, true);
+        }
+
+        if (!found) {
+            sched_yield();
+            continue;
+        }
+
+        r->job(r->ctx, &w, item);
+        atomic_fetch_sub(&r->pending, 1);
+    }
+}
+
+bool pool_run(pool_t *pool, void const *items, size_t n, size_t w,
+              pool_job_t job, void *ctx) {
+    pool_data_t *p = pool;
+    pool_run_t r = {
+        .q = calloc(p->workers, sizeof(pool_deque_t)),
+        .workers = p->workers,
+        .w = w,
+        .job = job,
+        .ctx = ctx,
+    };
+    if (r.q == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < r.workers; i++) {
+        pthread_mutex_init(&r.q[i].m, NULL);
+    }
+
+    // De items worden om de beurt over de deques verdeeld.
+    atomic_store(&r.pending, 0);
+    atomic_store(&r.err, false);
+    for (size_t i = 0; i < n; i++) {
+        if (pool_deque_push(&r.q[i % r.workers],
+                            (char const *)items + i * w, w)) {
+            atomic_fetch_add(&r.pending, 1);
+        } else {
+            atomic_store(&r.err, true);
+        }
+    }
+
+    pool_for(pool, r.workers, pool_run_worker, &r);
+
+    for (int i = 0; i < r.workers; i++) {
+        pthread_mutex_destroy(&r.q[i].m);
+        free(r.q[i].d);
+    }
+    free(r.q);
+    return !atomic_load(&r.err);
+}
+
+bool pool_spawn(pool_worker_t *w, void const *item) {
+    pool_run_t *r = w->r;
+
+    // Eerst tellen, zodat pending niet 0 wordt terwijl het item nog
+    // in een deque staat.
+    atomic_fetch_add(&r->pending, 1);
+    if (!pool_deque_push(&r->q[w->id], item, r->w)) {
+        atomic_fetch_sub(&r->pending, 1);
+        atomic_store(&r->err, true);
+        return false;
+    }
+    return true;
+}
+
+int pool_worker_id(pool_worker_t const *const w) {
+    return w->id;
+}
+
+void pool_free(pool_t *pool) {
+    pool_data_t *p = pool;
+
+    pthread_mutex_lock(&p->m);
+    p->stop = true;
+    pthread_cond_broadcast(&p->c);
+    pthread_mutex_unlock(&p->m);
+
+    for (int i = 0; i < p->workers - 1; i++) {
+        pthread_join(p->t[i], NULL);
+    }
+
+    pthread_mutex_destroy(&p->m);
+    pthread_cond_destroy(&p->c);
+    pthread_cond_destroy(&p->d);
+    free(p->t);
+    free(p);
+}
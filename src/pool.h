@@ -0,0 +1,55 @@
+/* Header van een pool met worker threads. De pool voert een taak uit
+ * voor een reeks indices, de threads pakken om de beurt de volgende
+ * index zodat het werk gelijk verdeeld wordt. Werk dat pas tijdens
+ * het uitvoeren ontstaat gaat met pool_run() over deques per worker,
+ * een worker zonder werk steelt van de anderen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __POOL_H
+#define __POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void pool_t;
+
+// Een taak voor index i, ctx wordt ongewijzigd doorgegeven.
+typedef void (*pool_task_t)(void *ctx, size_t i);
+
+typedef struct POOL_WORKER_T pool_worker_t;
+
+// Een job voor een item van pool_run(), de job mag met pool_spawn()
+// nieuwe items toevoegen.
+typedef void (*pool_job_t)(void *ctx, pool_worker_t *w, void *item);
+
+// Maak een pool met in totaal workers threads, inclusief de aanroeper
+// van pool_for(). Bij 0 wordt het aantal online CPU's gebruikt.
+pool_t *pool_malloc(int workers);
+
+// Het aantal threads dat aan een taak werkt.
+int pool_get_workers(pool_t const *const pool);
+
+// Voer de taak uit voor alle i in [0, n), de aanroeper werkt mee en
+// de functie keert pas terug wanneer alle taken klaar zijn.
+void pool_for(pool_t *pool, size_t n, pool_task_t task, void *ctx);
+
+// Voer de job uit voor de n items van w bytes in items, en voor alle
+// items die de jobs zelf toevoegen. Iedere worker werkt de items van
+// zijn eigen deque als een stack af en steelt het oudste item van een
+// andere worker wanneer zijn deque leeg is. Geeft false wanneer er
+// geen geheugen meer was, er zijn dan items overgeslagen.
+bool pool_run(pool_t *pool, void const *items, size_t n, size_t w,
+              pool_job_t job, void *ctx);
+
+// Voeg een item toe aan de deque van de worker, geeft false wanneer
+// er geen geheugen meer is.
+bool pool_spawn(pool_worker_t *w, void const *item);
+
+// Nummer van de worker, van 0 tot pool_get_workers().
+int pool_worker_id(pool_worker_t const *const w);
+
+void pool_free(pool_t *pool);
+
+#endif  // __POOL_H
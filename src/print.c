@@ -0,0 +1,184 @@
+/* Implementatie van een printer die een ABS boom in infix notatie
+ * schrijft. De boom wordt met een expliciete stack doorlopen, zodat
+ * ook diepe bomen geprint kunnen worden.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "print.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "token.h"
+
+// Begin capaciteit van de buffer.
+#define PRINT_BUFFER_SIZE 4096
+
+// Voorrang van de operators, symbolen en functies binden het sterkst.
+int print_precedence[] = {
+    [0 ... TOKEN_TYPE_INVALID] = 4, [TOKEN_TYPE_MINUS] = 1,
+    [TOKEN_TYPE_PLUS] = 1,          [TOKEN_TYPE_MULTIPLY] = 2,
+    [TOKEN_TYPE_DIVIDE] = 2,        [TOKEN_TYPE_POWER] = 3,
+};
+
+// Mag een rechts kind met dezelfde voorrang zonder haakjes?
+bool print_associative[] = {
+    [0 ... TOKEN_TYPE_INVALID] = false,
+    [TOKEN_TYPE_PLUS] = true,
+    [TOKEN_TYPE_MULTIPLY] = true,
+    [TOKEN_TYPE_POWER] = true,
+};
+
+// Frame van de printer met een expliciete stack.
+typedef struct {
+    tree_t const *t;
+    int s;    // aantal geprinte kinderen.
+    bool bp;  // staat het huidige kind tussen haakjes?
+} print_frame_t;
+
+// Zorg voor ruimte voor n extra karakters.
+static bool print_reserve(print_buf_t *b, size_t n) {
+    if (b->n + n <= b->size) {
+        return true;
+    }
+
+    size_t size = b->size ? b->size : PRINT_BUFFER_SIZE;
+    while (size < b->n + n) {
+        size *= 2;
+    }
+
+    char *d = realloc(b->d, size);
+    if (d == NULL) {
+        return false;
+    }
+    b->d = d;
+    b->size = size;
+    return true;
+}
+
+static inline void print_char(print_buf_t *b, char c) {
+    b->d[b->n++] = c;
+}
+
+static inline void print_token(print_buf_t *b, tree_t const *t) {
+    b->n += token_string(&t->token, b->d + b->n);
+}
+
+// Moet het linkse kind c van t tussen haakjes? Bij een macht bindt
+// het linkse kind sterker, zodat (-2) ^ x niet als -(2 ^ x) gelezen
+// wordt.
+static bool print_bracket_left(tree_t const *t, tree_t const *c) {
+    int p = print_precedence[t->token.type];
+    int pc = print_precedence[c->token.type];
+
+    if (t->token.type == TOKEN_TYPE_POWER) {
+        return pc <= p || (token_is_number(&c->token) &&
+                           signbit(c->token.value.number));
+    }
+    return pc < p;
+}
+
+// Moet het rechtse kind c van t tussen haakjes?
+static bool print_bracket_right(tree_t const *t, tree_t const *c) {
+    int p = print_precedence[t->token.type];
+    int pc = print_precedence[c->token.type];
+    return pc < p || (pc == p && !print_associative[t->token.type]);
+}
+
+print_rt_e print_tree(print_buf_t *b, tree_t const *const t) {
+    tree_stack_t s = {.w = sizeof(print_frame_t)};
+    print_frame_t *f = tree_stack_push(&s);
+
+    if (f != NULL) {
+        f->t = t;
+    }
+
+    while (f != NULL && s.n > 0) {
+        f = tree_stack_top(&s);
+        tree_t const *r = f->t;
+        tree_t const *c = NULL;  // het kind dat nu geprint wordt.
+
+        // Per stap komen er hoogstens een token en vier karakters
+        // bij.
+        if (!print_reserve(b, TOKEN_STRING_LENGTH + 4)) {
+            f = NULL;
+            break;
+        }
+
+        if (token_is_operation_unairy(&r->token)) {
+            // Een functie zet zijn argument altijd tussen haakjes.
+            if (f->s == 0) {
+                print_token(b, r);
+                print_char(b, '(');
+                c = r->left;
+            } else {
+                print_char(b, ')');
+            }
+        } else if (token_is_operation_binairy(&r->token)) {
+            if (f->s == 0) {
+                f->bp = r->left && print_bracket_left(r, r->left);
+                c = r->left;
+            } else if (f->s == 1) {
+                if (f->bp) {
+                    print_char(b, ')');
+                }
+                print_char(b, ' ');
+                print_token(b, r);
+                print_char(b, ' ');
+                f->bp = r->right && print_bracket_right(r, r->right);
+                c = r->right;
+            } else if (f->bp) {
+                print_char(b, ')');
+            }
+
+            if (c != NULL && f->bp) {
+                print_char(b, '(');
+            }
+        } else {
+            print_token(b, r);
+        }
+
+        // Een symbool heeft geen kinderen, een functie een en een
+        // binaire operator twee.
+        int children = token_is_operation_binairy(&r->token)   ? 2
+                       : token_is_operation_unairy(&r->token) ? 1
+                                                               : 0;
+        if (f->s++ >= children) {
+            tree_stack_pop(&s);
+        } else if (c != NULL) {
+            f = tree_stack_push(&s);
+            if (f != NULL) {
+                f->t = c;
+            }
+        }
+    }
+
+    tree_stack_free(&s);
+    return (f != NULL) ? PRINT_RT_OK : PRINT_RT_ERR;
+}
+
+print_rt_e print_write(FILE *f, tree_t const *const t) {
+    print_buf_t b = {0};
+    print_rt_e rt = print_tree(&b, t);
+
+    if (rt == PRINT_RT_OK && print_reserve(&b, 1)) {
+        print_char(&b, '\n');
+        if (fwrite(b.d, 1, b.n, f) != b.n) {
+            rt = PRINT_RT_ERR_WRITE;
+        }
+    } else {
+        rt = PRINT_RT_ERR;
+    }
+
+    print_buf_free(&b);
+    return rt;
+}
+
+void print_buf_free(print_buf_t *b) {
+    free(b->d);
+    b->d = NULL;
+    b->n = 0;
+    b->size = 0;
+}
@@ -0,0 +1,39 @@
+/* Header van een printer die een ABS boom in infix notatie schrijft.
+ * De tekst wordt in een groeiende buffer opgebouwd en in een keer
+ * naar een file geschreven. Haakjes worden enkel geplaatst waar de
+ * voorrang van de operators dit nodig maakt.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __PRINT_H
+#define __PRINT_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "tree.h"
+
+typedef enum {
+    PRINT_RT_OK = 0,
+    PRINT_RT_ERR,        // er kon geen geheugen gealloceerd worden.
+    PRINT_RT_ERR_WRITE,  // schrijven naar de file is mislukt.
+} print_rt_e;
+
+typedef struct {
+    char *d;      // de karakters, niet afgesloten met een '\0'.
+    size_t n;     // aantal karakters in d.
+    size_t size;  // capaciteit van d.
+} print_buf_t;
+
+// Voeg de boom in infix notatie toe aan het einde van b.
+print_rt_e print_tree(print_buf_t *b, tree_t const *const t);
+
+// Schrijf de boom in infix notatie met een '\n' naar f, met een
+// enkele fwrite().
+print_rt_e print_write(FILE *f, tree_t const *const t);
+
+// Geef het geheugen van de buffer vrij.
+void print_buf_free(print_buf_t *b);
+
+#endif  // __PRINT_H
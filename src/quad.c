@@ -0,0 +1,236 @@
+/* Implementatie van een adaptieve Gauss-Kronrod integrator.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "quad.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "vec.h"
+
+// Aantal punten van de regel.
+#define QUAD_NODES 15
+// Aantal panelen in een blok, zodat de punten van een blok net in
+// een blok van vec_eval() passen.
+#define QUAD_CHUNK (VEC_BLOCK / QUAD_NODES)
+
+// Punten en gewichten van de 15 punts Kronrod regel op [-1, 1], de
+// punten met een oneven index zijn die van de 7 punts Gauss regel.
+static double const quad_xk[] = {
+    0.991455371120812639206854697526329,
+    0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926,
+    0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013,
+    0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245,
+    0.000000000000000000000000000000000,
+};
+
+static double const quad_wk[] = {
+    0.022935322010529224963732008058970,
+    0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518,
+    0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550,
+    0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649,
+    0.209482141084727828012999174891714,
+};
+
+static double const quad_wg[] = {
+    0.129484966168869693270611432679082,
+    0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975,
+    0.417959183673469387755102040816327,
+};
+
+typedef struct {
+    double a;
+    double b;
+    double k;     // schatting van de integraal.
+    double e;     // geschatte fout van k.
+    double r;     // schatting van de integraal van |f|.
+    bool final;   // is het paneel te smal om te halveren?
+} quad_panel_t;
+
+typedef struct {
+    comp_program_t const *p;
+    quad_panel_t *d;  // de panelen.
+    size_t *dirty;    // de panelen die geschat moeten worden.
+    size_t n;         // aantal panelen in dirty.
+    size_t size;      // capaciteit van d en dirty.
+    bool err;
+} quad_ctx_t;
+
+// Schat de panelen van een blok.
+static void quad_chunk(void *ctx, size_t i) {
+    quad_ctx_t *q = ctx;
+    size_t first = i * QUAD_CHUNK;
+    size_t m = (q->n - first < QUAD_CHUNK) ? q->n - first
+                                           : QUAD_CHUNK;
+    double x[QUAD_CHUNK * QUAD_NODES] = {0.0f};
+    double y[QUAD_CHUNK * QUAD_NODES];
+
+    // Per paneel het midden, gevolgd door de paren c - h x, c + h x.
+    for (size_t j = 0; j < m; j++) {
+        quad_panel_t const *d = &q->d[q->dirty[first + j]];
+        double c = d->a + (d->b - d->a) / 2.0f;
+        double h = (d->b - d->a) / 2.0f;
+        double *t = x + j * QUAD_NODES;
+        t[0] = c;
+        for (int k = 0; k < 7; k++) {
+            t[1 + 2 * k] = c - h * quad_xk[k];
+            t[2 + 2 * k] = c + h * quad_xk[k];
+        }
+    }
+
+    if (vec_eval(q->p, x, y, m * QUAD_NODES) != VEC_RT_OK) {
+        q->err = true;
+        return;
+    }
+
+    for (size_t j = 0; j < m; j++) {
+        quad_panel_t *d = &q->d[q->dirty[first + j]];
+        double const *t = y + j * QUAD_NODES;
+        double h = (d->b - d->a) / 2.0f;
+        double k = quad_wk[7] * t[0];
+        double g = quad_wg[3] * t[0];
+        double r = quad_wk[7] * fabs(t[0]);
+        for (int l = 0; l < 7; l++) {
+            double u = t[1 + 2 * l];
+            double v = t[2 + 2 * l];
+            double s = u + v;
+            k += quad_wk[l] * s;
+            r += quad_wk[l] * (fabs(u) + fabs(v));
+            if (l % 2 == 1) {
+                g += quad_wg[l / 2] * s;
+            }
+        }
+        d->k = k * h;
+        d->e = fabs((k - g) * h);
+        d->r = r * fabs(h);
+    }
+}
+
+static bool quad_grow(quad_ctx_t *c, size_t n) {
+    if (n <= c->size) {
+        return true;
+    }
+
+    size_t size = c->size * 2;
+    while (size < n) {
+        size *= 2;
+    }
+    quad_panel_t *d = realloc(c->d, size * sizeof(quad_panel_t));
+    if (d == NULL) {
+        return false;
+    }
+    c->d = d;
+
+    size_t *dirty = realloc(c->dirty, size * sizeof(size_t));
+    if (dirty == NULL) {
+        return false;
+    }
+    c->dirty = dirty;
+    c->size = size;
+    return true;
+}
+
+// Tel op met de compensatie van Neumaier, zodat een miljoen panelen
+// de som niet onnauwkeurig maken.
+static inline void quad_sum(double *s, double *c, double v) {
+    double t = *s + v;
+    *c += (fabs(*s) >= fabs(v)) ? (*s - t) + v : (v - t) + *s;
+    *s = t;
+}
+
+quad_rt_e quad_integrate(quad_result_t *q,
+                         comp_program_t const *const p, pool_t *pool,
+                         double a, double b, double tol) {
+    quad_ctx_t c = {
+        .p = p,
+        .d = malloc(64 * sizeof(quad_panel_t)),
+        .dirty = malloc(64 * sizeof(size_t)),
+        .size = 64,
+    };
+    size_t n = 1;  // aantal panelen.
+    quad_rt_e rt = QUAD_RT_OK;
+
+    *q = (quad_result_t){NAN, NAN, 0};
+    if (c.d == NULL || c.dirty == NULL) {
+        free(c.d);
+        free(c.dirty);
+        return QUAD_RT_ERR;
+    }
+
+    c.d[0] = (quad_panel_t){.a = a, .b = b};
+    c.dirty[0] = 0;
+    c.n = 1;
+    while (true) {
+        pool_for(pool, (c.n + QUAD_CHUNK - 1) / QUAD_CHUNK,
+                 quad_chunk, &c);
+        if (c.err) {
+            rt = QUAD_RT_ERR;
+            break;
+        }
+
+        // De som gaat over de panelen in volgorde, zodat het
+        // resultaat niet van het aantal threads afhangt.
+        double s[3] = {0.0f};  // de integraal, fout en |f|.
+        double e[3] = {0.0f};  // de compensaties.
+        for (size_t i = 0; i < n; i++) {
+            quad_sum(&s[0], &e[0], c.d[i].k);
+            quad_sum(&s[1], &e[1], c.d[i].e);
+            quad_sum(&s[2], &e[2], c.d[i].r);
+        }
+        *q = (quad_result_t){s[0] + e[0], s[1] + e[1], n};
+
+        if (!isfinite(q->value) || !isfinite(q->err)) {
+            rt = QUAD_RT_ERR_DIVERGE;
+            break;
+        } else if (q->err <= tol * (s[2] + e[2])) {
+            break;
+        }
+
+        // Halveer ieder paneel met een fout vanaf het gemiddelde,
+        // de linkse helft vervangt het paneel.
+        size_t m = n;
+        size_t max = (2 * m < QUAD_PANELS_MAX) ? 2 * m
+                                               : QUAD_PANELS_MAX;
+        if (!quad_grow(&c, max)) {
+            rt = QUAD_RT_ERR;
+            break;
+        }
+
+        double mean = q->err / n;
+        c.n = 0;
+        for (size_t i = 0; i < m && n < QUAD_PANELS_MAX; i++) {
+            quad_panel_t *d = &c.d[i];
+            double h = d->a + (d->b - d->a) / 2.0f;
+            if (d->final || d->e < mean) {
+                continue;
+            } else if (h == d->a || h == d->b) {
+                d->final = true;
+                continue;
+            }
+
+            c.d[n] = (quad_panel_t){.a = h, .b = d->b};
+            d->b = h;
+            c.dirty[c.n++] = i;
+            c.dirty[c.n++] = n++;
+        }
+
+        if (c.n == 0) {
+            rt = QUAD_RT_ERR_BUDGET;
+            break;
+        }
+    }
+
+    free(c.d);
+    free(c.dirty);
+    return rt;
+}
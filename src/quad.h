@@ -0,0 +1,42 @@
+/* Header van een adaptieve integrator op een gecompileerde expressie.
+ * Ieder paneel wordt met de 15 punts Gauss-Kronrod regel geschat, het
+ * verschil met de ingebedde 7 punts Gauss regel is de fout. Panelen
+ * met een grote fout worden in rondes gehalveerd. De nieuwe panelen
+ * van een ronde worden in blokken over de worker threads verdeeld,
+ * en de punten van een blok gaan in een keer door vec_eval().
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __QUAD_H
+#define __QUAD_H
+
+#include <stddef.h>
+
+#include "comp.h"
+#include "pool.h"
+
+// Maximaal aantal panelen.
+#define QUAD_PANELS_MAX (1 << 20)
+
+typedef enum {
+    QUAD_RT_OK = 0,
+    QUAD_RT_ERR,          // er kon geen geheugen gealloceerd worden.
+    QUAD_RT_ERR_BUDGET,   // de tolerantie is niet gehaald.
+    QUAD_RT_ERR_DIVERGE,  // de integraal is geen eindig getal.
+} quad_rt_e;
+
+typedef struct {
+    double value;   // de integraal.
+    double err;     // geschatte absolute fout.
+    size_t panels;  // aantal gebruikte panelen.
+} quad_result_t;
+
+// Integreer het programma over [a, b] tot de geschatte fout hooguit
+// tol maal de integraal van |f| is. Ook zonder QUAD_RT_OK staat de
+// beste schatting in q.
+quad_rt_e quad_integrate(quad_result_t *q,
+                         comp_program_t const *const p, pool_t *pool,
+                         double a, double b, double tol);
+
+#endif  // __QUAD_H
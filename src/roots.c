@@ -0,0 +1,490 @@
+/* Implementatie van een zoeker naar nulpunten met interval Newton.
+ * Een interval [lo, hi] met lo > hi is leeg. Na iedere operatie
+ * worden de grenzen een ulp naar buiten geschoven, zodat het
+ * resultaat ondanks de afronding alle waardes van f insluit.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "roots.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define PI (acos(0.0f) * 2.0f)
+
+// Relatieve breedte waarop een deelinterval niet meer gehalveerd
+// wordt.
+#define ROOTS_TOL 1e-12
+// Nulpunten die dichter bij elkaar liggen worden samengevoegd, in
+// eenheden van ROOTS_TOL.
+#define ROOTS_MERGE 16.0f
+// Maximaal aantal Newton stappen om een nulpunt te verfijnen.
+#define ROOTS_NEWTON_MAX 64
+// Aantal deelintervallen per worker om mee te beginnen.
+#define ROOTS_SPLIT 16
+// Grootte van de stack die roots_eval() niet hoeft te alloceren.
+#define ROOTS_STACK_SIZE 256
+
+typedef struct {
+    double lo;
+    double hi;
+} roots_iv_t;
+
+// Een interval voor de waarde en een voor de afgeleide naar x.
+typedef struct {
+    roots_iv_t v;
+    roots_iv_t d;
+} roots_ivd_t;
+
+// Een deelinterval van de zoektocht.
+typedef struct {
+    double a;
+    double b;
+} roots_box_t;
+
+typedef struct {
+    comp_program_t const *p;
+    roots_t *found;        // de gevonden nulpunten per worker.
+    atomic_size_t boxes;   // aantal afgeschatte deelintervallen.
+    atomic_bool budget;    // is ROOTS_BOXES_MAX bereikt?
+    atomic_bool err;
+} roots_ctx_t;
+
+static roots_iv_t const roots_entire = {-INFINITY, INFINITY};
+static roots_iv_t const roots_empty = {INFINITY, -INFINITY};
+
+// Schuif de grenzen naar buiten, een nan grens wordt oneindig.
+static inline roots_iv_t roots_round(double lo, double hi) {
+    return (roots_iv_t){
+        isnan(lo) ? -INFINITY : nextafter(lo, -INFINITY),
+        isnan(hi) ? INFINITY : nextafter(hi, INFINITY)};
+}
+
+static inline bool roots_contains(roots_iv_t a, double x) {
+    return (a.lo <= x && x <= a.hi);
+}
+
+static inline bool roots_is_empty(roots_iv_t a) {
+    return !(a.lo <= a.hi);
+}
+
+static inline bool roots_is_point(roots_iv_t a) {
+    return (a.lo == a.hi);
+}
+
+static inline roots_iv_t roots_neg(roots_iv_t a) {
+    return (roots_iv_t){-a.hi, -a.lo};
+}
+
+static inline roots_iv_t roots_add(roots_iv_t a, roots_iv_t b) {
+    return roots_round(a.lo + b.lo, a.hi + b.hi);
+}
+
+static inline roots_iv_t roots_sub(roots_iv_t a, roots_iv_t b) {
+    return roots_round(a.lo - b.hi, a.hi - b.lo);
+}
+
+// Een grens van een product, met 0 * oneindig = 0.
+static inline double roots_mul_bound(double a, double b) {
+    return (a == 0.0f || b == 0.0f) ? 0.0f : a * b;
+}
+
+static roots_iv_t roots_mul(roots_iv_t a, roots_iv_t b) {
+    double p[] = {
+        roots_mul_bound(a.lo, b.lo),
+        roots_mul_bound(a.lo, b.hi),
+        roots_mul_bound(a.hi, b.lo),
+        roots_mul_bound(a.hi, b.hi),
+    };
+    double lo = p[0];
+    double hi = p[0];
+    for (int i = 1; i < 4; i++) {
+        lo = fmin(lo, p[i]);
+        hi = fmax(hi, p[i]);
+    }
+    return roots_round(lo, hi);
+}
+
+// Delen door een interval met 0 kan alles geven.
+static roots_iv_t roots_div(roots_iv_t a, roots_iv_t b) {
+    if (roots_contains(b, 0.0f)) {
+        return roots_entire;
+    }
+    return roots_mul(a, roots_round(1.0f / b.hi, 1.0f / b.lo));
+}
+
+static inline roots_iv_t roots_exp(roots_iv_t a) {
+    roots_iv_t r = roots_round(exp(a.lo), exp(a.hi));
+    r.lo = fmax(r.lo, 0.0f);
+    return r;
+}
+
+// Het negatieve deel van a valt buiten het domein van log.
+static inline roots_iv_t roots_log(roots_iv_t a) {
+    if (a.hi < 0.0f) {
+        return roots_empty;
+    }
+    return roots_round(log(fmax(a.lo, 0.0f)), log(a.hi));
+}
+
+// Ligt er een p + 2 k pi in a? Ruim genomen, een fout antwoord
+// maakt het interval alleen groter.
+static bool roots_has_phase(roots_iv_t a, double p) {
+    double t = (a.lo - p) / (2.0f * PI);
+    double u = (a.hi - p) / (2.0f * PI);
+    double e = 1e-12 * (1.0f + fabs(t) + fabs(u));
+    return (floor(u + e) >= ceil(t - e));
+}
+
+// sin of cos van a, top is een x waar f(x) = 1 en in top + pi is
+// f(x) = -1.
+static roots_iv_t roots_wave(roots_iv_t a, double (*f)(double),
+                             double top) {
+    if (!(a.hi - a.lo < 2.0f * PI) || fabs(a.lo) > 0x1p52) {
+        return (roots_iv_t){-1.0f, 1.0f};
+    }
+
+    double l = f(a.lo);
+    double h = f(a.hi);
+    roots_iv_t r = roots_round(fmin(l, h), fmax(l, h));
+    if (roots_has_phase(a, top)) {
+        r.hi = 1.0f;
+    }
+    if (roots_has_phase(a, top + PI)) {
+        r.lo = -1.0f;
+    }
+    r.lo = fmax(r.lo, -1.0f);
+    r.hi = fmin(r.hi, 1.0f);
+    return r;
+}
+
+// a tot een gehele macht n.
+static roots_iv_t roots_pow_int(roots_iv_t a, int n) {
+    if (n == 0) {
+        return (roots_iv_t){1.0f, 1.0f};
+    } else if (n < 0) {
+        return roots_div((roots_iv_t){1.0f, 1.0f},
+                         roots_pow_int(a, -n));
+    }
+
+    double l = pow(a.lo, n);
+    double h = pow(a.hi, n);
+    if (n % 2 == 1 || a.lo >= 0.0f) {
+        return roots_round(l, h);
+    } else if (a.hi <= 0.0f) {
+        return roots_round(h, l);
+    }
+    return (roots_iv_t){0.0f, nextafter(fmax(l, h), INFINITY)};
+}
+
+// Een niet gehele macht is enkel voor een positief grondtal
+// gedefinieerd, u^w = exp(w * log(u)).
+static roots_iv_t roots_pow(roots_iv_t a, roots_iv_t e) {
+    if (roots_is_point(e) && fabs(e.lo) <= INT_MAX &&
+        e.lo == (int)e.lo) {
+        return roots_pow_int(a, (int)e.lo);
+    }
+    roots_iv_t l = roots_log(a);
+    return roots_is_empty(l) ? l : roots_exp(roots_mul(e, l));
+}
+
+// De exponent van de afgeleide van u^w, een gehele exponent blijft
+// exact zodat roots_pow_int() gebruikt kan worden.
+static inline roots_iv_t roots_pow_minus_one(roots_iv_t e) {
+    if (roots_is_point(e) && fabs(e.lo) <= INT_MAX &&
+        e.lo == (int)e.lo) {
+        return (roots_iv_t){e.lo - 1.0f, e.lo - 1.0f};
+    }
+    return roots_sub(e, (roots_iv_t){1.0f, 1.0f});
+}
+
+// Pas een operatie toe op intervallen met hun afgeleide, r wordt
+// genegeerd door de unaire operaties.
+static roots_ivd_t roots_apply(comp_op_e op, roots_ivd_t l,
+                               roots_ivd_t r) {
+    // Buiten het domein blijft het interval leeg.
+    if (roots_is_empty(l.v) || roots_is_empty(r.v)) {
+        return (roots_ivd_t){roots_empty, roots_empty};
+    }
+
+    switch (op) {
+        case COMP_OP_MINUS:
+            return (roots_ivd_t){roots_sub(l.v, r.v),
+                                 roots_sub(l.d, r.d)};
+        case COMP_OP_PLUS:
+            return (roots_ivd_t){roots_add(l.v, r.v),
+                                 roots_add(l.d, r.d)};
+        case COMP_OP_MULTIPLY:
+            return (roots_ivd_t){
+                roots_mul(l.v, r.v),
+                roots_add(roots_mul(l.d, r.v), roots_mul(l.v, r.d))};
+        case COMP_OP_DIVIDE: {
+            roots_iv_t v = roots_div(l.v, r.v);
+            return (roots_ivd_t){
+                v, roots_div(roots_sub(l.d, roots_mul(v, r.d)), r.v)};
+        }
+        case COMP_OP_POWER: {
+            // Net als comp_eval_dual() geen log voor een constante
+            // exponent.
+            roots_iv_t v = roots_pow(l.v, r.v);
+            if (roots_is_empty(v)) {
+                return (roots_ivd_t){v, v};
+            }
+            roots_iv_t d = roots_mul(
+                roots_mul(l.d, r.v),
+                roots_pow(l.v, roots_pow_minus_one(r.v)));
+            if (r.d.lo != 0.0f || r.d.hi != 0.0f) {
+                d = roots_add(
+                    d, roots_mul(roots_mul(r.d, v), roots_log(l.v)));
+            }
+            return (roots_ivd_t){v, d};
+        }
+        case COMP_OP_SIN:
+            return (roots_ivd_t){
+                roots_wave(l.v, sin, PI / 2.0f),
+                roots_mul(l.d, roots_wave(l.v, cos, 0.0f))};
+        case COMP_OP_COS: {
+            roots_iv_t d = roots_neg(roots_wave(l.v, sin, PI / 2.0f));
+            return (roots_ivd_t){roots_wave(l.v, cos, 0.0f),
+                                 roots_mul(l.d, d)};
+        }
+        default:
+            return (roots_ivd_t){roots_entire, roots_entire};
+    }
+}
+
+// Schat f en f' af op het interval x.
+static roots_ivd_t roots_eval(comp_program_t const *const p,
+                              roots_iv_t x) {
+    roots_ivd_t b[ROOTS_STACK_SIZE];
+    roots_ivd_t *s = b;  // de stack, gevolgd door de slots.
+    int i = -1;          // top van de stack.
+
+    roots_ivd_t v = {roots_entire, roots_entire};
+    if (p->depth + p->slots > ROOTS_STACK_SIZE) {
+        s = malloc((p->depth + p->slots) * sizeof(roots_ivd_t));
+        if (s == NULL) {
+            return v;
+        }
+    }
+    roots_ivd_t *sl = s + p->depth;  // de slots.
+
+    for (comp_instr_t const *c = p->d, *e = p->d + p->n; c < e; c++) {
+        switch (c->op) {
+            case COMP_OP_NUMBER:
+                s[++i] = (roots_ivd_t){{c->value, c->value}, {0, 0}};
+                break;
+            case COMP_OP_X:
+                s[++i] = (roots_ivd_t){x, {1.0f, 1.0f}};
+                break;
+            case COMP_OP_SIN:
+            case COMP_OP_COS:
+                s[i] = roots_apply(c->op, s[i], s[i]);
+                break;
+            case COMP_OP_LOAD:
+                s[++i] = sl[c->slot];
+                break;
+            case COMP_OP_STORE:
+                sl[c->slot] = s[i];
+                break;
+            default:
+                i--;
+                s[i] = roots_apply(c->op, s[i], s[i + 1]);
+                break;
+        }
+    }
+
+    if (i == 0) {
+        v = s[0];
+    }
+    if (s != b) {
+        free(s);
+    }
+    return v;
+}
+
+static void roots_push(roots_ctx_t *c, int w, double x) {
+    roots_t *r = &c->found[w];
+    if (r->n >= r->size) {
+        size_t size = r->size ? r->size * 2 : 16;
+        double *d = realloc(r->d, size * sizeof(double));
+        if (d == NULL) {
+            atomic_store(&c->err, true);
+            return;
+        }
+        r->d = d;
+        r->size = size;
+    }
+    r->d[r->n++] = x;
+}
+
+// Verfijn het nulpunt in [a, b] met Newton vanuit x, het interval
+// heeft precies een nulpunt. Een stap buiten het interval wordt naar
+// de rand geschoven, er wordt gestopt wanneer |f| niet meer daalt.
+static double roots_newton(comp_program_t const *const p, double a,
+                           double b, double x) {
+    double d;
+    double f = comp_eval_dual(p, x, &d);
+    for (int k = 0; k < ROOTS_NEWTON_MAX; k++) {
+        double y = x - f / d;
+        y = (y < a) ? a : (y > b) ? b : y;
+        if (y == x) {
+            break;
+        }
+
+        double e;
+        double g = comp_eval_dual(p, y, &e);
+        if (!(fabs(g) < fabs(f))) {
+            break;
+        }
+        x = y;
+        f = g;
+        d = e;
+    }
+    return x;
+}
+
+// Zoek in een deelinterval. De linkse helft wordt meteen verder
+// onderzocht, de rechtse helft kan door een andere worker gestolen
+// worden.
+static void roots_job(void *ctx, pool_worker_t *w, void *item) {
+    roots_ctx_t *c = ctx;
+    roots_box_t x = *(roots_box_t *)item;
+    int id = pool_worker_id(w);
+
+    while (true) {
+        if (atomic_fetch_add(&c->boxes, 1) >= ROOTS_BOXES_MAX) {
+            atomic_store(&c->budget, true);
+            return;
+        }
+
+        roots_ivd_t f = roots_eval(c->p, (roots_iv_t){x.a, x.b});
+        if (!roots_contains(f.v, 0.0f)) {
+            return;
+        }
+
+        // Een pool geeft een onbegrensd interval, dat is geen
+        // nulpunt. Binnen het smalle interval wordt het midden nog
+        // met Newton verfijnd.
+        double m = x.a + (x.b - x.a) / 2.0f;
+        if (x.b - x.a <= ROOTS_TOL * fmax(1.0f, fabs(m)) ||
+            m <= x.a || m >= x.b) {
+            if (isfinite(f.v.lo) && isfinite(f.v.hi)) {
+                roots_push(c, id, roots_newton(c->p, x.a, x.b, m));
+            }
+            return;
+        }
+
+        if (!roots_contains(f.d, 0.0f)) {
+            // N = m - f(m) / F', ieder nulpunt in x ligt ook in N.
+            roots_iv_t fm = roots_eval(c->p, (roots_iv_t){m, m}).v;
+            roots_iv_t n =
+                roots_sub((roots_iv_t){m, m}, roots_div(fm, f.d));
+            if (n.lo > x.a && n.hi < x.b) {
+                // N ligt binnen x, er is dus precies een nulpunt.
+                roots_push(c, id, roots_newton(c->p, n.lo, n.hi, m));
+                return;
+            }
+
+            roots_box_t y = {fmax(x.a, n.lo), fmin(x.b, n.hi)};
+            if (!(y.a <= y.b)) {
+                return;
+            } else if (y.b - y.a < (x.b - x.a) / 2.0f) {
+                x = y;
+                continue;
+            }
+        }
+
+        roots_box_t r = {m, x.b};
+        if (!pool_spawn(w, &r)) {
+            return;
+        }
+        x.b = m;
+    }
+}
+
+static int roots_compare(void const *a, void const *b) {
+    double x = *(double const *)a;
+    double y = *(double const *)b;
+    return (x > y) - (x < y);
+}
+
+roots_rt_e roots_find(roots_t *r, comp_program_t const *const p,
+                      pool_t *pool, double a, double b) {
+    int workers = pool_get_workers(pool);
+    size_t n = (size_t)workers * ROOTS_SPLIT;
+    roots_ctx_t c = {
+        .p = p,
+        .found = calloc(workers, sizeof(roots_t)),
+    };
+    roots_box_t *x = malloc(n * sizeof(roots_box_t));
+    roots_rt_e rt = ROOTS_RT_OK;
+
+    r->n = 0;
+    atomic_store(&c.boxes, 0);
+    atomic_store(&c.budget, false);
+    atomic_store(&c.err, false);
+    if (c.found == NULL || x == NULL) {
+        free(c.found);
+        free(x);
+        return ROOTS_RT_ERR;
+    }
+
+    // Gelijke stukken om mee te beginnen, een nulpunt op een grens
+    // wordt na het sorteren samengevoegd.
+    for (size_t i = 0; i < n; i++) {
+        x[i].a = (i == 0) ? a : x[i - 1].b;
+        x[i].b = (i == n - 1) ? b : a + (b - a) * (i + 1) / n;
+    }
+
+    if (!pool_run(pool, x, n, sizeof(roots_box_t), roots_job, &c) ||
+        atomic_load(&c.err)) {
+        rt = ROOTS_RT_ERR;
+    } else if (atomic_load(&c.budget)) {
+        rt = ROOTS_RT_ERR_BUDGET;
+    }
+
+    for (int i = 0; i < workers; i++) {
+        roots_t *f = &c.found[i];
+        if (rt != ROOTS_RT_ERR && r->n + f->n > r->size) {
+            double *d = realloc(r->d, (r->n + f->n) * sizeof(double));
+            if (d == NULL) {
+                rt = ROOTS_RT_ERR;
+            } else {
+                r->d = d;
+                r->size = r->n + f->n;
+            }
+        }
+        for (size_t j = 0; rt != ROOTS_RT_ERR && j < f->n; j++) {
+            r->d[r->n++] = f->d[j];
+        }
+        roots_free(f);
+    }
+    free(c.found);
+    free(x);
+
+    // Sorteer en voeg nulpunten samen die in aangrenzende
+    // deelintervallen gevonden zijn.
+    qsort(r->d, r->n, sizeof(double), roots_compare);
+    size_t k = 0;
+    for (size_t i = 0; i < r->n; i++) {
+        if (k > 0 && r->d[i] - r->d[k - 1] <=
+                         ROOTS_MERGE * ROOTS_TOL *
+                             fmax(1.0f, fabs(r->d[i]))) {
+            continue;
+        }
+        r->d[k++] = r->d[i];
+    }
+    r->n = k;
+    return rt;
+}
+
+void roots_free(roots_t *r) {
+    free(r->d);
+    r->d = NULL;
+    r->n = r->size = 0;
+}
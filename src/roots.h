@@ -0,0 +1,46 @@
+/* Header van een zoeker naar de nulpunten van een gecompileerde
+ * expressie op een interval. Met interval rekenkunde wordt f op een
+ * deelinterval afgeschat, een deelinterval waarop f niet 0 kan zijn
+ * valt af. Waar de afgeleide geen 0 bevat geeft een interval Newton
+ * stap een kleiner interval en het bewijs dat er precies een nulpunt
+ * is, anders wordt het deelinterval gehalveerd. De deelintervallen
+ * worden over de worker threads van de pool verdeeld.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __ROOTS_H
+#define __ROOTS_H
+
+#include <stddef.h>
+
+#include "comp.h"
+#include "pool.h"
+
+// Maximaal aantal deelintervallen dat afgeschat wordt.
+#define ROOTS_BOXES_MAX (1 << 20)
+
+typedef enum {
+    ROOTS_RT_OK = 0,
+    ROOTS_RT_ERR,         // er kon geen geheugen gealloceerd worden.
+    ROOTS_RT_ERR_BUDGET,  // ROOTS_BOXES_MAX is bereikt.
+} roots_rt_e;
+
+typedef struct {
+    double *d;    // de nulpunten, oplopend gesorteerd.
+    size_t n;     // aantal nulpunten.
+    size_t size;  // capaciteit van d.
+} roots_t;
+
+// Zoek de nulpunten van het programma op [a, b], de lijst wordt
+// overschreven. Een nulpunt waar de afgeleide 0 is wordt tot op een
+// relatieve breedte van ongeveer 1e-12 ingesloten, het midden van dat
+// interval komt in de lijst. Bij ROOTS_RT_ERR_BUDGET staan de tot dan
+// gevonden nulpunten in de lijst.
+roots_rt_e roots_find(roots_t *r, comp_program_t const *const p,
+                      pool_t *pool, double a, double b);
+
+// Geef het geheugen van de lijst vrij.
+void roots_free(roots_t *r);
+
+#endif  // __ROOTS_H
@@ -0,0 +1,110 @@
+/* Implementatie van een sampler die een gecompileerde expressie over
+ * een interval evalueert en naar een CSV file schrijft.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "sample.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "vec.h"
+
+// Aantal punten in een blok.
+#define SAMPLE_CHUNK 16384
+// Aantal blokken per worker in een ronde.
+#define SAMPLE_CHUNKS_PER_WORKER 4
+// Maximale lengte van een regel "x,y\n", met ruimte voor de '\0' van
+// token_format_double().
+#define SAMPLE_LINE_LENGTH (2 * TOKEN_NUMBER_LENGTH + 3)
+
+typedef struct {
+    comp_program_t const *p;
+    double a;
+    double b;
+    size_t n;
+    size_t first;  // eerste blok van de huidige ronde.
+    double *x;     // per blok ruimte voor x en y.
+    char *d;       // per blok de geformatteerde regels.
+    size_t *l;     // per blok de lengte van de regels.
+    bool err;
+} sample_ctx_t;
+
+static void sample_chunk(void *ctx, size_t i) {
+    sample_ctx_t *s = ctx;
+    size_t start = (s->first + i) * SAMPLE_CHUNK;
+    size_t m = (s->n - start < SAMPLE_CHUNK) ? s->n - start
+                                             : SAMPLE_CHUNK;
+    double *x = s->x + i * 2 * SAMPLE_CHUNK;
+    double *y = x + SAMPLE_CHUNK;
+    char *d = s->d + i * SAMPLE_CHUNK * SAMPLE_LINE_LENGTH;
+    size_t l = 0;
+
+    double w = (s->n > 1) ? (double)(s->n - 1) : 1.0f;
+    for (size_t j = 0; j < m; j++) {
+        x[j] = s->a + (s->b - s->a) * (double)(start + j) / w;
+    }
+
+    if (vec_eval(s->p, x, y, m) != VEC_RT_OK) {
+        s->err = true;
+        s->l[i] = 0;
+        return;
+    }
+
+    for (size_t j = 0; j < m; j++) {
+        l += token_format_double(d + l, x[j]);
+        d[l++] = ',';
+        l += token_format_double(d + l, y[j]);
+        d[l++] = '\n';
+    }
+    s->l[i] = l;
+}
+
+sample_rt_e sample_write(FILE *f, comp_program_t const *const p,
+                         pool_t *pool, double a, double b, size_t n) {
+    size_t chunks = (n + SAMPLE_CHUNK - 1) / SAMPLE_CHUNK;
+    size_t round = pool_get_workers(pool) * SAMPLE_CHUNKS_PER_WORKER;
+    sample_ctx_t s = {
+        .p = p,
+        .a = a,
+        .b = b,
+        .n = n,
+        .x = malloc(round * 2 * SAMPLE_CHUNK * sizeof(double)),
+        .d = malloc(round * SAMPLE_CHUNK * SAMPLE_LINE_LENGTH),
+        .l = malloc(round * sizeof(size_t)),
+        .err = false,
+    };
+    sample_rt_e rt = SAMPLE_RT_OK;
+
+    if (s.x == NULL || s.d == NULL || s.l == NULL) {
+        rt = SAMPLE_RT_ERR;
+    } else if (fprintf(f, "x,y\n") < 0) {
+        rt = SAMPLE_RT_ERR_WRITE;
+    }
+
+    // Iedere ronde rekenen de workers een aantal blokken uit, waarna
+    // de blokken in volgorde met een enkele fwrite() per blok worden
+    // weggeschreven.
+    for (s.first = 0; rt == SAMPLE_RT_OK && s.first < chunks;
+         s.first += round) {
+        size_t r = (chunks - s.first < round) ? chunks - s.first
+                                              : round;
+        pool_for(pool, r, sample_chunk, &s);
+        if (s.err) {
+            rt = SAMPLE_RT_ERR;
+        }
+
+        for (size_t i = 0; rt == SAMPLE_RT_OK && i < r; i++) {
+            char *d = s.d + i * SAMPLE_CHUNK * SAMPLE_LINE_LENGTH;
+            if (fwrite(d, 1, s.l[i], f) != s.l[i]) {
+                rt = SAMPLE_RT_ERR_WRITE;
+            }
+        }
+    }
+
+    free(s.x);
+    free(s.d);
+    free(s.l);
+    return rt;
+}
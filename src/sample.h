@@ -0,0 +1,28 @@
+/* Header van een sampler die een gecompileerde expressie over een
+ * interval evalueert en de punten als CSV naar een file schrijft. Het
+ * interval wordt in blokken over de worker threads verdeeld, de
+ * blokken worden in volgorde naar de file geschreven.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __SAMPLE_H
+#define __SAMPLE_H
+
+#include <stdio.h>
+
+#include "comp.h"
+#include "pool.h"
+
+typedef enum {
+    SAMPLE_RT_OK = 0,
+    SAMPLE_RT_ERR,        // er kon geen geheugen gealloceerd worden.
+    SAMPLE_RT_ERR_WRITE,  // schrijven naar de file is mislukt.
+} sample_rt_e;
+
+// Schrijf n punten (x, f(x)) met x gelijk verdeeld over [a, b] naar
+// de file f. Het programma wordt enkel gelezen.
+sample_rt_e sample_write(FILE *f, comp_program_t const *const p,
+                         pool_t *pool, double a, double b, size_t n);
+
+#endif  // __SAMPLE_H
@@ -6,17 +6,10 @@
 #include "simp.h"
 
 #include <math.h>
-#include <stdbool.h>
-#include <stdio.h>
+#include <stdint.h>
 
 #define PI acos(0.0f) * 2.0f
 
-typedef enum {
-    SIMP_RT_OK = 0,
-    SIMP_RT_NUMERICAL,  // Return value om te bepalen of een symbool
-                        // verwerkt kan worden als nummer.
-} simp_rt_e;
-
 simp_rt_e simp_symbol_pi(token_t* t, double* n) {
     *n = PI;
     return SIMP_RT_NUMERICAL;
@@ -60,7 +53,14 @@ static inline simp_rt_e simp_op_get_numerical(token_t* left,
     return rt;
 }
 
-void simp_op_plus(tree_t* t) {
+// Token van de -1 die 0 - expr vervangt.
+static token_t const simp_minus_one = {
+    .type = TOKEN_TYPE_NUMBER,
+    .value.number = -1.0f,
+};
+
+void simp_op_plus(tree_arena_handle_t const* const h, tree_t* t,
+                  simp_stats_t* stats) {
     double vl, vr;  // numerieke waarde van de linkse en rechtse node.
 
     if (t->left == NULL || t->right == NULL) {
@@ -80,7 +80,8 @@ void simp_op_plus(tree_t* t) {
     }
 }
 
-void simp_op_minus(tree_t* t) {
+void simp_op_minus(tree_arena_handle_t const* const h, tree_t* t,
+                   simp_stats_t* stats) {
     double vl, vr;  // numerieke waarde van de linkse en rechtse node.
 
     if (t->left == NULL || t->right == NULL) {
@@ -88,8 +89,14 @@ void simp_op_minus(tree_t* t) {
     }
 
     if (token_cmp_number(&t->left->token, 0.0f)) {  // 0 - expr = expr
-        token_make_type(&t->token, TOKEN_TYPE_MULTIPLY);
-        token_make_number(&t->left->token, -1.0f);
+        // De linkse node kan gedeeld zijn, dus die wordt niet
+        // aangepast maar vervangen door de gedeelde -1 uit de arena.
+        // Is de arena vol dan blijft de node staan.
+        tree_t* m = tree_arena_intern(h, &simp_minus_one, NULL, NULL);
+        if (tree_arena_get_err(h) == TREE_ARENA_ERR_NONE) {
+            token_make_type(&t->token, TOKEN_TYPE_MULTIPLY);
+            t->left = m;
+        }
     } else if (token_cmp_number(&t->right->token,
                                 0.0f)) {  // expr - 0 = expr
         tree_move_node(t, t->left);
@@ -106,7 +113,8 @@ void simp_op_minus(tree_t* t) {
     }
 }
 
-void simp_op_multiply(tree_t* t) {
+void simp_op_multiply(tree_arena_handle_t const* const h, tree_t* t,
+                      simp_stats_t* stats) {
     double vl, vr;  // numerieke waarde van de linkse en rechtse node.
 
     if (t->left == NULL || t->right == NULL) {
@@ -132,7 +140,8 @@ void simp_op_multiply(tree_t* t) {
     }
 }
 
-void simp_op_divide(tree_t* t) {
+void simp_op_divide(tree_arena_handle_t const* const h, tree_t* t,
+                    simp_stats_t* stats) {
     double vl, vr;  // numerieke waarde van de linkse en rechtse node.
 
     if (t->left == NULL || t->right == NULL) {
@@ -140,7 +149,7 @@ void simp_op_divide(tree_t* t) {
     }
 
     if (token_cmp_number(&t->right->token, 0.0f)) {  // expr / 0 = err
-        printf("!ERR Division by 0.\n");
+        stats->zeros++;
     } else if (token_cmp_variable(
                    &t->left->token,
                    &t->right->token)) {  // expr / 1 = expr
@@ -154,7 +163,8 @@ void simp_op_divide(tree_t* t) {
     }
 }
 
-void simp_op_power(tree_t* t) {
+void simp_op_power(tree_arena_handle_t const* const h, tree_t* t,
+                   simp_stats_t* stats) {
     double vl, vr;  // numerieke waarde van de linkse en rechtse node.
 
     if (t->left == NULL || t->right == NULL) {
@@ -180,7 +190,8 @@ void simp_op_power(tree_t* t) {
     }
 }
 
-void simp_op_sin(tree_t* t) {
+void simp_op_sin(tree_arena_handle_t const* const h, tree_t* t,
+                 simp_stats_t* stats) {
     double vl;  // numerieke waarde van de linkse node.
 
     if (simp_op_get_numerical(&t->left->token, NULL, &vl, NULL) ==
@@ -190,7 +201,8 @@ void simp_op_sin(tree_t* t) {
     }
 }
 
-void simp_op_cos(tree_t* t) {
+void simp_op_cos(tree_arena_handle_t const* const h, tree_t* t,
+                 simp_stats_t* stats) {
     double vl;  // numerieke waarde van de linkse node.
 
     if (simp_op_get_numerical(&t->left->token, NULL, &vl, NULL) ==
@@ -200,9 +212,11 @@ void simp_op_cos(tree_t* t) {
     }
 }
 
-void simp_op_invalid(tree_t* t) {}
+void simp_op_invalid(tree_arena_handle_t const* const h, tree_t* t,
+                     simp_stats_t* stats) {}
 
-typedef void (*simp_op_t)(tree_t* t);
+typedef void (*simp_op_t)(tree_arena_handle_t const* const h,
+                          tree_t* t, simp_stats_t* stats);
 
 /* Map operaties aan een token type, wanneer een token geen operatie
  * is gebeurd er niets. De operatie functie calls managen de volledige
@@ -220,15 +234,78 @@ simp_op_t simp_map_op[] = {
     [TOKEN_TYPE_COS] = simp_op_cos,
 };
 
-void simp_tree(tree_t* tree) {
-    if (tree == NULL) {
-        return;
+// Frame van de worklist.
+typedef struct {
+    tree_t* t;
+    int s;  // aantal bekeken kinderen.
+} simp_frame_t;
+
+simp_rt_e simp_tree(tree_arena_handle_t const* const h, tree_t* tree,
+                    simp_stats_t* stats) {
+    tree_map_t visited = {0};  // de nodes die een fixpoint zijn.
+    tree_stack_t s = {.w = sizeof(simp_frame_t)};
+    simp_frame_t* f = tree_stack_push(&s);
+    simp_rt_e rt = SIMP_RT_OK;
+    size_t budget = stats->budget ? stats->budget : SIZE_MAX;
+    void* v;
+
+    stats->rewrites = 0;
+    stats->visits = 0;
+    stats->zeros = 0;
+    if (f != NULL) {
+        f->t = tree;
     }
 
-    simp_tree(tree->left);
-    simp_tree(tree->right);
+    // De worklist is een stack in postorder, een node wordt pas
+    // bekeken wanneer zijn kinderen een fixpoint zijn. De regels
+    // kijken alleen naar een node en zijn kinderen, dus een node die
+    // niet verandert is ook een fixpoint. Een herschreven node gaat
+    // terug op de worklist, zijn ouders staan er nog onder. Zo worden
+    // alleen de herschreven nodes opnieuw bekeken.
+    while (f != NULL && s.n > 0) {
+        f = tree_stack_top(&s);
+        if (f->s < 2) {
+            tree_t* c = (f->s++ == 0) ? f->t->left : f->t->right;
+            if (c != NULL && !tree_map_get(&visited, c, &v)) {
+                f = tree_stack_push(&s);
+                if (f != NULL) {
+                    f->t = c;
+                }
+            }
+            continue;
+        }
+
+        if (stats->visits >= budget) {
+            rt = SIMP_RT_BUDGET;
+            break;
+        }
+
+        tree_t* t = f->t;
+        tree_t old = *t;  // de node voor de regels.
+        stats->visits++;
+        simp_map_op[t->token.type](h, t, stats);
+
+        if (token_cmp(&old.token, &t->token) && old.left == t->left &&
+            old.right == t->right) {
+            // Een gedeelde node hoeft maar een keer bekeken te
+            // worden. Kan de node niet onthouden worden dan wordt hij
+            // later nogmaals bekeken, wat alleen tijd kost.
+            tree_stack_pop(&s);
+            tree_map_put(&visited, t, NULL);
+            continue;
+        }
+
+        // De kinderen worden opnieuw langsgelopen, alleen een nieuw
+        // kind dat nog geen fixpoint is wordt daarbij bekeken.
+        stats->rewrites++;
+        f->s = 0;
+    }
+
+    if (f == NULL) {
+        rt = SIMP_RT_ERR;
+    }
 
-    /* Zet binnen de operaties de takken van de node gewoon op NULL,
-     * deze worden gedealloceerd in de arena. */
-    simp_map_op[tree->token.type](tree);
+    tree_stack_free(&s);
+    tree_map_free(&visited);
+    return rt;
 }
@@ -1,4 +1,7 @@
-/* Header voor een interpreter die een ABS boom versimpeld.
+/* Header voor een interpreter die een ABS boom versimpeld. De regels
+ * worden met een worklist herhaald tot er niks meer verandert, na
+ * een herschrijving worden alleen de node en zijn ouders opnieuw
+ * bekeken.
  *
  * Door: Jenny Vermeltfoort, Universiteit van Leiden.
  */
@@ -6,8 +9,31 @@
 #ifndef __SIMP_H
 #define __SIMP_H
 
+#include <stddef.h>
+
 #include "tree.h"
 
-void simp_tree(tree_t* root);
+typedef enum {
+    SIMP_RT_OK = 0,
+    SIMP_RT_NUMERICAL,  // Return value om te bepalen of een symbool
+                        // verwerkt kan worden als nummer.
+    SIMP_RT_BUDGET,     // het budget is op voor een fixpoint bereikt
+                        // is.
+    SIMP_RT_ERR,        // er kon geen geheugen gealloceerd worden.
+} simp_rt_e;
+
+typedef struct {
+    size_t budget;    // maximum aantal bezoeken, 0 is onbeperkt.
+    size_t rewrites;  // aantal herschrijvingen.
+    size_t visits;    // aantal keer dat een node bekeken is.
+    size_t zeros;     // aantal bezochte delingen door 0.
+} simp_stats_t;
+
+// Versimpel de boom in arena h tot een fixpoint of tot het budget in
+// stats op is. Nieuwe nodes komen gedeeld in h. Het aantal
+// herschrijvingen en bezoeken komt in stats, net als het aantal
+// delingen door 0 dat de aanroeper kan melden.
+simp_rt_e simp_tree(tree_arena_handle_t const* const h, tree_t* root,
+                    simp_stats_t* stats);
 
 #endif  // __SIMP_H
@@ -0,0 +1,222 @@
+/* Implementatie van een evaluator op afgekapte machtreeksen. Alle
+ * kernels werken op de reeks l van de linkse operand, die ook het
+ * resultaat wordt, r is de reeks van de rechtse operand en t een
+ * kladblok van twee reeksen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "taylor.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*taylor_op_t)(double *l, double const *r, double *t,
+                            int n);
+
+static void taylor_minus(double *l, double const *r, double *t,
+                         int n) {
+    for (int k = 0; k <= n; k++) {
+        l[k] -= r[k];
+    }
+}
+
+static void taylor_plus(double *l, double const *r, double *t,
+                        int n) {
+    for (int k = 0; k <= n; k++) {
+        l[k] += r[k];
+    }
+}
+
+// Het product van twee reeksen. Van de hoogste orde naar beneden,
+// zodat l[k] pas overschreven wordt wanneer het niet meer nodig is.
+// r mag daarom ook gelijk zijn aan l.
+static void taylor_multiply(double *l, double const *r, double *t,
+                            int n) {
+    for (int k = n; k >= 0; k--) {
+        double s = 0.0f;
+        for (int j = 0; j <= k; j++) {
+            s += l[j] * r[k - j];
+        }
+        l[k] = s;
+    }
+}
+
+// l / r, uit l = h * r volgt h_k = (l_k - som r_j h_(k-j)) / r_0.
+static void taylor_divide(double *l, double const *r, double *t,
+                          int n) {
+    for (int k = 0; k <= n; k++) {
+        double s = l[k];
+        for (int j = 1; j <= k; j++) {
+            s -= r[j] * l[k - j];
+        }
+        l[k] = s / r[0];
+    }
+}
+
+// De reeksen van sin(u) en cos(u) naar s en c, uit s' = c * u' en
+// c' = -s * u'.
+static void taylor_sincos(double const *u, double *s, double *c,
+                          int n) {
+    s[0] = sin(u[0]);
+    c[0] = cos(u[0]);
+    for (int k = 1; k <= n; k++) {
+        double ss = 0.0f;
+        double cs = 0.0f;
+        for (int j = 1; j <= k; j++) {
+            ss += j * u[j] * c[k - j];
+            cs += j * u[j] * s[k - j];
+        }
+        s[k] = ss / k;
+        c[k] = -cs / k;
+    }
+}
+
+static void taylor_sin(double *l, double const *r, double *t, int n) {
+    taylor_sincos(l, t, t + n + 1, n);
+    memcpy(l, t, (n + 1) * sizeof(double));
+}
+
+static void taylor_cos(double *l, double const *r, double *t, int n) {
+    taylor_sincos(l, t, t + n + 1, n);
+    memcpy(l, t + n + 1, (n + 1) * sizeof(double));
+}
+
+// De reeks van log(u) naar h, uit u * h' = u'.
+static void taylor_log(double const *u, double *h, int n) {
+    h[0] = log(u[0]);
+    for (int k = 1; k <= n; k++) {
+        double s = 0.0f;
+        for (int j = 1; j < k; j++) {
+            s += j * h[j] * u[k - j];
+        }
+        h[k] = (u[k] - s / k) / u[0];
+    }
+}
+
+// De reeks van exp(u) naar h, uit h' = h * u'.
+static void taylor_exp(double const *u, double *h, int n) {
+    h[0] = exp(u[0]);
+    for (int k = 1; k <= n; k++) {
+        double s = 0.0f;
+        for (int j = 1; j <= k; j++) {
+            s += j * u[j] * h[k - j];
+        }
+        h[k] = s / k;
+    }
+}
+
+static void taylor_power(double *l, double const *r, double *t,
+                         int n) {
+    bool constant = true;  // is de exponent een constante?
+    for (int k = 1; k <= n; k++) {
+        constant = constant && r[k] == 0.0f;
+    }
+
+    if (!constant) {
+        // u^w = exp(w * log(u)).
+        taylor_log(l, t, n);
+        taylor_multiply(t, r, NULL, n);
+        taylor_exp(t, l, n);
+    } else if (l[0] != 0.0f) {
+        // Uit u * h' = e * u' * h, met h = u^e.
+        double e = r[0];
+        t[0] = pow(l[0], e);
+        for (int k = 1; k <= n; k++) {
+            double s = 0.0f;
+            for (int j = 1; j <= k; j++) {
+                s += (e * j - (k - j)) * l[j] * t[k - j];
+            }
+            t[k] = s / (k * l[0]);
+        }
+        memcpy(l, t, (n + 1) * sizeof(double));
+    } else if (r[0] >= 0.0f && r[0] <= INT_MAX &&
+               r[0] == (int)r[0]) {
+        // Een reeks die in 0 begint tot een gehele macht, met
+        // herhaald kwadrateren.
+        memcpy(t, l, (n + 1) * sizeof(double));
+        memset(l, 0, (n + 1) * sizeof(double));
+        l[0] = 1.0f;
+        for (unsigned e = (unsigned)r[0]; e > 0; e >>= 1) {
+            if (e & 1) {
+                taylor_multiply(l, t, NULL, n);
+            }
+            if (e > 1) {
+                taylor_multiply(t, t, NULL, n);
+            }
+        }
+    } else {
+        // Een niet gehele macht van 0 heeft geen afgeleides.
+        l[0] = pow(l[0], r[0]);
+        for (int k = 1; k <= n; k++) {
+            l[k] = NAN;
+        }
+    }
+}
+
+taylor_op_t taylor_map_op[] = {
+    [0 ... COMP_OP_INVALID] = NULL,
+    [COMP_OP_MINUS] = taylor_minus,
+    [COMP_OP_PLUS] = taylor_plus,
+    [COMP_OP_MULTIPLY] = taylor_multiply,
+    [COMP_OP_DIVIDE] = taylor_divide,
+    [COMP_OP_POWER] = taylor_power,
+    [COMP_OP_SIN] = taylor_sin,
+    [COMP_OP_COS] = taylor_cos,
+};
+
+taylor_rt_e taylor_eval(comp_program_t const *const p, double a,
+                        int n, double *c) {
+    int m = n + 1;  // lengte van een reeks.
+
+    // De stack, gevolgd door de slots en het kladblok.
+    double *s = malloc((size_t)(p->depth + p->slots + 2) * m *
+                       sizeof(double));
+    if (s == NULL) {
+        return TAYLOR_RT_ERR;
+    }
+    double *sl = s + p->depth * m;  // de slots.
+    double *t = sl + p->slots * m;  // het kladblok.
+
+    double *top = s - m;  // top van de stack.
+    for (comp_instr_t const *i = p->d, *e = p->d + p->n; i < e; i++) {
+        switch (i->op) {
+            case COMP_OP_NUMBER:
+                top += m;
+                memset(top, 0, m * sizeof(double));
+                top[0] = i->value;
+                break;
+            case COMP_OP_X:
+                // x = a + t.
+                top += m;
+                memset(top, 0, m * sizeof(double));
+                top[0] = a;
+                if (n > 0) {
+                    top[1] = 1.0f;
+                }
+                break;
+            case COMP_OP_SIN:
+            case COMP_OP_COS:
+                taylor_map_op[i->op](top, NULL, t, n);
+                break;
+            case COMP_OP_LOAD:
+                top += m;
+                memcpy(top, sl + i->slot * m, m * sizeof(double));
+                break;
+            case COMP_OP_STORE:
+                memcpy(sl + i->slot * m, top, m * sizeof(double));
+                break;
+            default:
+                top -= m;
+                taylor_map_op[i->op](top, top + m, t, n);
+                break;
+        }
+    }
+
+    memcpy(c, s, m * sizeof(double));
+    free(s);
+    return TAYLOR_RT_OK;
+}
@@ -0,0 +1,28 @@
+/* Header van een evaluator op afgekapte machtreeksen. Iedere plek op
+ * de stack van de machine is een reeks c_0 + c_1 t + ... + c_n t^n,
+ * met t = x - a. Voor iedere operatie wordt de reeks van het
+ * resultaat met een recurrente betrekking uitgerekend, in O(n^2) per
+ * instructie en zonder bomen van de afgeleides op te bouwen.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __TAYLOR_H
+#define __TAYLOR_H
+
+#include "comp.h"
+
+// Grootste orde van een reeks.
+#define TAYLOR_ORDER_MAX 1024
+
+typedef enum {
+    TAYLOR_RT_OK = 0,
+    TAYLOR_RT_ERR,  // er kon geen stack gealloceerd worden.
+} taylor_rt_e;
+
+// Evalueer het programma op de reeks van x in a tot en met orde n.
+// c[k] wordt de k-de afgeleide in a gedeeld door k!, voor k = 0..n.
+taylor_rt_e taylor_eval(comp_program_t const *const p, double a,
+                        int n, double *c);
+
+#endif  // __TAYLOR_H
@@ -6,8 +6,11 @@
 #include "token.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "token_pow10.h"
+
 token_cat_e token_type_to_cat[] = {
     [0 ... TOKEN_TYPE_INVALID] = TOKEN_CAT_INVALID,
     [TOKEN_TYPE_MINUS] = TOKEN_CAT_OP_BINAIR,
@@ -45,17 +48,196 @@ char token_type_to_string[][TOKEN_STRING_LENGTH] = {
     [TOKEN_TYPE_PI] = "pi",
 };
 
+// De cijfers van 00 tot en met 99, twee karakters per getal.
+static const char token_digits[] =
+    "000102030405060708091011121314151617181920212223242526272829"
+    "303132333435363738394041424344454647484950515253545556575859"
+    "606162636465666768697071727374757677787980818283848586878889"
+    "90919293949596979899";
+
 token_cat_e token_get_cat(token_t const* const token) {
     return token_type_to_cat[token->type];
 }
 
-void token_string(token_t const* const token, token_string_t string) {
+// Geeft de hoge 64 bits van g * c / 2^64, oneven gemaakt wanneer er
+// bits anders dan 0 wegvallen.
+static inline uint64_t token_round_to_odd(uint64_t const* g,
+                                          uint64_t c) {
+    __uint128_t x = (__uint128_t)g[1] * c;
+    __uint128_t y = (__uint128_t)g[0] * c + (uint64_t)(x >> 64);
+    return (uint64_t)(y >> 64) | ((uint64_t)y > 1);
+}
+
+// Bepaal het kortste getal s * 10^k dat bij het teruglezen weer v
+// geeft, voor een eindige v groter dan 0. Dit is het algoritme van
+// Schubfach van Raffaello Giulietti, zie "The Schubfach way to render
+// doubles".
+static void token_shortest(double v, uint64_t* sp, int* kp) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(double));
+    uint64_t f = bits & ((1ULL << 52) - 1);  // de fractie.
+    int be = (int)(bits >> 52);              // de exponent met bias.
+    uint64_t c;                              // v = c * 2^q.
+    int q;
+
+    if (be != 0) {
+        c = f | (1ULL << 52);
+        q = be - 1075;
+
+        // Een geheel getal onder 2^53 heeft geen kortere vorm.
+        if (q <= 0 && q > -53 && (c & ((1ULL << -q) - 1)) == 0) {
+            *sp = c >> -q;
+            *kp = 0;
+            return;
+        }
+    } else {
+        c = f;
+        q = -1074;
+    }
+
+    // Het interval van getallen die naar v afronden is [cbl, cbr] *
+    // 2^(q-2), de grenzen horen erbij wanneer c even is.
+    bool even = (c % 2 == 0);
+    bool closer = (f == 0 && be > 1);  // onderste grens dichterbij?
+    uint64_t cbl = 4 * c - 2 + closer;
+    uint64_t cb = 4 * c;
+    uint64_t cbr = 4 * c + 2;
+
+    // k = floor(log10(2^q)), of floor(log10(3/4 * 2^q)) wanneer de
+    // onderste grens dichter bij ligt.
+    int k = (q * 1262611 - (closer ? 524031 : 0)) >> 22;
+    int h = q + ((-k * 1741647) >> 19) + 1;
+    uint64_t const* g = token_pow10[-k - TOKEN_POW10_MIN];
+
+    uint64_t vbl = token_round_to_odd(g, cbl << h);
+    uint64_t vb = token_round_to_odd(g, cb << h);
+    uint64_t vbr = token_round_to_odd(g, cbr << h);
+    uint64_t lower = vbl + !even;
+    uint64_t upper = vbr - !even;
+    uint64_t s = vb / 4;
+
+    // Past er een getal met een cijfer minder in het interval?
+    if (s >= 10) {
+        uint64_t s10 = s / 10;
+        bool up = (lower <= 40 * s10);
+        bool wp = (40 * s10 + 40 <= upper);
+        if (up != wp) {
+            *sp = s10 + wp;
+            *kp = k + 1;
+            return;
+        }
+    }
+
+    bool u = (lower <= 4 * s);
+    bool w = (4 * s + 4 <= upper);
+    if (u != w) {
+        *sp = s + w;
+        *kp = k;
+        return;
+    }
+
+    // Beide of geen van beide liggen in het interval, kies de
+    // dichtste en bij gelijke afstand de even.
+    uint64_t mid = 4 * s + 2;
+    *sp = s + (vb > mid || (vb == mid && (s & 1) != 0));
+    *kp = k;
+}
+
+// Schrijf de cijfers van s twee tegelijk, eindigend voor e. Geeft een
+// pointer naar het eerste cijfer.
+static char* token_write_digits(char* e, uint64_t s) {
+    while (s >= 100) {
+        e -= 2;
+        memcpy(e, token_digits + 2 * (s % 100), 2);
+        s /= 100;
+    }
+
+    if (s >= 10) {
+        e -= 2;
+        memcpy(e, token_digits + 2 * s, 2);
+    } else {
+        *(--e) = '0' + s;
+    }
+    return e;
+}
+
+int token_format_double(char* d, double v) {
+    char* p = d;
+
+    if (signbit(v)) {
+        *(p++) = '-';
+        v = -v;
+    }
+
+    if (isnan(v) || isinf(v) || v == 0) {
+        char const* t = isnan(v) ? "nan" : isinf(v) ? "inf" : "0";
+        strcpy(p, t);
+        return p - d + strlen(t);
+    }
+
+    uint64_t s;  // v = s * 10^k.
+    int k;
+    token_shortest(v, &s, &k);
+    while (s % 10 == 0) {
+        s /= 10;
+        k++;
+    }
+
+    char b[20];  // de cijfers van s, achteraan in b.
+    char* t = token_write_digits(b + sizeof(b), s);
+    int n = b + sizeof(b) - t;  // aantal cijfers.
+    int x = k + n - 1;          // de exponent van het eerste cijfer.
+
+    // Net als bij "%g" wordt een exponent gebruikt wanneer het getal
+    // anders voorloopnullen of nullen achteraan nodig heeft.
+    if (x < -4 || x >= TOKEN_DIGITS_MAX) {
+        *(p++) = t[0];
+        if (n > 1) {
+            *(p++) = '.';
+            memcpy(p, t + 1, n - 1);
+            p += n - 1;
+        }
+        *(p++) = 'e';
+        *(p++) = (x < 0) ? '-' : '+';
+        x = abs(x);
+        if (x >= 100) {
+            *(p++) = '0' + x / 100;
+            x %= 100;
+        }
+        memcpy(p, token_digits + 2 * x, 2);
+        p += 2;
+    } else if (x < 0) {
+        memcpy(p, "0.0000", 1 - x);
+        p += 1 - x;
+        memcpy(p, t, n);
+        p += n;
+    } else if (k >= 0) {
+        memcpy(p, t, n);
+        memset(p + n, '0', k);
+        p += n + k;
+    } else {
+        memcpy(p, t, x + 1);
+        p[x + 1] = '.';
+        memcpy(p + x + 2, t + x + 1, n - x - 1);
+        p += n + 1;
+    }
+
+    *p = '\0';
+    return p - d;
+}
+
+int token_string(token_t const* const token, token_string_t string) {
+    int n = token_type_to_string_lenghts[token->type];
+
     if (token->type == TOKEN_TYPE_VARIABLE) {
         string[0] = token->value.variable;
+        n = 1;
     } else if (token->type == TOKEN_TYPE_NUMBER) {
-        sprintf(string, "%g", token->value.number);
+        return token_format_double(string, token->value.number);
     } else {
-        memcpy(string, token_type_to_string[token->type],
-               token_type_to_string_lenghts[token->type]);
+        memcpy(string, token_type_to_string[token->type], n);
     }
+
+    string[n] = '\0';
+    return n;
 }
@@ -12,12 +12,17 @@
 #include <float.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 
 // Voor double compare.
 #define EPSILON 1e-9
-// Maximum aantal karakters voor een double.
-#define TOKEN_STRING_LENGTH DBL_MAX_10_EXP + 2
+// Maximum aantal significante cijfers van een geschreven double.
+#define TOKEN_DIGITS_MAX 17
+// Maximum aantal karakters van een geschreven double, zonder de '\0'.
+#define TOKEN_NUMBER_LENGTH 24
+// Maximum aantal karakters van een token, met de '\0'.
+#define TOKEN_STRING_LENGTH (TOKEN_NUMBER_LENGTH + 1)
 
 typedef char token_string_t[TOKEN_STRING_LENGTH];
 
@@ -55,8 +60,15 @@ typedef struct {
 // Haal de categorie van een token op afhankelijk aan de type.
 token_cat_e token_get_cat(token_t const* const token);
 
-// Converteerd een token naar een string.
-void token_string(token_t const* const token, token_string_t string);
+// Converteerd een token naar een string, geeft het aantal karakters
+// zonder de '\0'.
+int token_string(token_t const* const token, token_string_t string);
+
+// Schrijf de kortste decimale vorm van v naar d die bij het
+// teruglezen precies v geeft, afgesloten met een '\0'. d moet ruimte
+// hebben voor TOKEN_NUMBER_LENGTH + 1 karakters. Geeft het aantal
+// karakters zonder de '\0'.
+int token_format_double(char* d, double v);
 
 static inline bool token_is_operation(token_t const* const t) {
     return (token_get_cat(t) &
@@ -93,6 +105,35 @@ static inline bool token_cmp_variable(token_t const* const t1,
             t1->value.variable == t2->value.variable);
 }
 
+// Vergelijk twee tokens exact, nummers worden op bit niveau
+// vergeleken zodat bijvoorbeeld 0 en -0 verschillend zijn.
+static inline bool token_cmp(token_t const* const t1,
+                             token_t const* const t2) {
+    if (t1->type != t2->type) {
+        return false;
+    } else if (t1->type == TOKEN_TYPE_NUMBER) {
+        return memcmp(&t1->value.number, &t2->value.number,
+                      sizeof(double)) == 0;
+    } else if (t1->type == TOKEN_TYPE_VARIABLE) {
+        return t1->value.variable == t2->value.variable;
+    }
+    return true;
+}
+
+// Hash van een token, gelijk voor tokens waarvoor token_cmp() waar
+// is.
+static inline uint64_t token_hash(token_t const* const t) {
+    uint64_t h = (uint64_t)t->type;
+    if (t->type == TOKEN_TYPE_NUMBER) {
+        uint64_t v;
+        memcpy(&v, &t->value.number, sizeof(double));
+        h ^= v;
+    } else if (t->type == TOKEN_TYPE_VARIABLE) {
+        h ^= (uint64_t)t->value.variable << 8;
+    }
+    return h;
+}
+
 static inline void token_copy(token_t* const trg,
                               token_t const* const src) {
     memcpy(trg, src, sizeof(token_t));
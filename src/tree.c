@@ -7,9 +7,11 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 // Bereken de ouder van een kind met de pointer naar het kind.
 #define OFFSET_OF(type, member) ((size_t) & ((type*)0)->member)
@@ -19,51 +21,180 @@
         (type*)((char*)_mptr - OFFSET_OF(type, member));     \
     })
 
-// Formaat van tree_arena_t is ongeveer 32KiB, zodat het in
-// de L1 cache past van de meeste moderne CPU's.
-#define TREE_ARENA_SIZE 768
+// Formaat van een L1 page is 32KiB, zodat het in de L1 cache past
+// van de meeste moderne CPU's. Grote pages hebben het formaat van een
+// x86-64 hugepage.
+#define TREE_ARENA_PAGE_BYTES_L1 (32 * 1024)
+#define TREE_ARENA_PAGE_BYTES_LARGE (2 * 1024 * 1024)
+
+// Een arena is een ketting van pages. Nieuwe pages worden pas
+// gealloceerd wanneer de huidige page vol is, een clear behoudt de
+// pages zodat ze hergebruikt worden.
+typedef struct TREE_ARENA_PAGE_T tree_arena_page_t;
+struct TREE_ARENA_PAGE_T {
+    tree_arena_page_t* next;
+    size_t size;   // aantal nodes in de page.
+    size_t bytes;  // grootte van de allocatie.
+    bool mapped;   // gealloceerd met mmap() in plaats van malloc().
+    tree_t d[];
+};
+
 typedef struct {
     tree_arena_handle_t h;
-    tree_t d[TREE_ARENA_SIZE + 1];
-    int di;
-    int f[TREE_ARENA_SIZE + 1];
-    int fi;
+    tree_arena_page_t* first;  // eerste page van de ketting.
+    tree_arena_page_t* page;   // page waarin gealloceerd wordt.
+    size_t di;                 // index van de volgende vrije node.
+    tree_t* f;  // lijst met verwijderde nodes, gelinkt via left.
+    tree_t dummy;
     tree_arena_err_e err;
+    tree_t** it;    // tabel van tree_arena_intern().
+    size_t itn;     // aantal nodes in de tabel.
+    size_t itsize;  // capaciteit van de tabel, een macht van 2.
 } tree_arena_t;
 
+typedef struct {
+    size_t first;  // aantal nodes van de eerste page, 0 is standaard.
+    tree_arena_page_e type;
+} tree_arena_config_t;
+
+static tree_arena_config_t tree_arena_config = {
+    .first = 0,
+    .type = TREE_ARENA_PAGE_L1,
+};
+
+size_t tree_arena_page_bytes[] = {
+    [TREE_ARENA_PAGE_L1] = TREE_ARENA_PAGE_BYTES_L1,
+    [TREE_ARENA_PAGE_LARGE] = TREE_ARENA_PAGE_BYTES_LARGE,
+    [TREE_ARENA_PAGE_HUGE] = TREE_ARENA_PAGE_BYTES_LARGE,
+};
+
+void tree_arena_configure(size_t first, tree_arena_page_e type) {
+    tree_arena_config.first = first;
+    tree_arena_config.type = type;
+}
+
+// Rond het aantal bytes naar boven af op een veelvoud van align.
+static inline size_t tree_arena_align(size_t bytes, size_t align) {
+    return (bytes + align - 1) / align * align;
+}
+
+// Alloceer een page met minimaal nodes nodes, afgerond naar boven op
+// het formaat van het geconfigureerde page type. Geeft NULL terug
+// wanneer er echt geen geheugen meer is.
+static tree_arena_page_t* tree_arena_page_malloc(size_t nodes) {
+    size_t align = tree_arena_page_bytes[tree_arena_config.type];
+    size_t bytes = tree_arena_align(
+        sizeof(tree_arena_page_t) + nodes * sizeof(tree_t), align);
+    tree_arena_page_t* p = MAP_FAILED;
+
+    if (tree_arena_config.type == TREE_ARENA_PAGE_HUGE) {
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    // Wanneer er geen hugepages gereserveerd zijn valt de arena terug
+    // op gewone pages, eventueel transparant samengevoegd door de
+    // kernel.
+    if (p == MAP_FAILED &&
+        tree_arena_config.type != TREE_ARENA_PAGE_L1) {
+        p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, bytes, MADV_HUGEPAGE);
+        }
+    }
+
+    if (p != MAP_FAILED) {
+        p->mapped = true;
+    } else {
+        p = calloc(1, bytes);
+        if (p == NULL) {
+            return NULL;
+        }
+    }
+
+    p->next = NULL;
+    p->bytes = bytes;
+    p->size = (bytes - sizeof(tree_arena_page_t)) / sizeof(tree_t);
+    return p;
+}
+
+static void tree_arena_page_free(tree_arena_page_t* p) {
+    if (p->mapped) {
+        munmap(p, p->bytes);
+    } else {
+        free(p);
+    }
+}
+
+// Ligt de node in het gebruikte deel van een page van de arena? De
+// huidige page wordt eerst bekeken, daar staan de nodes die net
+// gealloceerd zijn.
+static bool tree_arena_owns(tree_arena_t const* t,
+                            tree_t const* const tree) {
+    uintptr_t n = (uintptr_t)tree;
+    if (n >= (uintptr_t)t->page->d &&
+        n < (uintptr_t)(t->page->d + t->di)) {
+        return true;
+    }
+
+    for (tree_arena_page_t* p = t->first; p != t->page; p = p->next) {
+        if (n >= (uintptr_t)p->d && n < (uintptr_t)(p->d + p->size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 tree_t* tree_arena_remove_node(
     tree_arena_handle_t const* const handle, tree_t* tree) {
     tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
-    int i = tree - t->d;
 
-    if (i < 0 || i >= t->di) {
+    if (tree == NULL || !tree_arena_owns(t, tree)) {
         return tree;
     }
 
-    t->f[t->fi++] = i;
-    memset(&t->d[i], 0, sizeof(tree_t));
+    memset(tree, 0, sizeof(tree_t));
+    tree->left = t->f;
+    t->f = tree;
     return NULL;
 }
 
 tree_t* tree_arena_get_dummy(
     tree_arena_handle_t const* const handle) {
     tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
-    return &t->d[TREE_ARENA_SIZE];
+    return &t->dummy;
 }
 
 tree_t* tree_arena_new_node(tree_arena_handle_t const* const handle) {
     tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
 
-    if (t->err != TREE_ARENA_ERR_NONE || t->di >= TREE_ARENA_SIZE) {
-        t->err = TREE_ARENA_ERR_OVERFILLED;
+    if (t->err != TREE_ARENA_ERR_NONE) {
         return tree_arena_get_dummy(handle);
     }
 
-    if (t->fi > 0) {
-        return &t->d[t->f[t->fi--]];
+    if (t->f != NULL) {
+        tree_t* r = t->f;
+        t->f = r->left;
+        r->left = NULL;
+        return r;
     }
 
-    return &t->d[t->di++];
+    if (t->di >= t->page->size) {
+        if (t->page->next == NULL) {
+            t->page->next = tree_arena_page_malloc(1);
+        }
+
+        if (t->page->next == NULL) {
+            t->err = TREE_ARENA_ERR_OVERFILLED;
+            return tree_arena_get_dummy(handle);
+        }
+
+        t->page = t->page->next;
+        t->di = 0;
+    }
+
+    return &t->page->d[t->di++];
 }
 
 tree_arena_err_e tree_arena_get_err(
@@ -71,20 +202,511 @@ tree_arena_err_e tree_arena_get_err(
     return CONTAINER_OF(handle, tree_arena_t, h)->err;
 }
 
+void tree_arena_set_err(tree_arena_handle_t const* const handle,
+                        tree_arena_err_e err) {
+    CONTAINER_OF(handle, tree_arena_t, h)->err = err;
+}
+
+size_t tree_arena_used(tree_arena_handle_t const* const handle) {
+    tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
+
+    size_t n = t->di;
+    for (tree_arena_page_t* p = t->first; p != t->page; p = p->next) {
+        n += p->size;
+    }
+    return n;
+}
+
 void tree_arena_clear(tree_arena_handle_t const* const handle) {
     tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
-    t->fi = 0;
+
+    // Alleen de gebruikte nodes hoeven leeg gemaakt te worden, de
+    // rest van de pages is nog leeg sinds de vorige clear.
+    for (tree_arena_page_t* p = t->first; p != t->page; p = p->next) {
+        memset(p->d, 0, sizeof(tree_t) * p->size);
+    }
+    memset(t->page->d, 0, sizeof(tree_t) * t->di);
+
+    t->page = t->first;
     t->di = 0;
+    t->f = NULL;
     t->err = TREE_ARENA_ERR_NONE;
-    memset(&t->d, 0, sizeof(tree_t) * TREE_ARENA_SIZE);
+    tree_arena_intern_clear(handle);
+}
+
+void tree_arena_intern_clear(
+    tree_arena_handle_t const* const handle) {
+    tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
+
+    if (t->itn > 0) {
+        memset(t->it, 0, sizeof(tree_t*) * t->itsize);
+        t->itn = 0;
+    }
 }
 
 const tree_arena_handle_t* tree_arena_malloc(void) {
     tree_arena_t* t = calloc(1, sizeof(tree_arena_t));
+    if (t == NULL) {
+        return NULL;
+    }
+
+    // Zonder configuratie wordt de eerste page net zo groot als de
+    // pages die later aan de ketting worden toegevoegd.
+    t->first = t->page =
+        tree_arena_page_malloc(tree_arena_config.first);
+    if (t->first == NULL) {
+        free(t);
+        return NULL;
+    }
+
     return &t->h;
 }
 
 void tree_arena_free(tree_arena_handle_t const* const handle) {
     tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
+
+    tree_arena_page_t* p = t->first;
+    while (p != NULL) {
+        tree_arena_page_t* n = p->next;
+        tree_arena_page_free(p);
+        p = n;
+    }
+
+    free(t->it);
     free(t);
 }
+
+// Meng de bits van een hash, zodat ook de lage bits bruikbaar zijn
+// als index.
+static inline uint64_t tree_hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t tree_hash_node(token_t const* const token,
+                                      tree_t const* const left,
+                                      tree_t const* const right) {
+    uint64_t h = token_hash(token);
+    h = tree_hash_mix(h ^ (uintptr_t)left);
+    h = tree_hash_mix(h ^ ((uintptr_t)right * 31));
+    return h;
+}
+
+// Verdubbel de tabel van tree_arena_intern(). De hash wordt opnieuw
+// berekend met de huidige inhoud van de nodes.
+static bool tree_arena_intern_grow(tree_arena_t* t) {
+    size_t size = t->itsize ? t->itsize * 2 : 1024;
+    tree_t** it = calloc(size, sizeof(tree_t*));
+    if (it == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < t->itsize; i++) {
+        tree_t* n = t->it[i];
+        if (n == NULL) {
+            continue;
+        }
+        size_t j = tree_hash_node(&n->token, n->left, n->right);
+        while (it[j & (size - 1)] != NULL) {
+            j++;
+        }
+        it[j & (size - 1)] = n;
+    }
+
+    free(t->it);
+    t->it = it;
+    t->itsize = size;
+    return true;
+}
+
+// Zoek de plek in de tabel van tree_arena_intern() voor een node met
+// de gegeven inhoud. De plek bevat een gelijke node of is leeg. Geeft
+// NULL wanneer de tabel niet kon groeien.
+static tree_t** tree_arena_intern_find(tree_arena_t* t,
+                                       token_t const* const token,
+                                       tree_t const* const left,
+                                       tree_t const* const right) {
+    if ((t->itn + 1) * 2 > t->itsize && !tree_arena_intern_grow(t)) {
+        t->err = TREE_ARENA_ERR_OVERFILLED;
+        return NULL;
+    }
+
+    size_t mask = t->itsize - 1;
+    size_t i = tree_hash_node(token, left, right) & mask;
+    for (tree_t* n; (n = t->it[i]) != NULL; i = (i + 1) & mask) {
+        if (n->left == left && n->right == right &&
+            token_cmp(&n->token, token)) {
+            break;
+        }
+    }
+
+    return &t->it[i];
+}
+
+tree_t* tree_arena_intern(tree_arena_handle_t const* const handle,
+                          token_t const* const token, tree_t* left,
+                          tree_t* right) {
+    tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
+
+    if (t->err != TREE_ARENA_ERR_NONE) {
+        return tree_arena_get_dummy(handle);
+    }
+
+    tree_t** n = tree_arena_intern_find(t, token, left, right);
+    if (n == NULL) {
+        return tree_arena_get_dummy(handle);
+    } else if (*n != NULL) {
+        return *n;
+    }
+
+    tree_t* r = tree_arena_new_node(handle);
+    if (t->err != TREE_ARENA_ERR_NONE) {
+        return r;
+    }
+
+    token_copy(&r->token, token);
+    r->left = left;
+    r->right = right;
+    *n = r;
+    t->itn++;
+    return r;
+}
+
+tree_t* tree_arena_intern_node(
+    tree_arena_handle_t const* const handle, tree_t* node) {
+    tree_arena_t* t = CONTAINER_OF(handle, tree_arena_t, h);
+
+    tree_t** n = tree_arena_intern_find(t, &node->token, node->left,
+                                        node->right);
+    if (n == NULL) {
+        return node;
+    } else if (*n != NULL) {
+        return *n;
+    }
+
+    *n = node;
+    t->itn++;
+    return node;
+}
+
+// Frame van de versies met een expliciete stack van
+// tree_arena_intern_sub() en tree_deepcopy_sub().
+typedef struct {
+    tree_t const* src;  // de bron node.
+    tree_t* r;          // de kopie, enkel voor tree_deepcopy_sub().
+    int s;              // aantal verwerkte kinderen.
+} tree_copy_frame_t;
+
+// Versie van _tree_arena_intern_sub() met een expliciete stack. De
+// kinderen worden eerst gekopieerd, de kopie van een kind wordt
+// daarna uit m gelezen.
+static tree_t* tree_arena_intern_sub_iter(
+    tree_arena_handle_t const* const handle, tree_t const* const src,
+    tree_map_t* m) {
+    tree_stack_t s = {.w = sizeof(tree_copy_frame_t)};
+    tree_copy_frame_t* f = tree_stack_push(&s);
+    tree_t* r = tree_arena_get_dummy(handle);  // laatste kopie.
+    void* v;
+
+    if (f == NULL) {
+        tree_arena_set_err(handle, TREE_ARENA_ERR_OVERFILLED);
+        return r;
+    }
+    f->src = src;
+
+    while (s.n > 0) {
+        f = tree_stack_top(&s);
+        tree_t const* c = (f->s == 0) ? f->src->left : f->src->right;
+
+        if (f->s < 2) {
+            f->s++;
+            if (c == NULL || tree_map_get(m, c, &v)) {
+                continue;
+            }
+
+            f = tree_stack_push(&s);
+            if (f == NULL) {
+                tree_arena_set_err(handle, TREE_ARENA_ERR_OVERFILLED);
+                r = tree_arena_get_dummy(handle);
+                break;
+            }
+            f->src = c;
+            continue;
+        }
+
+        tree_t* left = NULL;
+        tree_t* right = NULL;
+        if (f->src->left != NULL &&
+            tree_map_get(m, f->src->left, &v)) {
+            left = v;
+        }
+        if (f->src->right != NULL &&
+            tree_map_get(m, f->src->right, &v)) {
+            right = v;
+        }
+
+        r = tree_arena_intern(handle, &f->src->token, left, right);
+        if (!tree_map_put(m, f->src, r)) {
+            tree_arena_set_err(handle, TREE_ARENA_ERR_OVERFILLED);
+            r = tree_arena_get_dummy(handle);
+            break;
+        }
+        tree_stack_pop(&s);
+    }
+
+    tree_stack_free(&s);
+    return r;
+}
+
+static tree_t* _tree_arena_intern_sub(
+    tree_arena_handle_t const* const handle, tree_t const* const src,
+    tree_map_t* m, int depth) {
+    void* r;  // de al gekopieerde node.
+    if (src == NULL) {
+        return NULL;
+    } else if (tree_map_get(m, src, &r)) {
+        return r;
+    } else if (depth > TREE_DEPTH_MAX) {
+        return tree_arena_intern_sub_iter(handle, src, m);
+    }
+
+    tree_t* left =
+        _tree_arena_intern_sub(handle, src->left, m, depth + 1);
+    tree_t* right =
+        _tree_arena_intern_sub(handle, src->right, m, depth + 1);
+    r = tree_arena_intern(handle, &src->token, left, right);
+
+    if (!tree_map_put(m, src, r)) {
+        CONTAINER_OF(handle, tree_arena_t, h)->err =
+            TREE_ARENA_ERR_OVERFILLED;
+    }
+
+    return r;
+}
+
+tree_t* tree_arena_intern_sub(tree_arena_handle_t const* const handle,
+                              tree_t const* const src) {
+    tree_map_t m = {0};  // bron node naar gekopieerde node.
+    tree_t* r = _tree_arena_intern_sub(handle, src, &m, 0);
+    tree_map_free(&m);
+    return r;
+}
+
+static inline size_t tree_map_index(tree_map_t const* const m,
+                                    tree_t const* const k) {
+    return tree_hash_mix((uintptr_t)k) & (m->size - 1);
+}
+
+bool tree_map_get(tree_map_t const* const m, tree_t const* const k,
+                  void** v) {
+    if (m->n == 0) {
+        return false;
+    }
+
+    for (size_t i = tree_map_index(m, k); m->k[i] != NULL;
+         i = (i + 1) & (m->size - 1)) {
+        if (m->k[i] == k) {
+            *v = m->v[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool tree_map_put(tree_map_t* m, tree_t const* const k, void* v) {
+    if ((m->n + 1) * 2 > m->size) {
+        tree_map_t g = {
+            .size = m->size ? m->size * 2 : 64,
+        };
+        g.k = calloc(g.size, sizeof(tree_t*));
+        g.v = calloc(g.size, sizeof(void*));
+        if (g.k == NULL || g.v == NULL) {
+            tree_map_free(&g);
+            return false;
+        }
+
+        for (size_t i = 0; i < m->size; i++) {
+            if (m->k[i] != NULL) {
+                tree_map_put(&g, m->k[i], m->v[i]);
+            }
+        }
+
+        tree_map_free(m);
+        *m = g;
+    }
+
+    size_t i = tree_map_index(m, k);
+    while (m->k[i] != NULL && m->k[i] != k) {
+        i = (i + 1) & (m->size - 1);
+    }
+
+    m->n += (m->k[i] == NULL);
+    m->k[i] = k;
+    m->v[i] = v;
+    return true;
+}
+
+void tree_map_free(tree_map_t* m) {
+    free(m->k);
+    free(m->v);
+    *m = (tree_map_t){0};
+}
+
+void* tree_stack_push(tree_stack_t* s) {
+    if (s->n >= s->size) {
+        size_t size = s->size ? s->size * 2 : 64;
+        char* d = realloc(s->d, size * s->w);
+        if (d == NULL) {
+            return NULL;
+        }
+        s->d = d;
+        s->size = size;
+    }
+
+    void* f = s->d + s->n++ * s->w;
+    memset(f, 0, s->w);
+    return f;
+}
+
+void tree_stack_free(tree_stack_t* s) {
+    free(s->d);
+    *s = (tree_stack_t){.w = s->w};
+}
+
+// Versie van tree_deepcopy_sub() met een expliciete stack. De nodes
+// van de kinderen worden gemaakt voordat ze op de stack komen, zodat
+// het frame van een kind enkel de inhoud hoeft te kopieren.
+static tree_t* tree_deepcopy_sub_iter(
+    tree_arena_handle_t const* const h, tree_t const* const src) {
+    tree_stack_t s = {.w = sizeof(tree_copy_frame_t)};
+    tree_t* r = tree_arena_new_node(h);
+    tree_copy_frame_t* f = tree_stack_push(&s);
+
+    if (f == NULL) {
+        tree_arena_set_err(h, TREE_ARENA_ERR_OVERFILLED);
+        return tree_arena_get_dummy(h);
+    }
+    f->src = src;
+    f->r = r;
+
+    while (s.n > 0 && tree_arena_get_err(h) == TREE_ARENA_ERR_NONE) {
+        f = tree_stack_top(&s);
+        tree_copy_frame_t c = *f;
+        tree_stack_pop(&s);
+
+        token_copy(&c.r->token, &c.src->token);
+        tree_t const* k[] = {c.src->right, c.src->left};
+        tree_t** kr[] = {&c.r->right, &c.r->left};
+
+        for (int i = 0; i < 2; i++) {
+            if (k[i] == NULL) {
+                continue;
+            }
+
+            *kr[i] = tree_arena_new_node(h);
+            f = tree_stack_push(&s);
+            if (f == NULL) {
+                tree_arena_set_err(h, TREE_ARENA_ERR_OVERFILLED);
+                break;
+            }
+            f->src = k[i];
+            f->r = *kr[i];
+        }
+    }
+
+    tree_stack_free(&s);
+    return r;
+}
+
+static tree_t* _tree_deepcopy_sub(tree_arena_handle_t const* const h,
+                                  tree_t const* const src,
+                                  int depth) {
+    if (depth > TREE_DEPTH_MAX) {
+        return tree_deepcopy_sub_iter(h, src);
+    }
+
+    tree_t* r = tree_arena_new_node(h);
+    if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
+        return r;
+    }
+
+    token_copy(&r->token, &src->token);
+
+    if (src->left != NULL) {
+        r->left = _tree_deepcopy_sub(h, src->left, depth + 1);
+    }
+
+    if (src->right != NULL) {
+        r->right = _tree_deepcopy_sub(h, src->right, depth + 1);
+    }
+
+    return r;
+}
+
+tree_t* tree_deepcopy_sub(tree_arena_handle_t const* const h,
+                          tree_t const* const src) {
+    return _tree_deepcopy_sub(h, src, 0);
+}
+
+static inline void tree_substitute_x_node(tree_t* tree,
+                                          double value) {
+    if (tree->token.type == TOKEN_TYPE_VARIABLE &&
+        tree->token.value.variable == 'x') {
+        tree->token.value.number = value;
+        tree->token.type = TOKEN_TYPE_NUMBER;
+    }
+}
+
+// Versie van tree_substitute_x() met een expliciete stack.
+static bool tree_substitute_x_iter(tree_t* tree, double value) {
+    tree_stack_t s = {.w = sizeof(tree_t*)};
+    tree_t** f = tree_stack_push(&s);
+    bool ok = (f != NULL);
+
+    if (ok) {
+        *f = tree;
+    }
+
+    while (ok && s.n > 0) {
+        tree_t* t = *(tree_t**)tree_stack_top(&s);
+        tree_stack_pop(&s);
+        tree_substitute_x_node(t, value);
+
+        tree_t* k[] = {t->right, t->left};
+        for (int i = 0; ok && i < 2; i++) {
+            if (k[i] == NULL) {
+                continue;
+            }
+
+            f = tree_stack_push(&s);
+            ok = (f != NULL);
+            if (ok) {
+                *f = k[i];
+            }
+        }
+    }
+
+    tree_stack_free(&s);
+    return ok;
+}
+
+static bool _tree_substitute_x(tree_t* tree, double value,
+                               int depth) {
+    if (tree == NULL) {
+        return true;
+    } else if (depth > TREE_DEPTH_MAX) {
+        return tree_substitute_x_iter(tree, value);
+    }
+
+    tree_substitute_x_node(tree, value);
+
+    return _tree_substitute_x(tree->left, value, depth + 1) &&
+           _tree_substitute_x(tree->right, value, depth + 1);
+}
+
+bool tree_substitute_x(tree_t* tree, double value) {
+    return _tree_substitute_x(tree, value, 0);
+}
@@ -7,15 +7,27 @@
 #ifndef __TREE_H
 #define __TREE_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "token.h"
 
+// Diepte waarboven de recursieve functies verder gaan met een
+// expliciete stack op de heap, zodat een diepe boom de C stack niet
+// laat overlopen. Ondiepe bomen houden de snellere recursie.
+#define TREE_DEPTH_MAX 1024
+
 typedef enum {
     TREE_ARENA_ERR_NONE = 0,    // Geen errors.
-    TREE_ARENA_ERR_OVERFILLED,  // De arena is vol.
+    TREE_ARENA_ERR_OVERFILLED,  // Er kon geen page meer bij.
 } tree_arena_err_e;
 
+typedef enum {
+    TREE_ARENA_PAGE_L1 = 0,  // pages die in de L1 cache passen.
+    TREE_ARENA_PAGE_LARGE,   // pages van 2MiB, transparante hugepage.
+    TREE_ARENA_PAGE_HUGE,    // pages van 2MiB met MAP_HUGETLB.
+} tree_arena_page_e;
+
 typedef struct TREE_T tree_t;
 struct TREE_T {
     token_t token;
@@ -25,11 +37,36 @@ struct TREE_T {
 
 typedef void *tree_arena_handle_t;
 
-// Maak een nieuwe node binnen de page van de arena, wanneer de arena
-// vol is wordt er een dummy gereturned. De fout kan opgevangen worden
-// met tree_arena_get_err(), zet TREE_ARENA_ERR_OVERFILLED. De arena
-// moet met tree_arena_clear() gereset worden om weer functioneel te
-// worden.
+// Hash map van een node naar een waarde, met open adressering. Een
+// lege map is {0}.
+typedef struct {
+    tree_t const **k;  // de nodes.
+    void **v;          // de waardes bij de nodes.
+    size_t n;          // aantal elementen.
+    size_t size;       // capaciteit, een macht van 2.
+} tree_map_t;
+
+// Stack op de heap voor het doorlopen van een boom zonder recursie.
+// Ieder element is een frame van w bytes, een lege stack is {.w = w}.
+typedef struct {
+    char *d;      // de frames.
+    size_t n;     // aantal frames.
+    size_t size;  // capaciteit van d in frames.
+    size_t w;     // grootte van een frame.
+} tree_stack_t;
+
+// Configureer de arena's die hierna met tree_arena_malloc() worden
+// gemaakt. first is het minimum aantal nodes van de eerste page, 0
+// geeft een page van het standaard formaat. type bepaalt het soort
+// pages waaruit de ketting bestaat.
+void tree_arena_configure(size_t first, tree_arena_page_e type);
+
+// Maak een nieuwe node binnen de page van de arena, wanneer de page
+// vol is wordt er een nieuwe page aan de arena gekoppeld. Pas wanneer
+// er geen geheugen meer is wordt er een dummy gereturned. De fout kan
+// opgevangen worden met tree_arena_get_err(), zet
+// TREE_ARENA_ERR_OVERFILLED. De arena moet met tree_arena_clear()
+// gereset worden om weer functioneel te worden.
 tree_t *tree_arena_new_node(tree_arena_handle_t const *const handle);
 
 tree_t *tree_arena_remove_node(
@@ -44,34 +81,82 @@ tree_t *tree_arena_get_dummy(tree_arena_handle_t const *const handle);
 tree_arena_err_e tree_arena_get_err(
     tree_arena_handle_t const *const handle);
 
-// Maak de hele arena leeg, let op dat bestaande pointers naar nodes
-// blijven bestaan. Deze zullen echter wijzen naar nodes die leeg zijn
-// of mogelijk na een clear opnieuw worden vrijgegeven.
+// Zet de error flag van een arena, voor een fout die buiten de arena
+// om ontstaat, zoals een volle stack.
+void tree_arena_set_err(tree_arena_handle_t const *const handle,
+                        tree_arena_err_e err);
+
+// Aantal nodes dat uit de pages van de arena genomen is. Verwijderde
+// nodes die op hergebruik wachten tellen mee.
+size_t tree_arena_used(tree_arena_handle_t const *const handle);
+
+// Maak de hele arena leeg, de pages blijven gealloceerd voor
+// hergebruik. Let op dat bestaande pointers naar nodes blijven
+// bestaan. Deze zullen echter wijzen naar nodes die leeg zijn of
+// mogelijk na een clear opnieuw worden vrijgegeven.
 void tree_arena_clear(tree_arena_handle_t const *const handle);
 
+// Vergeet alle gedeelde nodes van tree_arena_intern(), de nodes zelf
+// blijven bestaan. Nodig nadat gedeelde nodes aangepast zijn op een
+// manier die hun waarde verandert, zoals door tree_substitute_x().
+void tree_arena_intern_clear(tree_arena_handle_t const *const handle);
+
 const tree_arena_handle_t *const tree_arena_malloc(void);
 void tree_arena_free(tree_arena_handle_t const *const handle);
 
-// Kopieer subboom naar een andere subboom.
-static inline tree_t *tree_deepcopy_sub(
-    tree_arena_handle_t const *const h, tree_t const *const src) {
-    tree_t *r = tree_arena_new_node(h);
-    if (tree_arena_get_err(h) != TREE_ARENA_ERR_NONE) {
-        return r;
-    }
-
-    token_copy(&r->token, &src->token);
+// Geef de node met token en kinderen left en right uit de arena.
+// Iedere combinatie bestaat maar een keer binnen de arena, dus
+// gelijke subbomen worden gedeeld en de boom wordt een DAG. Gedeelde
+// nodes mogen daarom alleen aangepast worden op een manier die de
+// waarde van de subboom behoudt. Bij een volle arena wordt de dummy
+// gereturned, zoals bij tree_arena_new_node().
+tree_t *tree_arena_intern(tree_arena_handle_t const *const handle,
+                          token_t const *const token, tree_t *left,
+                          tree_t *right);
+
+// Zoek een bestaande node in de arena met dezelfde inhoud als node,
+// de kinderen van node moeten zelf al gedeeld zijn. Bestaat er nog
+// geen gelijke node dan wordt node zelf de gedeelde node.
+tree_t *tree_arena_intern_node(
+    tree_arena_handle_t const *const handle, tree_t *node);
+
+// Kopieer een subboom of DAG naar de arena met tree_arena_intern(),
+// ieder verschillend subboom wordt dus maar een keer gekopieerd.
+tree_t *tree_arena_intern_sub(tree_arena_handle_t const *const handle,
+                              tree_t const *const src);
+
+// Zoek de waarde van een node op, geeft false wanneer de node niet in
+// de map staat.
+bool tree_map_get(tree_map_t const *const m, tree_t const *const k,
+                  void **v);
+
+// Zet de waarde van een node, geeft false wanneer er geen geheugen
+// meer is.
+bool tree_map_put(tree_map_t *m, tree_t const *const k, void *v);
+
+// Geef het geheugen van de map vrij, de map is daarna weer leeg.
+void tree_map_free(tree_map_t *m);
+
+// Leg een nieuw frame op de stack, de inhoud is 0. Geeft NULL
+// wanneer er geen geheugen meer is. Pointers naar frames zijn na een
+// push ongeldig.
+void *tree_stack_push(tree_stack_t *s);
+
+// Het bovenste frame van een stack die niet leeg is.
+static inline void *tree_stack_top(tree_stack_t const *const s) {
+    return s->d + (s->n - 1) * s->w;
+}
 
-    if (src->left != NULL) {
-        r->left = tree_deepcopy_sub(h, src->left);
-    }
+static inline void tree_stack_pop(tree_stack_t *s) {
+    s->n--;
+}
 
-    if (src->right != NULL) {
-        r->right = tree_deepcopy_sub(h, src->right);
-    }
+// Geef het geheugen van de stack vrij, de stack is daarna weer leeg.
+void tree_stack_free(tree_stack_t *s);
 
-    return r;
-}
+// Kopieer subboom naar een andere subboom.
+tree_t *tree_deepcopy_sub(tree_arena_handle_t const *const h,
+                          tree_t const *const src);
 
 // Verplaatst de src node naar de trg node. De src node raakt verloren
 // in de subboom.
@@ -83,19 +168,8 @@ static inline void tree_move_node(tree_t *trg,
 }
 
 // Vervang alle variabele tokens met naam x met de waarde value.
-static inline void tree_substitute_x(tree_t *tree, double value) {
-    if (tree == NULL) {
-        return;
-    }
-
-    if (tree->token.type == TOKEN_TYPE_VARIABLE &&
-        tree->token.value.variable == 'x') {
-        tree->token.value.number = value;
-        tree->token.type = TOKEN_TYPE_NUMBER;
-    }
-
-    tree_substitute_x(tree->left, value);
-    tree_substitute_x(tree->right, value);
-}
+// Geeft false wanneer er geen geheugen meer is voor de stack, de boom
+// is dan maar gedeeltelijk aangepast.
+bool tree_substitute_x(tree_t *tree, double value);
 
 #endif  // __TREE_H
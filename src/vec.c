@@ -0,0 +1,170 @@
+/* Implementatie van een gevectoriseerde evaluator. De stack van de
+ * machine bestaat uit blokken van VEC_BLOCK doubles, iedere
+ * instructie roept een kernel aan die over het hele blok werkt.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include "vec.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Grootste gehele exponent die met herhaald kwadrateren wordt
+// uitgerekend.
+#define VEC_POWER_MAX 64
+// Grootste |x| waarvoor de reductie van sin en cos nauwkeurig is.
+#define VEC_SINCOS_MAX 1e5
+
+// Constantes voor het reduceren van x naar [-pi/4, pi/4], pi/2 is
+// opgesplitst in drie delen van 33 bits zodat q * VEC_PIO2_1 exact
+// is. Zie ook __kernel_sin en __kernel_cos van fdlibm.
+#define VEC_MAGIC 0x1.8p52
+#define VEC_2_PI 6.36619772367581382433e-01
+#define VEC_PIO2_1 1.57079632673412561417e+00
+#define VEC_PIO2_2 6.07710050630396597660e-11
+#define VEC_PIO2_3 2.02226624871116645580e-21
+
+// Coefficienten van de polynomen van sin en cos op [-pi/4, pi/4].
+#define VEC_S1 -1.66666666666666324348e-01
+#define VEC_S2 8.33333333332248946124e-03
+#define VEC_S3 -1.98412698298579493134e-04
+#define VEC_S4 2.75573137070700676789e-06
+#define VEC_S5 -2.50507602534068634195e-08
+#define VEC_S6 1.58969099521155010221e-10
+#define VEC_C1 4.16666666666666019037e-02
+#define VEC_C2 -1.38888888888741095749e-03
+#define VEC_C3 2.48015872894767294178e-05
+#define VEC_C4 -2.75573143513906633035e-07
+#define VEC_C5 2.08757232129817482790e-09
+#define VEC_C6 -1.13596475577881948265e-11
+
+// Kernel die een operatie over een blok uitvoert. Het resultaat komt
+// in l, r is de rechtse operand of NULL wanneer c als rechtse operand
+// gebruikt moet worden.
+typedef void (*vec_op_t)(double *restrict l, double const *restrict r,
+                         double c);
+
+#define VEC_WIDTH 4
+#define VEC_ATTR __attribute__((target("avx2,fma")))
+#define VEC_NAME(n) vec_avx2_##n
+#include "vec_kernel.h"
+
+#define VEC_WIDTH 2
+#define VEC_ATTR __attribute__((target("sse2")))
+#define VEC_NAME(n) vec_sse2_##n
+#include "vec_kernel.h"
+
+#define VEC_WIDTH 1
+#define VEC_ATTR
+#define VEC_NAME(n) vec_scalar_##n
+#include "vec_kernel.h"
+
+vec_op_t *vec_map_isa[] = {
+    [VEC_ISA_SCALAR] = vec_scalar_map_op,
+    [VEC_ISA_SSE2] = vec_sse2_map_op,
+    [VEC_ISA_AVX2] = vec_avx2_map_op,
+};
+
+vec_isa_e vec_get_isa(void) {
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma")) {
+        return VEC_ISA_AVX2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        return VEC_ISA_SSE2;
+    }
+
+    return VEC_ISA_SCALAR;
+}
+
+static inline bool vec_is_binairy(comp_op_e op) {
+    return (op == COMP_OP_MINUS || op == COMP_OP_PLUS ||
+            op == COMP_OP_MULTIPLY || op == COMP_OP_DIVIDE ||
+            op == COMP_OP_POWER);
+}
+
+vec_rt_e vec_eval(comp_program_t const *const p, double const *x,
+                  double *y, size_t n) {
+    // Kernels van de huidige CPU. Worker threads kunnen tegelijk de
+    // eerste zijn, ze schrijven dan dezelfde waarde.
+    static vec_op_t *vec_map = NULL;
+    vec_op_t *map = __atomic_load_n(&vec_map, __ATOMIC_RELAXED);
+    if (map == NULL) {
+        map = vec_map_isa[vec_get_isa()];
+        __atomic_store_n(&vec_map, map, __ATOMIC_RELAXED);
+    }
+
+    // De stack, gevolgd door de slots en een blok voor x.
+    double *s = aligned_alloc(
+        32, (p->depth + p->slots + 1) * VEC_BLOCK * sizeof(double));
+    if (s == NULL) {
+        return VEC_RT_ERR;
+    }
+    double *sl = s + p->depth * VEC_BLOCK;  // de slots.
+
+    // Het laatste blok wordt aangevuld, zodat de kernels altijd over
+    // een volledig blok werken.
+    double *xp = sl + p->slots * VEC_BLOCK;
+
+    for (size_t b = 0; b < n; b += VEC_BLOCK) {
+        size_t m = (n - b < VEC_BLOCK) ? n - b : VEC_BLOCK;
+        double const *xb = x + b;
+        if (m < VEC_BLOCK) {
+            memcpy(xp, xb, m * sizeof(double));
+            for (size_t i = m; i < VEC_BLOCK; i++) {
+                xp[i] = xb[m - 1];
+            }
+            xb = xp;
+        }
+
+        double *t = s - VEC_BLOCK;  // top van de stack.
+        comp_instr_t const *e = p->d + p->n;
+        for (comp_instr_t const *c = p->d; c < e; c++) {
+            switch (c->op) {
+                case COMP_OP_NUMBER:
+                    // Een constante als rechtse operand hoeft niet
+                    // over een blok uitgesmeerd te worden.
+                    if (c + 1 < e && vec_is_binairy(c[1].op)) {
+                        map[c[1].op](t, NULL, c->value);
+                        c++;
+                        break;
+                    }
+                    t += VEC_BLOCK;
+                    for (int i = 0; i < VEC_BLOCK; i++) {
+                        t[i] = c->value;
+                    }
+                    break;
+                case COMP_OP_X:
+                    t += VEC_BLOCK;
+                    memcpy(t, xb, VEC_BLOCK * sizeof(double));
+                    break;
+                case COMP_OP_SIN:
+                case COMP_OP_COS:
+                    map[c->op](t, NULL, 0.0f);
+                    break;
+                case COMP_OP_LOAD:
+                    t += VEC_BLOCK;
+                    memcpy(t, sl + c->slot * VEC_BLOCK,
+                           VEC_BLOCK * sizeof(double));
+                    break;
+                case COMP_OP_STORE:
+                    memcpy(sl + c->slot * VEC_BLOCK, t,
+                           VEC_BLOCK * sizeof(double));
+                    break;
+                default:
+                    t -= VEC_BLOCK;
+                    map[c->op](t, t + VEC_BLOCK, 0.0f);
+                    break;
+            }
+        }
+
+        memcpy(y + b, s, m * sizeof(double));
+    }
+
+    free(s);
+    return VEC_RT_OK;
+}
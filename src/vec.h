@@ -0,0 +1,41 @@
+/* Header van een gevectoriseerde evaluator. Een gecompileerd
+ * programma wordt in blokken over een array van x waardes uitgevoerd,
+ * waarbij iedere instructie in een keer over een heel blok werkt.
+ * Afhankelijk van de CPU worden AVX2, SSE2 of scalaire kernels
+ * gebruikt.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#ifndef __VEC_H
+#define __VEC_H
+
+#include <stddef.h>
+
+#include "comp.h"
+
+// Aantal x waardes dat per blok door het programma gaat, moet een
+// veelvoud zijn van de breedste vector.
+#define VEC_BLOCK 256
+
+typedef enum {
+    VEC_RT_OK = 0,
+    VEC_RT_ERR,  // er kon geen stack gealloceerd worden.
+} vec_rt_e;
+
+typedef enum {
+    VEC_ISA_SCALAR = 0,
+    VEC_ISA_SSE2,
+    VEC_ISA_AVX2,
+} vec_isa_e;
+
+// De instructieset die door de CPU ondersteund wordt en gebruikt
+// wordt voor de kernels.
+vec_isa_e vec_get_isa(void);
+
+// Evalueer het programma voor de n waardes in x, het resultaat van
+// x[i] wordt in y[i] geschreven.
+vec_rt_e vec_eval(comp_program_t const *const p, double const *x,
+                  double *y, size_t n);
+
+#endif  // __VEC_H
@@ -0,0 +1,171 @@
+/* Sjabloon voor de kernels van de gevectoriseerde evaluator. Dit
+ * bestand wordt meerdere keren door vec.c ingevoegd, een keer per
+ * instructieset. Voor het invoegen moeten de volgende macro's
+ * gedefinieerd zijn:
+ *  - VEC_WIDTH   aantal doubles in een vector.
+ *  - VEC_ATTR    attributen van de functies, bijvoorbeeld de target.
+ *  - VEC_NAME(n) unieke naam voor n binnen deze instructieset.
+ *
+ * De kernels maken gebruik van de vector extensies van GCC, zodat de
+ * compiler voor iedere target de juiste instructies kiest.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#define VEC_D VEC_NAME(d_t)
+#define VEC_I VEC_NAME(i_t)
+
+typedef double VEC_D
+    __attribute__((vector_size(VEC_WIDTH * sizeof(double))));
+typedef long long VEC_I
+    __attribute__((vector_size(VEC_WIDTH * sizeof(double))));
+
+VEC_ATTR static inline VEC_D VEC_NAME(load)(double const *p) {
+    VEC_D v;
+    memcpy(&v, p, sizeof(VEC_D));
+    return v;
+}
+
+VEC_ATTR static inline void VEC_NAME(store)(double *p, VEC_D v) {
+    memcpy(p, &v, sizeof(VEC_D));
+}
+
+VEC_ATTR static inline VEC_D VEC_NAME(splat)(double c) {
+    return (VEC_D){0} + c;
+}
+
+// Binaire operatie over een heel blok, met een blok of een constante
+// als rechtse operand.
+#define VEC_KERNEL_BINAIR(name, expr)                               \
+    VEC_ATTR static void VEC_NAME(name)(                            \
+        double *restrict l, double const *restrict r, double c) {   \
+        if (r != NULL) {                                            \
+            for (int i = 0; i < VEC_BLOCK; i += VEC_WIDTH) {        \
+                VEC_D a = VEC_NAME(load)(l + i);                    \
+                VEC_D b = VEC_NAME(load)(r + i);                    \
+                VEC_NAME(store)(l + i, expr);                       \
+            }                                                       \
+        } else {                                                    \
+            VEC_D b = VEC_NAME(splat)(c);                           \
+            for (int i = 0; i < VEC_BLOCK; i += VEC_WIDTH) {        \
+                VEC_D a = VEC_NAME(load)(l + i);                    \
+                VEC_NAME(store)(l + i, expr);                       \
+            }                                                       \
+        }                                                           \
+    }
+
+VEC_KERNEL_BINAIR(minus, a - b)
+VEC_KERNEL_BINAIR(plus, a + b)
+VEC_KERNEL_BINAIR(multiply, a * b)
+VEC_KERNEL_BINAIR(divide, a / b)
+
+#undef VEC_KERNEL_BINAIR
+
+VEC_ATTR static void VEC_NAME(power)(double *restrict l,
+                                     double const *restrict r,
+                                     double c) {
+    // Een constante gehele exponent wordt met herhaald kwadrateren
+    // uitgerekend, de rest gaat via pow() van libm.
+    if (r != NULL || !(fabs(c) <= VEC_POWER_MAX) || c != (int)c) {
+        for (int i = 0; i < VEC_BLOCK; i++) {
+            l[i] = pow(l[i], (r != NULL) ? r[i] : c);
+        }
+        return;
+    }
+
+    int e = abs((int)c);
+    for (int i = 0; i < VEC_BLOCK; i += VEC_WIDTH) {
+        VEC_D b = VEC_NAME(load)(l + i);
+        VEC_D v = VEC_NAME(splat)(1.0f);
+        for (int n = e; n > 0; n >>= 1) {
+            if (n & 1) {
+                v *= b;
+            }
+            b *= b;
+        }
+        VEC_NAME(store)(l + i, (c < 0) ? 1.0f / v : v);
+    }
+}
+
+// Benadering van sin(x + o * pi/2). x wordt gereduceerd naar r in
+// [-pi/4, pi/4] met x = q * pi/2 + r, het kwadrant q bepaalt welke
+// polynoom gebruikt wordt en het teken van het resultaat.
+VEC_ATTR static inline VEC_D VEC_NAME(sincos)(VEC_D x, long long o) {
+    VEC_D t = x * VEC_2_PI + VEC_MAGIC;
+    VEC_D q = t - VEC_MAGIC;
+    VEC_I qi = (VEC_I)t + o;
+
+    VEC_D r = x - q * VEC_PIO2_1;
+    r = r - q * VEC_PIO2_2;
+    r = r - q * VEC_PIO2_3;
+    VEC_D z = r * r;
+
+    VEC_D s = VEC_S5 + z * VEC_S6;
+    s = VEC_S3 + z * (VEC_S4 + z * s);
+    s = r + r * z * (VEC_S1 + z * (VEC_S2 + z * s));
+    VEC_D k = VEC_C5 + z * VEC_C6;
+    k = VEC_C3 + z * (VEC_C4 + z * k);
+    k = 1.0f - 0.5f * z + z * z * (VEC_C1 + z * (VEC_C2 + z * k));
+
+    VEC_I swap = -(qi & 1);
+    VEC_I sign = (qi & 2) << 62;
+    return (VEC_D)((((VEC_I)k & swap) | ((VEC_I)s & ~swap)) ^ sign);
+}
+
+// Kan het blok met de benadering van sin en cos uitgerekend worden?
+VEC_ATTR static bool VEC_NAME(sincos_in_range)(double const *l) {
+    bool ok = true;
+    for (int i = 0; i < VEC_BLOCK; i++) {
+        ok &= (fabs(l[i]) <= VEC_SINCOS_MAX);
+    }
+    return ok;
+}
+
+VEC_ATTR static void VEC_NAME(sin)(double *restrict l,
+                                   double const *restrict r,
+                                   double c) {
+    if (!VEC_NAME(sincos_in_range)(l)) {
+        for (int i = 0; i < VEC_BLOCK; i++) {
+            l[i] = sin(l[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < VEC_BLOCK; i += VEC_WIDTH) {
+        VEC_D v = VEC_NAME(load)(l + i);
+        VEC_NAME(store)(l + i, VEC_NAME(sincos)(v, 0));
+    }
+}
+
+VEC_ATTR static void VEC_NAME(cos)(double *restrict l,
+                                   double const *restrict r,
+                                   double c) {
+    if (!VEC_NAME(sincos_in_range)(l)) {
+        for (int i = 0; i < VEC_BLOCK; i++) {
+            l[i] = cos(l[i]);
+        }
+        return;
+    }
+
+    for (int i = 0; i < VEC_BLOCK; i += VEC_WIDTH) {
+        VEC_D v = VEC_NAME(load)(l + i);
+        VEC_NAME(store)(l + i, VEC_NAME(sincos)(v, 1));
+    }
+}
+
+static vec_op_t VEC_NAME(map_op)[] = {
+    [0 ... COMP_OP_INVALID] = NULL,
+    [COMP_OP_MINUS] = VEC_NAME(minus),
+    [COMP_OP_PLUS] = VEC_NAME(plus),
+    [COMP_OP_MULTIPLY] = VEC_NAME(multiply),
+    [COMP_OP_DIVIDE] = VEC_NAME(divide),
+    [COMP_OP_POWER] = VEC_NAME(power),
+    [COMP_OP_SIN] = VEC_NAME(sin),
+    [COMP_OP_COS] = VEC_NAME(cos),
+};
+
+#undef VEC_D
+#undef VEC_I
+#undef VEC_WIDTH
+#undef VEC_ATTR
+#undef VEC_NAME
@@ -0,0 +1,170 @@
+/* Test van parser_read_double() tegen strtod(). Willekeurige doubles
+ * en willekeurige reeksen cijfers met een vaste seed moeten precies
+ * dezelfde double geven als strtod(), net als een lijst van
+ * subnormale getallen, grote exponenten en getallen precies tussen
+ * twee doubles in.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+
+// Aantal willekeurige getallen per soort.
+#define PARSER_TEST_N 1000000
+// Lengte van de langste string.
+#define PARSER_TEST_LENGTH 2048
+
+static uint64_t parser_test_seed = 0x2545f4914f6cdd1d;
+
+// Xorshift64.
+static uint64_t parser_test_random(void) {
+    parser_test_seed ^= parser_test_seed << 13;
+    parser_test_seed ^= parser_test_seed >> 7;
+    parser_test_seed ^= parser_test_seed << 17;
+    return parser_test_seed;
+}
+
+// Lees s met de parser en vergelijk met strtod(), geeft false bij een
+// verschil.
+static bool parser_test_string(char const *s) {
+    static parser_buf_t b;  // te groot voor de stack.
+    size_t n = strlen(s);
+
+    memcpy(b.d, s, n + 1);
+    b.l = b.p = b.d;
+    b.e = b.d + n;
+    b.refill = NULL;
+
+    double v = 0.0f;
+    double w = strtod(s, NULL);
+    if (parser_read_double(&b, &v) != PARSER_RT_OK || b.p != b.e) {
+        printf("ERR! Failed to read \"%.64s\".\n", s);
+        return false;
+    } else if (memcmp(&v, &w, sizeof(double)) != 0) {
+        printf("ERR! \"%.64s\" gives %a, strtod gives %a.\n", s, v,
+               w);
+        return false;
+    }
+    return true;
+}
+
+// Een willekeurige eindige double in de notaties van printf.
+static size_t parser_test_doubles(void) {
+    char const *formats[] = {"%.17g", "%.16g", "%.15g", "%.25e"};
+    char s[PARSER_TEST_LENGTH];
+    size_t bad = 0;
+
+    for (size_t i = 0; i < PARSER_TEST_N; i++) {
+        uint64_t r = parser_test_random();
+        double v;
+        memcpy(&v, &r, sizeof(double));
+        if (!isfinite(v)) {
+            continue;
+        }
+        snprintf(s, sizeof(s), formats[i % 4], v);
+        bad += !parser_test_string(s);
+    }
+    return bad;
+}
+
+// Een willekeurige reeks van 1 tot 40 cijfers met een punt en een
+// exponent van -350 tot 350, zodat ook de trage paden lopen.
+static size_t parser_test_digits(void) {
+    char s[PARSER_TEST_LENGTH];
+    size_t bad = 0;
+
+    for (size_t i = 0; i < PARSER_TEST_N; i++) {
+        uint64_t r = parser_test_random();
+        int n = 1 + r % 40;
+        int dot = (r >> 8) % (n + 1);
+        int e = (int)((r >> 16) % 701) - 350;
+        char *p = s;
+
+        if ((r >> 32) & 1) {
+            *p++ = '-';
+        }
+        for (int k = 0; k < n; k++) {
+            if (k == dot && k > 0) {
+                *p++ = '.';
+            }
+            *p++ = '0' + parser_test_random() % 10;
+        }
+        snprintf(p, s + sizeof(s) - p, "e%d", e);
+        bad += !parser_test_string(s);
+    }
+    return bad;
+}
+
+// Een getal van 1 + 2^-53 gevolgd door zeros nullen en een laatste
+// cijfer, precies tussen 1 en de volgende double in wanneer het
+// laatste cijfer 0 is.
+static size_t parser_test_halfway(int zeros, char last) {
+    char s[PARSER_TEST_LENGTH];
+    int n = snprintf(s, sizeof(s), "%s",
+                     "1.00000000000000011102230246251565404236316680"
+                     "908203125");
+    memset(s + n, '0', zeros);
+    s[n + zeros] = last;
+    s[n + zeros + 1] = '\0';
+    return !parser_test_string(s);
+}
+
+int main(void) {
+    char const *cases[] = {
+        // Subnormaal en de grens met de normale getallen.
+        "4.9406564584124654e-324",
+        "2.4703282292062327e-324",
+        "2.4703282292062328e-324",
+        "2.2250738585072011e-308",
+        "2.2250738585072012e-308",
+        "2.2250738585072014e-308",
+        "1e-320",
+        "1e-400",
+        // Grote exponenten en de grootste double.
+        "1e308",
+        "1.7976931348623157e308",
+        "1.7976931348623158e308",
+        "1e22",
+        "1e23",
+        "123456789012345678901234567890e-50",
+        "0.000000000000000000000000000001e30",
+        "1e0000000000000000000000000000000000000001",
+        // Precies tussen twee doubles in, naar even.
+        "9007199254740993",
+        "9007199254740995",
+        "9007199254740993.0000000000000000000000000001",
+        "4503599627370497.5",
+        "1.00000000000000011102230246251565404236316680908203125",
+        "1.00000000000000011102230246251565404236316680908203124",
+        "1.00000000000000011102230246251565404236316680908203126",
+        // Nul, een half en voorloopnullen.
+        "0.5",
+        "-0",
+        "00000000000000000000000000000000000000001",
+    };
+
+    size_t bad = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        bad += !parser_test_string(cases[i]);
+    }
+
+    // Na 768 cijfers telt alleen nog of er een cijfer anders dan 0
+    // volgt.
+    for (int zeros = 700; zeros < 820; zeros += 7) {
+        bad += parser_test_halfway(zeros, '0');
+        bad += parser_test_halfway(zeros, '1');
+    }
+
+    bad += parser_test_doubles();
+    bad += parser_test_digits();
+    printf("Read %d cases and %d random numbers, %zu differ.\n",
+           (int)(sizeof(cases) / sizeof(cases[0])), 2 * PARSER_TEST_N,
+           bad);
+    return (bad == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+/* Test van expand tegen de binomiaalcoefficienten. (x + 1)^n wordt
+ * met herhaald kwadrateren uitgewerkt, zodat schoolbook, Karatsuba
+ * en de FFT allemaal aan bod komen. Iedere coefficient moet op een
+ * kleine relatieve fout na gelijk zijn aan n boven k, ook de kleine
+ * coefficienten naast de grootste.
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parser.h"
+#include "poly.h"
+
+// Grootste toegestane relatieve fout van een coefficient.
+#define POLY_TEST_REL 1e-13
+// Grootste n, boven 1029 loopt n boven n / 2 over.
+#define POLY_TEST_N_MAX 1022
+
+// Lees een term c * x^e van de uitgewerkte boom, geeft false wanneer
+// t geen term is.
+static bool poly_test_term(tree_t const *t, int64_t *e, double *c) {
+    *e = 0;
+    *c = 1.0f;
+    if (t->token.type == TOKEN_TYPE_MULTIPLY) {
+        if (t->left->token.type != TOKEN_TYPE_NUMBER) {
+            return false;
+        }
+        *c = t->left->token.value.number;
+        t = t->right;
+    } else if (t->token.type == TOKEN_TYPE_NUMBER) {
+        *c = t->token.value.number;
+        return true;
+    }
+
+    if (t->token.type == TOKEN_TYPE_POWER &&
+        t->left->token.type == TOKEN_TYPE_VARIABLE &&
+        t->right->token.type == TOKEN_TYPE_NUMBER) {
+        *e = (int64_t)t->right->token.value.number;
+        return true;
+    }
+    *e = 1;
+    return t->token.type == TOKEN_TYPE_VARIABLE;
+}
+
+// Werk (x + 1)^n uit en vergelijk de coefficienten met n boven k,
+// geeft het aantal foute coefficienten.
+static size_t poly_test_binomial(tree_arena_handle_t const *h,
+                                 int n) {
+    static parser_buf_t b;  // te groot voor de stack.
+    double got[POLY_TEST_N_MAX + 1] = {0};
+    size_t bad = 0;
+
+    tree_arena_clear(h);
+    int l = snprintf(b.d, sizeof(b.d), "^ + x 1 %d", n);
+    b.l = b.p = b.d;
+    b.e = b.d + l;
+    b.refill = NULL;
+
+    poly_stats_t stats;
+    tree_t *r = tree_arena_new_node(h);
+    if (r == NULL ||
+        parser_tokenize_string(h, &b, r, NULL) != PARSER_RT_OK ||
+        (r = poly_expand(h, r, &stats)) == NULL) {
+        printf("ERR! Failed to expand (x + 1)^%d.\n", n);
+        return 1;
+    }
+
+    // De termen staan van links af opgeteld, de laagste macht rechts.
+    // Een negatieve coefficient wordt een aftrekking.
+    for (tree_t const *t = r; t != NULL;) {
+        tree_t const *k = t;
+        double sign = 1.0f;
+        if (t->token.type == TOKEN_TYPE_PLUS ||
+            t->token.type == TOKEN_TYPE_MINUS) {
+            sign = (t->token.type == TOKEN_TYPE_MINUS) ? -1.0f : 1.0f;
+            k = t->right;
+            t = t->left;
+        } else {
+            t = NULL;
+        }
+
+        int64_t e;
+        double c;
+        if (!poly_test_term(k, &e, &c) || e < 0 || e > n ||
+            got[e] != 0) {
+            printf("ERR! (x + 1)^%d has an unexpected term.\n", n);
+            return 1;
+        }
+        got[e] = sign * c;
+    }
+
+    // n boven k in long double, met een relatieve fout van hooguit
+    // n keer de eps van long double.
+    long double want = 1.0f;
+    for (int k = 0; k <= n; k++) {
+        double rel = fabs(got[k] - (double)want) / (double)want;
+        if (!(rel <= POLY_TEST_REL) && bad++ < 5) {
+            printf("(x + 1)^%d: x^%d is %.17g, expected %.17Lg.\n",
+                   n, k, got[k], want);
+        }
+        want = want * (n - k) / (k + 1);
+    }
+    printf("(x + 1)^%d: %zu of %d coefficients are off.\n", n, bad,
+           n + 1);
+    return bad;
+}
+
+int main(void) {
+    tree_arena_handle_t const *h = tree_arena_malloc();
+    if (h == NULL) {
+        printf("ERR! Failed to allocate the arena.\n");
+        return EXIT_FAILURE;
+    }
+
+    int const ns[] = {50, 63, 64, 200, 511, 512, 1000, 1022};
+    size_t bad = 0;
+    for (size_t i = 0; i < sizeof(ns) / sizeof(ns[0]); i++) {
+        bad += poly_test_binomial(h, ns[i]);
+    }
+
+    tree_arena_free(h);
+    return (bad == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
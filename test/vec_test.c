@@ -0,0 +1,139 @@
+/* Test van de nauwkeurigheid van vec_eval() tegen libm. De kernels
+ * van de CPU worden op willekeurige x waardes met een vaste seed
+ * vergeleken met sin(), cos() en pow().
+ *
+ * Door: Jenny Vermeltfoort, Universiteit van Leiden.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vec.h"
+
+// Aantal x waardes per interval.
+#define VEC_TEST_N (1 << 20)
+// Grootste toegestane fout van sin en cos in ulp.
+#define VEC_TEST_ULP 2
+
+static uint64_t vec_test_seed = 0x9e3779b97f4a7c15;
+
+// Xorshift64, een willekeurig getal in [a, b].
+static double vec_test_random(double a, double b) {
+    vec_test_seed ^= vec_test_seed << 13;
+    vec_test_seed ^= vec_test_seed >> 7;
+    vec_test_seed ^= vec_test_seed << 17;
+    return a + (b - a) * (double)(vec_test_seed >> 11) * 0x1p-53;
+}
+
+// Afstand tussen twee doubles in ulp, de bits worden zo geordend dat
+// opvolgende doubles opvolgende gehele getallen zijn.
+static int64_t vec_test_ulp(double a, double b) {
+    if (isnan(a) || isnan(b)) {
+        return (isnan(a) && isnan(b)) ? 0 : INT64_MAX;
+    }
+
+    int64_t i, j;
+    memcpy(&i, &a, sizeof(double));
+    memcpy(&j, &b, sizeof(double));
+    i = (i < 0) ? -(i & INT64_MAX) : i;
+    j = (j < 0) ? -(j & INT64_MAX) : j;
+    return (i > j) ? i - j : j - i;
+}
+
+// Vergelijk het programma op n waardes uit [a, b] met f, geeft het
+// aantal waardes met een fout groter dan ulp.
+static size_t vec_test_range(comp_program_t const *p,
+                             char const *name, double (*f)(double),
+                             double a, double b, int64_t ulp) {
+    double *x = malloc(VEC_TEST_N * sizeof(double));
+    double *y = malloc(VEC_TEST_N * sizeof(double));
+    if (x == NULL || y == NULL) {
+        printf("ERR! Failed to allocate the values.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < VEC_TEST_N; i++) {
+        x[i] = vec_test_random(a, b);
+    }
+    if (vec_eval(p, x, y, VEC_TEST_N) != VEC_RT_OK) {
+        printf("ERR! Failed to allocate the stack.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t bad = 0;
+    int64_t max = 0;
+    for (size_t i = 0; i < VEC_TEST_N; i++) {
+        int64_t d = vec_test_ulp(y[i], f(x[i]));
+        max = (d > max) ? d : max;
+        if (d > ulp) {
+            if (bad++ < 5) {
+                printf("%s(%.17g) = %.17g, libm gives %.17g.\n", name,
+                       x[i], y[i], f(x[i]));
+            }
+        }
+    }
+    printf("%s on [%g, %g]: max %lld ulp.\n", name, a, b,
+           (long long)max);
+
+    free(x);
+    free(y);
+    return bad;
+}
+
+static double vec_test_cube(double x) { return pow(x, 3.0f); }
+
+static double vec_test_nan(double x) { return NAN; }
+
+int main(void) {
+    char const *isa[] = {
+        [VEC_ISA_SCALAR] = "scalar",
+        [VEC_ISA_SSE2] = "SSE2",
+        [VEC_ISA_AVX2] = "AVX2",
+    };
+    printf("Testing the %s kernels.\n", isa[vec_get_isa()]);
+
+    comp_instr_t sin_d[] = {{.op = COMP_OP_X}, {.op = COMP_OP_SIN}};
+    comp_instr_t cos_d[] = {{.op = COMP_OP_X}, {.op = COMP_OP_COS}};
+    comp_instr_t cube_d[] = {
+        {.op = COMP_OP_X},
+        {.op = COMP_OP_NUMBER, .value = 3.0f},
+        {.op = COMP_OP_POWER},
+    };
+    // Een exponent die geen int is moet via pow() gaan.
+    comp_instr_t nan_d[] = {
+        {.op = COMP_OP_X},
+        {.op = COMP_OP_NUMBER, .value = NAN},
+        {.op = COMP_OP_POWER},
+    };
+    comp_program_t sin_p = {.d = sin_d, .n = 2, .depth = 1};
+    comp_program_t cos_p = {.d = cos_d, .n = 2, .depth = 1};
+    comp_program_t cube_p = {.d = cube_d, .n = 3, .depth = 2};
+    comp_program_t nan_p = {.d = nan_d, .n = 3, .depth = 2};
+
+    // De laatste intervallen vallen buiten de reductie en gaan via
+    // libm.
+    double const ranges[][2] = {
+        {-M_PI_4, M_PI_4}, {-10.0f, 10.0f}, {-1e5, 1e5}, {-1e9, 1e9}};
+
+    size_t bad = 0;
+    for (size_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        bad += vec_test_range(&sin_p, "sin", sin, ranges[i][0],
+                              ranges[i][1], VEC_TEST_ULP);
+        bad += vec_test_range(&cos_p, "cos", cos, ranges[i][0],
+                              ranges[i][1], VEC_TEST_ULP);
+    }
+    bad += vec_test_range(&cube_p, "^ x 3", vec_test_cube, -1e3, 1e3,
+                          VEC_TEST_ULP);
+    bad += vec_test_range(&nan_p, "^ x nan", vec_test_nan, -1e3, 1e3,
+                          0);
+
+    if (bad != 0) {
+        printf("ERR! %zu values are off by more than the bound.\n",
+               bad);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}